@@ -0,0 +1,411 @@
+//
+//  AnalysisDaemon.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "AnalysisDaemon.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <csignal>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ElapsedTime.hpp"
+
+// How often the drop directory is checked for new manifests, and the signal flag for a request
+// to stop, in milliseconds
+static const int cPollIntervalMs = 250;
+
+static volatile sig_atomic_t sStopRequested = 0;
+
+
+static void prvRequestStop(int)
+{
+    sStopRequested = 1;
+}
+
+
+// Strips the line ending, and returns whether what's left is a job rather than a blank line or
+// a comment
+static bool prvIsJobLine(std::string &line)
+{
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+        line.pop_back();
+    }
+    return !line.empty() && line[0] != '#';
+}
+
+
+// Creates a socket listening at the path. A socket left there by a daemon that's no longer running
+// is replaced, but one that's in use, or anything else at the path, isn't. On failure, reports why
+// to stderr and returns -1.
+static int prvListen(const std::string &socketPath)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    assert(socketPath.size() < sizeof(address.sun_path));
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    
+    struct stat statbuf;
+    if (lstat(socketPath.c_str(), &statbuf) == 0) {
+        if (!S_ISSOCK(statbuf.st_mode)) {
+            fprintf(stderr, "Something other than a socket is at \"%s\"\n", socketPath.c_str());
+            return -1;
+        }
+        int probeFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool inUse = probeFd >= 0 && connect(probeFd, (const sockaddr *)&address, sizeof(address)) == 0;
+        if (probeFd >= 0) {
+            close(probeFd);
+        }
+        if (inUse) {
+            fprintf(stderr, "Another daemon is already listening at \"%s\"\n", socketPath.c_str());
+            return -1;
+        }
+        unlink(socketPath.c_str());
+    }
+    
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        fprintf(stderr, "Can't create a socket\n");
+        return -1;
+    }
+    if (bind(listenFd, (const sockaddr *)&address, sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Can't listen at \"%s\"\n", socketPath.c_str());
+        close(listenFd);
+        return -1;
+    }
+    return listenFd;
+}
+
+
+AnalysisDaemon::AnalysisDaemon(const JobRunner &jobRunner, int jobThreadCount, bool reportStats) :
+m_JobRunner(jobRunner),
+m_ReportStats(reportStats),
+m_Stopping(false),
+m_JobCount(0),
+m_FailureCount(0),
+m_TotalLatencySeconds(0.0),
+m_MaxLatencySeconds(0.0)
+{
+    assert(jobThreadCount > 0);
+    for (int i = 0; i < jobThreadCount; i++) {
+        m_JobThreads.emplace_back([this]() {
+            prvJobLoop();
+        });
+    }
+}
+
+AnalysisDaemon::~AnalysisDaemon()
+{
+    prvReapClients(true);
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_JobAdded.notify_all();
+    for (std::thread &jobThread : m_JobThreads) {
+        jobThread.join();
+    }
+}
+
+
+bool AnalysisDaemon::Run(const std::string &socketPath, const std::string &watchDirectory)
+{
+    int listenFd = prvListen(socketPath);
+    if (listenFd < 0) {
+        return false;
+    }
+    
+    // Stop on SIGINT or SIGTERM. A client that goes away mid-job shouldn't stop anything.
+    struct sigaction stopAction;
+    memset(&stopAction, 0, sizeof(stopAction));
+    stopAction.sa_handler = prvRequestStop;
+    sigemptyset(&stopAction.sa_mask);
+    sigaction(SIGINT, &stopAction, nullptr);
+    sigaction(SIGTERM, &stopAction, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    if (m_ReportStats) {
+        fprintf(stderr, "Listening at \"%s\"%s%s with %zu job threads\n", socketPath.c_str(),
+                watchDirectory.empty() ? "" : ", watching ", watchDirectory.c_str(), m_JobThreads.size());
+    }
+    
+    // Each connection and manifest is served by a thread of its own, which waits for its jobs
+    std::chrono::steady_clock::time_point lastScanTime;
+    while (!sStopRequested) {
+        pollfd listenPoll = { listenFd, POLLIN, 0 };
+        if (poll(&listenPoll, 1, cPollIntervalMs) > 0 && (listenPoll.revents & POLLIN)) {
+            int socketFd = accept(listenFd, nullptr, nullptr);
+            if (socketFd >= 0) {
+                prvStartClient(socketFd, [this](Client *client) {
+                    prvServeConnection(client);
+                });
+            }
+        }
+        if (!watchDirectory.empty() && SecondsSince(lastScanTime) * 1000.0 >= cPollIntervalMs) {
+            prvScanWatchDirectory(watchDirectory);
+            lastScanTime = std::chrono::steady_clock::now();
+        }
+        prvReapClients(false);
+    }
+    
+    // Stop taking jobs, and finish the ones already taken
+    close(listenFd);
+    unlink(socketPath.c_str());
+    prvReapClients(true);
+    if (m_ReportStats) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        fprintf(stderr, "%zu jobs, %zu failed, latency mean %.3f s, max %.3f s\n", m_JobCount, m_FailureCount,
+                (m_JobCount > 0) ? m_TotalLatencySeconds / m_JobCount : 0.0, m_MaxLatencySeconds);
+    }
+    return true;
+}
+
+
+#pragma mark - Jobs
+
+// A job thread: runs jobs as they're queued, until the daemon stops
+void AnalysisDaemon::prvJobLoop()
+{
+    for (;;) {
+        Job *job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_JobAdded.wait(lock, [this]() {
+                return m_Stopping || !m_Jobs.empty();
+            });
+            if (m_Jobs.empty()) {
+                return;
+            }
+            job = m_Jobs.front();
+            m_Jobs.pop_front();
+        }
+        
+        job->m_QueuedSeconds = SecondsSince(job->m_ReceivedTime);
+        job->m_Succeeded = m_JobRunner(job->m_BatchJob, job->m_ResultFile);
+        job->m_LatencySeconds = SecondsSince(job->m_ReceivedTime);
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            job->m_Done = true;
+        }
+        m_JobDone.notify_all();
+    }
+}
+
+
+// Queues the jobs, waits for them to finish, and records their latencies. Jobs already marked
+// done, because they couldn't be parsed, are recorded as failures without being run.
+void AnalysisDaemon::prvRunJobs(const std::vector<Job*> &jobs)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (Job *job : jobs) {
+        if (!job->m_Done) {
+            m_Jobs.push_back(job);
+        }
+    }
+    m_JobAdded.notify_all();
+    m_JobDone.wait(lock, [&jobs]() {
+        for (Job *job : jobs) {
+            if (!job->m_Done) {
+                return false;
+            }
+        }
+        return true;
+    });
+    
+    for (Job *job : jobs) {
+        m_JobCount++;
+        m_FailureCount += job->m_Succeeded ? 0 : 1;
+        m_TotalLatencySeconds += job->m_LatencySeconds;
+        m_MaxLatencySeconds = std::max(m_MaxLatencySeconds, job->m_LatencySeconds);
+        if (m_ReportStats) {
+            const BatchJob &batchJob = job->m_BatchJob;
+            fprintf(stderr, "%8.3f s  %-6s  %s -> %s (queued %.3f s)\n", job->m_LatencySeconds,
+                    job->m_Succeeded ? "ok" : "failed", batchJob.m_InputFilepath.c_str(),
+                    batchJob.m_OutputFilepath.empty() ? "client" : batchJob.m_OutputFilepath.c_str(),
+                    job->m_QueuedSeconds);
+        }
+    }
+}
+
+
+#pragma mark - Clients
+
+void AnalysisDaemon::prvStartClient(int socketFd, const std::function<void (Client *client)> &serve)
+{
+    // The client is added and its thread started under the lock, so the thread can't mark it
+    // finished before it's set up
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Clients.emplace_back();
+    Client *client = &m_Clients.back();
+    client->m_SocketFd = socketFd;
+    client->m_Thread = std::thread([this, client, serve]() {
+        serve(client);
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        client->m_Finished = true;
+    });
+}
+
+
+// Joins the threads of clients that are finished, or with waitForAll, of every client, once
+// they're done. Connections are shut down for reading first, so they take no more jobs. Sockets
+// are closed here rather than by their threads, so a socket is never shut down after its
+// descriptor is reused.
+void AnalysisDaemon::prvReapClients(bool waitForAll)
+{
+    std::list<Client> finishedClients;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (auto it = m_Clients.begin(); it != m_Clients.end(); ) {
+            auto next = std::next(it);
+            if (waitForAll && it->m_SocketFd >= 0) {
+                shutdown(it->m_SocketFd, SHUT_RD);
+            }
+            if (waitForAll || it->m_Finished) {
+                finishedClients.splice(finishedClients.end(), m_Clients, it);
+            }
+            it = next;
+        }
+    }
+    for (Client &client : finishedClients) {
+        client.m_Thread.join();
+        if (client.m_SocketFd >= 0) {
+            close(client.m_SocketFd);
+        }
+    }
+}
+
+
+// Runs each job line the client sends, in order, sending back its results and a "done" line
+void AnalysisDaemon::prvServeConnection(Client *client)
+{
+    FILE *requestFile = fdopen(dup(client->m_SocketFd), "r");
+    FILE *resultFile = fdopen(dup(client->m_SocketFd), "w");
+    if (requestFile == nullptr || resultFile == nullptr) {
+        fprintf(stderr, "Can't read from a connection\n");
+    }
+    
+    char *lineBuffer = nullptr;
+    size_t lineCapacity = 0;
+    ssize_t lineLength = 0;
+    while (requestFile != nullptr && resultFile != nullptr &&
+           (lineLength = getline(&lineBuffer, &lineCapacity, requestFile)) >= 0) {
+        Job job;
+        job.m_ReceivedTime = std::chrono::steady_clock::now();
+        std::string line(lineBuffer, (size_t)lineLength);
+        if (!prvIsJobLine(line)) {
+            continue;
+        }
+        job.m_ResultFile = resultFile;
+        job.m_Done = !ParseBatchJob(line, true, job.m_BatchJob);
+        job.m_Succeeded = false;
+        job.m_QueuedSeconds = 0.0;
+        job.m_LatencySeconds = job.m_Done ? SecondsSince(job.m_ReceivedTime) : 0.0;
+        prvRunJobs(std::vector<Job*>(1, &job));
+        
+        fprintf(resultFile, "done\t%s\t%.6f\t%.6f\n", job.m_Succeeded ? "ok" : "failed", job.m_LatencySeconds,
+                job.m_QueuedSeconds);
+        if (fflush(resultFile) != 0) {
+            break;          // The client went away
+        }
+    }
+    free(lineBuffer);
+    if (requestFile != nullptr) {
+        fclose(requestFile);
+    }
+    if (resultFile != nullptr) {
+        fclose(resultFile);
+    }
+}
+
+
+// Runs the jobs in a claimed manifest, then writes its report and removes it. The report is
+// written under a temporary name, then renamed, so it never appears half written.
+void AnalysisDaemon::prvServeManifest(const std::string &manifestFilepath, const std::string &reportFilepath)
+{
+    std::ifstream manifest(manifestFilepath);
+    std::vector<std::unique_ptr<Job>> jobs;
+    std::string line;
+    for (int lineNumber = 1; std::getline(manifest, line); lineNumber++) {
+        if (!prvIsJobLine(line)) {
+            continue;
+        }
+        jobs.emplace_back(new Job);
+        Job &job = *jobs.back();
+        job.m_ReceivedTime = std::chrono::steady_clock::now();
+        job.m_ResultFile = nullptr;             // Every job in a manifest has an output file
+        job.m_Done = !ParseBatchJob(line, false, job.m_BatchJob);
+        job.m_Succeeded = false;
+        job.m_QueuedSeconds = 0.0;
+        job.m_LatencySeconds = 0.0;
+        if (job.m_Done) {
+            fprintf(stderr, "%s:%d: Invalid job\n", manifestFilepath.c_str(), lineNumber);
+        }
+    }
+    std::vector<Job*> jobPointers;
+    for (std::unique_ptr<Job> &job : jobs) {
+        jobPointers.push_back(job.get());
+    }
+    prvRunJobs(jobPointers);
+    
+    std::string temporaryFilepath = reportFilepath + ".tmp";
+    FILE *reportFile = fopen(temporaryFilepath.c_str(), "w");
+    if (reportFile == nullptr) {
+        fprintf(stderr, "Can't write a report at \"%s\"\n", temporaryFilepath.c_str());
+        return;
+    }
+    for (const std::unique_ptr<Job> &job : jobs) {
+        fprintf(reportFile, "%s\t%.6f\t%.6f\t%s\t%s\n", job->m_Succeeded ? "ok" : "failed", job->m_LatencySeconds,
+                job->m_QueuedSeconds, job->m_BatchJob.m_InputFilepath.c_str(),
+                job->m_BatchJob.m_OutputFilepath.c_str());
+    }
+    if (fclose(reportFile) != 0 || rename(temporaryFilepath.c_str(), reportFilepath.c_str()) != 0) {
+        fprintf(stderr, "Can't write a report at \"%s\"\n", reportFilepath.c_str());
+        return;
+    }
+    unlink(manifestFilepath.c_str());
+}
+
+
+// Claims any manifests that have been dropped into the directory, and starts serving them. A
+// manifest is claimed by renaming it, so if several daemons watch a directory, only one runs it.
+void AnalysisDaemon::prvScanWatchDirectory(const std::string &watchDirectory)
+{
+    static const std::string cManifestExtension = ".job";
+    DIR *directory = opendir(watchDirectory.c_str());
+    if (directory == nullptr) {
+        return;
+    }
+    std::vector<std::string> names;
+    for (dirent *entry = readdir(directory); entry != nullptr; entry = readdir(directory)) {
+        std::string name = entry->d_name;
+        if (name.size() > cManifestExtension.size() &&
+            name.compare(name.size() - cManifestExtension.size(), std::string::npos, cManifestExtension) == 0) {
+            names.push_back(name);
+        }
+    }
+    closedir(directory);
+    
+    for (const std::string &name : names) {
+        std::string baseFilepath = watchDirectory + "/" + name.substr(0, name.size() - cManifestExtension.size());
+        std::string claimedFilepath = baseFilepath + ".running";
+        if (rename((watchDirectory + "/" + name).c_str(), claimedFilepath.c_str()) != 0) {
+            continue;
+        }
+        std::string reportFilepath = baseFilepath + ".done";
+        prvStartClient(-1, [this, claimedFilepath, reportFilepath](Client *) {
+            prvServeManifest(claimedFilepath, reportFilepath);
+        });
+    }
+}
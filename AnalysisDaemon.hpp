@@ -0,0 +1,102 @@
+//
+//  AnalysisDaemon.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef AnalysisDaemon_hpp
+#define AnalysisDaemon_hpp
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CommandLine.h"
+
+// Runs analysis jobs for as long as it's left running, so each job skips the cost of starting a
+// process, and can reuse whatever the job runner keeps between jobs. Jobs arrive two ways:
+//
+//   - Over a Unix domain socket. A client sends job lines in the batch manifest's format, with
+//     the output file optional. For each line, in order, it gets back the results, as CSV, if no
+//     output file was given, then a line of "done", "ok" or "failed", the job's latency, and the
+//     part of that spent waiting for a thread, separated by tabs.
+//   - Through a drop directory. A manifest moved into it with a name ending in ".job" is claimed
+//     by renaming it to end in ".running", and its jobs are run. Then a report with a line per
+//     job, of "ok" or "failed", the latencies, the input file, and the output file, separated by
+//     tabs, is written beside it with a name ending in ".done", and the manifest is removed.
+//
+// A fixed set of threads runs the jobs, in the order they arrive. A job's latency is measured
+// from when its line was read to when its results were finished.
+class AnalysisDaemon
+{
+public:
+    // Runs a job, writing any results without an output file to resultFile, and returns whether
+    // it succeeded. It's called from several threads at once.
+    typedef std::function<bool (const BatchJob &job, FILE *resultFile)> JobRunner;
+    
+    AnalysisDaemon(const JobRunner &jobRunner, int jobThreadCount, bool reportStats);
+    ~AnalysisDaemon();
+    
+    AnalysisDaemon(const AnalysisDaemon&) = delete;
+    AnalysisDaemon& operator=(const AnalysisDaemon&) = delete;
+    
+    // Takes jobs from the socket, and the drop directory if one is given, until SIGINT or SIGTERM
+    // arrives, then finishes the jobs already taken. Returns false if it couldn't start.
+    bool Run(const std::string &socketPath, const std::string &watchDirectory);
+
+private:
+    struct Job
+    {
+        BatchJob    m_BatchJob;
+        FILE*       m_ResultFile;
+        std::chrono::steady_clock::time_point m_ReceivedTime;
+        bool        m_Done;
+        bool        m_Succeeded;
+        double      m_QueuedSeconds;
+        double      m_LatencySeconds;
+    };
+    
+    // A connection or drop directory manifest being served by a thread of its own
+    struct Client
+    {
+        std::thread m_Thread;
+        int         m_SocketFd = -1;        // -1 for a manifest
+        bool        m_Finished = false;
+    };
+    
+    JobRunner               m_JobRunner;
+    bool                    m_ReportStats;
+    std::vector<std::thread> m_JobThreads;
+    
+    std::mutex              m_Mutex;
+    std::condition_variable m_JobAdded;
+    std::condition_variable m_JobDone;
+    std::deque<Job*>        m_Jobs;             // Jobs waiting for a thread
+    bool                    m_Stopping;
+    std::list<Client>       m_Clients;
+    size_t                  m_JobCount;
+    size_t                  m_FailureCount;
+    double                  m_TotalLatencySeconds;
+    double                  m_MaxLatencySeconds;
+    
+    void prvJobLoop();
+    void prvRunJobs(const std::vector<Job*> &jobs);
+    void prvServeConnection(Client *client);
+    void prvServeManifest(const std::string &manifestFilepath, const std::string &reportFilepath);
+    void prvScanWatchDirectory(const std::string &watchDirectory);
+    void prvStartClient(int socketFd, const std::function<void (Client *client)> &serve);
+    void prvReapClients(bool waitForAll);
+};
+
+#endif /* AnalysisDaemon_hpp */
@@ -0,0 +1,167 @@
+//
+//  BoundedQueue.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef BoundedQueue_hpp
+#define BoundedQueue_hpp
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+// A fixed-capacity queue that any number of threads can push to and pop from without locking.
+// Each slot carries a sequence number saying whether it's ready to be written or read, so a
+// push or pop is a single compare-and-swap on a position counter; this is Dmitry Vyukov's
+// bounded MPMC queue.
+template <typename T>
+class BoundedQueue
+{
+public:
+    // The capacity is rounded up to a power of two, and is at least two; with a single slot, a
+    // full slot's sequence number would look free to the next push
+    explicit BoundedQueue(size_t capacity) :
+    m_Mask(prvRoundUpToPowerOfTwo(capacity) - 1),
+    m_Slots(new Slot[m_Mask + 1]),
+    m_PushPosition(0),
+    m_PopPosition(0)
+    {
+        for (size_t i = 0; i <= m_Mask; i++) {
+            m_Slots[i].m_Sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+    
+    size_t Capacity() const { return m_Mask + 1; }
+    
+    // Adds an item, unless the queue is full. Returns whether it was added.
+    bool TryPush(T &&item)
+    {
+        size_t position = m_PushPosition.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = m_Slots[position & m_Mask];
+            size_t sequence = slot.m_Sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+            if (difference == 0) {
+                // The slot is free; claim it if no other thread has
+                if (m_PushPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.m_Item = std::move(item);
+                    slot.m_Sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0) {
+                return false;       // The slot still holds an item from a lap ago, so the queue is full
+            }
+            else {
+                position = m_PushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    // Removes the oldest item, unless the queue is empty. Returns whether one was removed.
+    bool TryPop(T &item)
+    {
+        size_t position = m_PopPosition.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = m_Slots[position & m_Mask];
+            size_t sequence = slot.m_Sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+            if (difference == 0) {
+                if (m_PopPosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    item = std::move(slot.m_Item);
+                    slot.m_Sequence.store(position + m_Mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0) {
+                return false;       // Nothing has been pushed to the slot yet
+            }
+            else {
+                position = m_PopPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    // Adds an item, waiting while the queue is full
+    void Push(T item)
+    {
+        Backoff backoff;
+        while (!TryPush(std::move(item))) {
+            backoff.Wait();
+        }
+    }
+    
+    // Removes the oldest item, waiting while the queue is empty
+    void Pop(T &item)
+    {
+        Backoff backoff;
+        while (!TryPop(item)) {
+            backoff.Wait();
+        }
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> m_Sequence;
+        T                   m_Item;
+    };
+    
+    // Spins briefly, then yields, then sleeps, so a thread waiting on a stalled stage doesn't
+    // burn a core
+    class Backoff
+    {
+    public:
+        void Wait()
+        {
+            if (m_Count < cSpinCount) {
+                m_Count++;
+            }
+            else if (m_Count < cYieldCount) {
+                m_Count++;
+                std::this_thread::yield();
+            }
+            else {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+    
+    private:
+        static const int cSpinCount = 64;
+        static const int cYieldCount = 128;
+        int m_Count = 0;
+    };
+    
+    static size_t prvRoundUpToPowerOfTwo(size_t n)
+    {
+        assert(n > 0);
+        size_t result = 2;
+        while (result < n) {
+            result <<= 1;
+        }
+        return result;
+    }
+    
+    const size_t                m_Mask;
+    std::unique_ptr<Slot[]>     m_Slots;
+    
+    // Padded onto separate cache lines so pushing and popping threads don't contend. Padding is
+    // used rather than alignas(), since C++14's operator new doesn't honor over-alignment.
+    static const size_t cCacheLineSize = 64;
+    char                        m_LeadingPadding[cCacheLineSize];
+    std::atomic<size_t>         m_PushPosition;
+    char                        m_MiddlePadding[cCacheLineSize - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t>         m_PopPosition;
+};
+
+#endif /* BoundedQueue_hpp */
@@ -0,0 +1,106 @@
+//
+//  CodecContextCache.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "CodecContextCache.hpp"
+
+#include <cassert>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <libavcodec/avcodec.h>
+
+#if defined(__cplusplus)
+}
+#endif
+
+
+CodecContextCache::CodecContextCache(size_t capacity) :
+m_Capacity(capacity),
+m_HitCount(0),
+m_MissCount(0)
+{
+}
+
+CodecContextCache::~CodecContextCache()
+{
+    for (std::pair<std::string, AVCodecContext*> &idle : m_Idle) {
+        avcodec_free_context(&idle.second);
+    }
+}
+
+
+AVCodecContext* CodecContextCache::Take(const AVCodecParameters *parameters)
+{
+    std::string key = prvKey(parameters);
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (auto it = m_Idle.begin(); it != m_Idle.end(); ++it) {
+        if (it->first == key) {
+            AVCodecContext *codecContext = it->second;
+            m_Idle.erase(it);
+            m_HitCount++;
+            return codecContext;
+        }
+    }
+    m_MissCount++;
+    return nullptr;
+}
+
+
+void CodecContextCache::Give(AVCodecContext *codecContext, const AVCodecParameters *parameters)
+{
+    assert(codecContext != nullptr);
+    
+    // Drop any frames and references to the last stream, and leave draining mode
+    avcodec_flush_buffers(codecContext);
+    
+    AVCodecContext *evicted = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Idle.emplace_front(prvKey(parameters), codecContext);
+        if (m_Idle.size() > m_Capacity) {
+            evicted = m_Idle.back().second;
+            m_Idle.pop_back();
+        }
+    }
+    if (evicted != nullptr) {
+        avcodec_free_context(&evicted);
+    }
+}
+
+
+size_t CodecContextCache::HitCount() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_HitCount;
+}
+
+
+size_t CodecContextCache::MissCount() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_MissCount;
+}
+
+
+// The parameters a decoder is set up from when it's opened, as bytes that are equal only when
+// the decoder would be set up the same way
+std::string CodecContextCache::prvKey(const AVCodecParameters *parameters)
+{
+    const int fields[] = {
+        parameters->codec_id, (int)parameters->codec_tag, parameters->format, parameters->profile,
+        parameters->level, parameters->width, parameters->height, parameters->bits_per_coded_sample,
+        parameters->field_order, parameters->color_range, parameters->color_space
+    };
+    std::string key((const char *)fields, sizeof(fields));
+    if (parameters->extradata != nullptr) {
+        key.append((const char *)parameters->extradata, (size_t)parameters->extradata_size);
+    }
+    return key;
+}
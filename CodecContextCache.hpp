@@ -0,0 +1,58 @@
+//
+//  CodecContextCache.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef CodecContextCache_hpp
+#define CodecContextCache_hpp
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <utility>
+
+// Foreward declarations
+struct AVCodecContext;
+struct AVCodecParameters;
+
+// Keeps open decoders that are done with, so a later stream with the same codec parameters can
+// reuse one instead of opening its own. Opening a decoder allocates its tables and threads, which
+// is a large part of the cost of analyzing a short clip. Decoders are only reused for streams
+// whose parameters, including the extradata holding H.264's and HEVC's parameter sets, match
+// exactly. Any number of threads can use the cache at once.
+class CodecContextCache
+{
+public:
+    // Keeps at most capacity idle decoders, dropping the least recently returned first
+    explicit CodecContextCache(size_t capacity);
+    ~CodecContextCache();
+    
+    CodecContextCache(const CodecContextCache&) = delete;
+    CodecContextCache& operator=(const CodecContextCache&) = delete;
+    
+    // Takes an open decoder made for the same parameters, or returns nullptr if there isn't one
+    AVCodecContext* Take(const AVCodecParameters *parameters);
+    
+    // Gives back a decoder opened for the parameters. It's flushed, so it can start on a new
+    // stream.
+    void Give(AVCodecContext *codecContext, const AVCodecParameters *parameters);
+    
+    // How many times Take() found a decoder, and how many times it didn't
+    size_t HitCount() const;
+    size_t MissCount() const;
+
+private:
+    size_t              m_Capacity;
+    mutable std::mutex  m_Mutex;
+    std::list<std::pair<std::string, AVCodecContext*>> m_Idle;     // Most recently given back first
+    size_t              m_HitCount;
+    size_t              m_MissCount;
+    
+    static std::string prvKey(const AVCodecParameters *parameters);
+};
+
+#endif /* CodecContextCache_hpp */
@@ -6,11 +6,29 @@
 #include <sys/param.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/un.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cassert>
+#include <fstream>
 #include <regex>
+#include <set>
+#include <thread>
 
 #include "CommandLine.h"
 
+// Parses a count of one or more, returning false if the string isn't one
+static bool prvParseCount(const std::string &countStr, int &count)
+{
+    std::regex countRegex("\\d+", std::regex_constants::ECMAScript);
+    if (!std::regex_match(countStr, countRegex) || atoi(countStr.c_str()) < 1) {
+        return false;
+    }
+    count = atoi(countStr.c_str());
+    return true;
+}
+
 static bool prvFileIsNormalFile(std::string &posixPath)
 {
     // Fail for an empty path
@@ -41,24 +59,299 @@ static bool prvFileIsReadable(std::string &posixPath)
     }
     return result;
 }
+
+// Reports a problem with the input filepath, returning false if there is one
+static bool prvValidateInputFilepath(std::string &inputFilepath)
+{
+    if (inputFilepath.empty()) {
+        fprintf(stderr, "Empty input filepath\n");
+        return false;
+    }
+    if (!prvFileIsNormalFile(inputFilepath)) {
+        fprintf(stderr, "No input file at \"%s\"\n", inputFilepath.c_str());
+        return false;
+    }
+    if (!prvFileIsReadable(inputFilepath)) {
+        fprintf(stderr, "Can't read input file at \"%s\"\n", inputFilepath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Whether the input is stdin or a FIFO, which can only be read front to back as data arrives
+static bool prvInputIsStream(const std::string &inputFilepath)
+{
+    if (inputFilepath == cStdinFilepath) {
+        return true;
+    }
+    struct stat statbuf;
+    return stat(inputFilepath.c_str(), &statbuf) == 0 && S_ISFIFO(statbuf.st_mode);
+}
+
+// Makes sure the output location can be written to, returning false if it can't
+static bool prvValidateOutputFilepath(const std::string &outputFilepath)
+{
+    if (outputFilepath.empty()) {
+        fprintf(stderr, "Empty output filepath\n");
+        return false;
+    }
+    
+    // If a file is there, try to open it; if not, try to create a temporary file there
+    bool createdAFile = false;
+    int fd = open(outputFilepath.c_str(), O_WRONLY);    // This will succeed if there's a writable file there
+    if (fd < 0) {                                       // No file there, so try to create one
+        fd = open(outputFilepath.c_str(), O_WRONLY | O_CREAT, 0600);    // Readable and writable, but not executable
+        createdAFile = (fd >= 0);
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Can't write output file at \"%s\"\n", outputFilepath.c_str());
+        return false;
+    }
+    close(fd);
+    if (createdAFile) {             // Clean up the temporarily-created file
+        unlink(outputFilepath.c_str());
+    }
+    return true;
+}
+
+// Interprets a comma-separated list of NxM dimensions strings, returning false if it isn't one
+static bool prvParseGrids(const std::string &dimensionStr, std::vector<GridSize> &grids)
+{
+    if (dimensionStr.empty()) {
+        fprintf(stderr, "Empty dimensions string\n");
+        return false;
+    }
+    const std::string cDimensionsRegexStr = "(\\d+)x(\\d+)";
+    std::regex dimensionsRegex(cDimensionsRegexStr, std::regex_constants::ECMAScript);
+    grids.clear();
+    size_t gridStart = 0;
+    for (;;) {
+        size_t comma = dimensionStr.find(',', gridStart);
+        std::string gridStr = dimensionStr.substr(gridStart, comma - gridStart);
+        std::smatch smatch;
+        if (!std::regex_match(gridStr, smatch, dimensionsRegex)) {
+            fprintf(stderr, "Invalid dimensions string \"%s\"\n", gridStr.c_str());
+            return false;
+        }
+        GridSize grid;
+        grid.m_Rows = atoi(smatch[1].str().c_str());
+        grid.m_Cols = atoi(smatch[2].str().c_str());
+        if (grid.m_Cols == 0 || grid.m_Rows == 0) {
+            fprintf(stderr, "Zero values not allowed in dimensions string\n");
+            return false;
+        }
+        for (const GridSize &otherGrid : grids) {
+            if (otherGrid.m_Rows == grid.m_Rows && otherGrid.m_Cols == grid.m_Cols) {
+                fprintf(stderr, "Dimensions %s are listed twice\n", gridStr.c_str());
+                return false;
+            }
+        }
+        grids.push_back(grid);
+        if (comma == std::string::npos) {
+            break;
+        }
+        gridStart = comma + 1;
+    }
+    return true;
+}
+
+// Makes sure every grid's output location can be written to, and that no other job writes the
+// same files. With several grids, results can't all go to stdout.
+static bool prvValidateGridOutputs(const std::string &outputFilepath, const std::vector<GridSize> &grids,
+                                   std::set<std::string> &outputFilepaths)
+{
+    if (outputFilepath.empty()) {
+        if (grids.size() > 1) {
+            fprintf(stderr, "Several dimensions need an output file\n");
+            return false;
+        }
+        return true;
+    }
+    bool succeeded = true;
+    for (size_t i = 0; i < grids.size(); i++) {
+        std::string gridOutputFilepath = GridOutputFilepath(outputFilepath, grids, i);
+        if (!prvValidateOutputFilepath(gridOutputFilepath)) {
+            succeeded = false;
+        }
+        else if (!outputFilepaths.insert(gridOutputFilepath).second) {
+            fprintf(stderr, "Another job already writes \"%s\"\n", gridOutputFilepath.c_str());
+            succeeded = false;
+        }
+    }
+    return succeeded;
+}
+
+// Makes sure each grid's median ring name can be used for shared memory. The output is a name
+// rather than a file path.
+static bool prvValidateRingNames(const std::string &ringName, const std::vector<GridSize> &grids)
+{
+    bool succeeded = true;
+    for (size_t i = 0; i < grids.size(); i++) {
+        std::string shmName = MedianRingShmName(GridOutputFilepath(ringName, grids, i));
+        if (shmName.size() < 2 || shmName.find('/', 1) != std::string::npos) {
+            fprintf(stderr, "Invalid median ring name \"%s\"; it can't contain a slash after the first character\n",
+                    shmName.c_str());
+            succeeded = false;
+        }
+        else if (shmName.size() > cMedianRingMaxNameLength) {
+            fprintf(stderr, "Median ring name \"%s\" is longer than %zu characters\n", shmName.c_str(),
+                    cMedianRingMaxNameLength);
+            succeeded = false;
+        }
+    }
+    return succeeded;
+}
+
+// Interprets a job line: the input movie, the dimensions, and the output file separated by tabs.
+// If outputOptional is true, the output file can be left off. Reports any problems, returning
+// false if there were any.
+static bool prvParseBatchJob(const std::string &line, bool outputOptional, BatchJob &job,
+                             std::set<std::string> &outputFilepaths)
+{
+    std::vector<std::string> fields;
+    size_t fieldStart = 0;
+    for (;;) {
+        size_t tab = line.find('\t', fieldStart);
+        fields.push_back(line.substr(fieldStart, tab - fieldStart));
+        if (tab == std::string::npos) {
+            break;
+        }
+        fieldStart = tab + 1;
+    }
+    if (fields.size() != 3 && !(outputOptional && fields.size() == 2)) {
+        fprintf(stderr, "Expected an input file, dimensions, and output file separated by tabs\n");
+        return false;
+    }
+    
+    job.m_InputFilepath = fields[0];
+    job.m_OutputFilepath = (fields.size() == 3) ? fields[2] : std::string();
+    bool jobIsValid = prvValidateInputFilepath(job.m_InputFilepath);
+    if (!prvParseGrids(fields[1], job.m_Grids)) {
+        jobIsValid = false;
+    }
+    else if (job.m_OutputFilepath.empty() && !outputOptional) {
+        fprintf(stderr, "Empty output filepath\n");
+        jobIsValid = false;
+    }
+    else {
+        jobIsValid = prvValidateGridOutputs(job.m_OutputFilepath, job.m_Grids, outputFilepaths) && jobIsValid;
+    }
+    return jobIsValid;
+}
+
+bool ParseBatchJob(const std::string &line, bool outputOptional, BatchJob &job)
+{
+    std::set<std::string> outputFilepaths;
+    return prvParseBatchJob(line, outputOptional, job, outputFilepaths);
+}
+
+// Reads a batch manifest: one job line per line. Blank lines and lines starting with # are
+// skipped. Reports every bad line, returning false if there were any.
+static bool prvReadBatchManifest(const std::string &manifestFilepath, std::vector<BatchJob> &jobs)
+{
+    std::ifstream manifest(manifestFilepath);
+    if (!manifest) {
+        fprintf(stderr, "Can't read batch manifest at \"%s\"\n", manifestFilepath.c_str());
+        return false;
+    }
+    
+    bool succeeded = true;
+    std::set<std::string> outputFilepaths;
+    std::string line;
+    for (int lineNumber = 1; std::getline(manifest, line); lineNumber++) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        
+        BatchJob job;
+        if (!prvParseBatchJob(line, false, job, outputFilepaths)) {
+            fprintf(stderr, "%s:%d: Invalid job\n", manifestFilepath.c_str(), lineNumber);
+            succeeded = false;
+            continue;
+        }
+        jobs.push_back(job);
+    }
+    
+    if (succeeded && jobs.empty()) {
+        fprintf(stderr, "No jobs in batch manifest \"%s\"\n", manifestFilepath.c_str());
+        succeeded = false;
+    }
+    return succeeded;
+}
+
 static struct option sLongLoptions[] =
 {
     {    "input",     required_argument, NULL, 'i'    },
     {    "dim",       required_argument, NULL, 'd'    },
     {    "output",    required_argument, NULL, 'o'    },
+    {    "median",    required_argument, NULL, 'm'    },
+    {    "convert",   required_argument, NULL, 'c'    },
+    {    "keyframes-only", no_argument,    NULL, 'k'    },
+    {    "all-streams", no_argument,     NULL, 'A'    },
+    {    "segments",  required_argument, NULL, 's'    },
+    {    "workers",   required_argument, NULL, 'w'    },
+    {    "queue-depth", required_argument, NULL, 'q'    },
+    {    "band-threads", required_argument, NULL, 'b'    },
+    {    "format",    required_argument, NULL, 'F'    },
+    {    "flush",     required_argument, NULL, 'f'    },
+    {    "full-row-interval", required_argument, NULL, 'R'    },
+    {    "ring-slots", required_argument, NULL, 'r'    },
+    {    "io",        required_argument, NULL, 'I'    },
+    {    "fast-start", no_argument,      NULL, 'P'    },
+    {    "deadline",  required_argument, NULL, 'L'    },
+    {    "deadline-mode", required_argument, NULL, 'M'    },
+    {    "sample-budget", required_argument, NULL, 'G'    },
+    {    "stats",     no_argument,       NULL, 'S'    },
+    {    "batch",     required_argument, NULL, 'j'    },
+    {    "batch-threads", required_argument, NULL, 'J'    },
+    {    "daemon",    required_argument, NULL, 'D'    },
+    {    "watch",     required_argument, NULL, 'W'    },
+    {    "benchmark-csv", no_argument,     NULL, 'B'    },
     {     NULL, 0, NULL, 0                        }
 };
 
 CommandLineArguments ProcessCommandLine(int argc, char **argv)
 {
     CommandLineArguments result;
-    result.m_Rows = 0;
-    result.m_Cols = 0;
+    result.m_KeyframesOnly = false;
+    result.m_AllStreams = false;
+    result.m_SegmentCount = 1;
+    result.m_BandThreadCount = 1;
+    result.m_OutputFormat = OutputFormat::Csv;
+    result.m_FullRowInterval = 64;
+    result.m_RingSlotCount = cMedianRingDefaultSlotCount;
+    result.m_FlushPolicy = CsvFlushPolicy::WhenFull;
+    result.m_InputIOMode = InputIOMode::Ffmpeg;
+    result.m_FastStart = false;
+    result.m_DeadlineMilliseconds = 0;
+    result.m_DeadlineMode = DeadlineMode::Auto;
+    result.m_ReportStats = false;
+    result.m_BatchThreadCount = std::max<int>(std::thread::hardware_concurrency(), 1);
+    result.m_BenchmarkCsv = false;
     
     // -------- Parse the command line arguments -------- 
     
     std::string dimensionStr;
-    int ch = getopt_long(argc, argv, "i:d:o:", sLongLoptions, NULL);
+    std::string medianEngineStr;
+    std::string grayConversionStr;
+    std::string segmentCountStr;
+    std::string workerCountStr;
+    std::string queueDepthStr;
+    std::string bandThreadCountStr;
+    std::string outputFormatStr;
+    std::string flushPolicyStr;
+    std::string fullRowIntervalStr;
+    std::string deadlineStr;
+    std::string deadlineModeStr;
+    std::string sampleBudgetStr;
+    std::string ringSlotCountStr;
+    std::string inputIOModeStr;
+    std::string batchManifestFilepath;
+    std::string batchThreadCountStr;
+    int ch = getopt_long(argc, argv, "i:d:o:m:c:kAs:w:q:b:F:f:R:r:I:PL:M:G:Sj:J:D:W:B", sLongLoptions, NULL);
     bool specifiedOutputFilepath = false;
     while (ch != -1)
     {
@@ -81,83 +374,429 @@ CommandLineArguments ProcessCommandLine(int argc, char **argv)
                 result.m_OutputFilepath = optarg;
                 break;
                 
+                // Median engine
+            case 'm':
+                medianEngineStr = optarg;
+                break;
+                
+                // Grayscale conversion
+            case 'c':
+                grayConversionStr = optarg;
+                break;
+                
+                // Keyframe-only decoding
+            case 'k':
+                result.m_KeyframesOnly = true;
+                break;
+                
+                // Every video stream
+            case 'A':
+                result.m_AllStreams = true;
+                break;
+                
+                // Segment count
+            case 's':
+                segmentCountStr = optarg;
+                break;
+                
+                // Analysis worker count
+            case 'w':
+                workerCountStr = optarg;
+                break;
+                
+                // Analysis queue depth
+            case 'q':
+                queueDepthStr = optarg;
+                break;
+                
+                // Threads for analyzing bands of each frame
+            case 'b':
+                bandThreadCountStr = optarg;
+                break;
+                
+                // Output format
+            case 'F':
+                outputFormatStr = optarg;
+                break;
+                
+                // Output flush policy
+            case 'f':
+                flushPolicyStr = optarg;
+                break;
+                
+                // Full row interval for delta files
+            case 'R':
+                fullRowIntervalStr = optarg;
+                break;
+                
+                // Slot count for median rings
+            case 'r':
+                ringSlotCountStr = optarg;
+                break;
+                
+                // How the input is read
+            case 'I':
+                inputIOModeStr = optarg;
+                break;
+                
+                // Bounded stream probing
+            case 'P':
+                result.m_FastStart = true;
+                break;
+                
+                // Real-time analysis
+            case 'L':
+                deadlineStr = optarg;
+                break;
+                
+            case 'M':
+                deadlineModeStr = optarg;
+                break;
+                
+                // Approximate medians
+            case 'G':
+                sampleBudgetStr = optarg;
+                break;
+                
+                // Timing report
+            case 'S':
+                result.m_ReportStats = true;
+                break;
+                
+                // Batch manifest
+            case 'j':
+                batchManifestFilepath = optarg;
+                break;
+                
+                // Threads shared by the batch's jobs
+            case 'J':
+                batchThreadCountStr = optarg;
+                break;
+                
+                // Daemon socket
+            case 'D':
+                result.m_DaemonSocketPath = optarg;
+                break;
+                
+                // Daemon drop directory
+            case 'W':
+                result.m_WatchDirectory = optarg;
+                break;
+                
+                // CSV formatting benchmark
+            case 'B':
+                result.m_BenchmarkCsv = true;
+                break;
+                
             default:
                 usage(argv[0]);
                 break;
         }
         
         // Prepare for the next iteration
-        ch = getopt_long(argc, argv, "i:d:o:", sLongLoptions, NULL);
+        ch = getopt_long(argc, argv, "i:d:o:m:c:kAs:w:q:b:F:f:R:r:I:PL:M:G:Sj:J:D:W:B", sLongLoptions, NULL);
     }
     
     
     // -------- Interpret and validate the command line arguments -------- 
     
+    // The benchmark doesn't read a movie, so nothing else matters
+    if (result.m_BenchmarkCsv) {
+        return result;
+    }
+    
     bool errorFound = false;
     
-    // Does the input filepath point to a readable file?
-    if (result.m_InputFilepath.empty()) {
-        fprintf(stderr, "Empty input filepath\n");
+    // In batch and daemon modes, each job names its own input, dimensions, and output
+    bool isDaemon = !result.m_DaemonSocketPath.empty();
+    bool jobsNameFiles = !batchManifestFilepath.empty() || isDaemon;
+    bool inputIsStream = false;
+    if (!batchManifestFilepath.empty() && isDaemon) {
+        fprintf(stderr, "--batch and --daemon can't be used together\n");
         errorFound = true;
     }
-    else if (!prvFileIsNormalFile(result.m_InputFilepath)) {
-        fprintf(stderr, "No input file at \"%s\"\n", result.m_InputFilepath.c_str());
+    if (!result.m_WatchDirectory.empty() && !isDaemon) {
+        fprintf(stderr, "--watch needs --daemon\n");
         errorFound = true;
     }
-    else if (!prvFileIsReadable(result.m_InputFilepath)) {
-        fprintf(stderr, "Can't read input file at \"%s\"\n", result.m_InputFilepath.c_str());
-        errorFound = true;
+    if (jobsNameFiles) {
+        const char *modeName = isDaemon ? "--daemon" : "--batch";
+        if (!result.m_InputFilepath.empty() || !dimensionStr.empty() || specifiedOutputFilepath) {
+            fprintf(stderr, "--input, --dim, and --output can't be used with %s\n", modeName);
+            errorFound = true;
+        }
+        if (!bandThreadCountStr.empty()) {
+            fprintf(stderr, "--band-threads can't be used with %s; bands use the jobs' threads\n", modeName);
+            errorFound = true;
+        }
     }
-    
-    // Validate and interpret the dimensions string
-    if (dimensionStr.empty()) {
-        fprintf(stderr, "Empty dimensions string\n");
-        errorFound = true;
+    if (isDaemon) {
+        struct sockaddr_un address;
+        if (result.m_DaemonSocketPath.size() >= sizeof(address.sun_path)) {
+            fprintf(stderr, "The socket path \"%s\" is longer than %zu characters\n", result.m_DaemonSocketPath.c_str(),
+                    sizeof(address.sun_path) - 1);
+            errorFound = true;
+        }
+        struct stat statbuf;
+        if (!result.m_WatchDirectory.empty() &&
+            (stat(result.m_WatchDirectory.c_str(), &statbuf) != 0 || !S_ISDIR(statbuf.st_mode))) {
+            fprintf(stderr, "No directory to watch at \"%s\"\n", result.m_WatchDirectory.c_str());
+            errorFound = true;
+        }
+    }
+    else if (!batchManifestFilepath.empty()) {
+        if (!prvReadBatchManifest(batchManifestFilepath, result.m_BatchJobs)) {
+            errorFound = true;
+        }
     }
     else {
-        const std::string cDimensionsRegexStr = "(\\d+)x(\\d+)";
-        std::regex dimensionsRegex(cDimensionsRegexStr, std::regex_constants::ECMAScript);
-        std::smatch smatch;
-        bool matches = std::regex_match(dimensionStr, smatch, dimensionsRegex);
-        if (!matches) {
-            fprintf(stderr, "Invalid dimensions string\n");
+        // Does the input filepath point to a readable file, or a stream? Opening a FIFO to check
+        // it would wait for a writer, so only its permissions are checked.
+        inputIsStream = prvInputIsStream(result.m_InputFilepath);
+        if (!inputIsStream && !prvValidateInputFilepath(result.m_InputFilepath)) {
             errorFound = true;
         }
+        if (inputIsStream && result.m_InputFilepath != cStdinFilepath &&
+            access(result.m_InputFilepath.c_str(), R_OK) != 0) {
+            fprintf(stderr, "Can't read input FIFO at \"%s\"\n", result.m_InputFilepath.c_str());
+            errorFound = true;
+        }
+        
+        // Validate and interpret the dimensions string
+        if (!prvParseGrids(dimensionStr, result.m_Grids)) {
+            errorFound = true;
+        }
+    }
+    
+    // Validate the batch thread count, if one was given
+    if (!batchThreadCountStr.empty()) {
+        if (!jobsNameFiles) {
+            fprintf(stderr, "--batch-threads needs --batch or --daemon\n");
+            errorFound = true;
+        }
+        else if (!prvParseCount(batchThreadCountStr, result.m_BatchThreadCount)) {
+            fprintf(stderr, "Invalid batch thread count \"%s\"\n", batchThreadCountStr.c_str());
+            errorFound = true;
+        }
+    }
+    
+    // Interpret the median engine name, if one was given
+    if (!medianEngineStr.empty()) {
+        if (medianEngineStr == "sort") {
+            result.m_ProcessorOptions.m_MedianEngine = MedianEngine::Sort;
+        }
+        else if (medianEngineStr == "histogram") {
+            result.m_ProcessorOptions.m_MedianEngine = MedianEngine::Histogram;
+        }
         else {
-            result.m_Rows = atoi(smatch[1].str().c_str());
-            result.m_Cols = atoi(smatch[2].str().c_str());
-            if (result.m_Cols == 0 || result.m_Rows == 0) {
-                fprintf(stderr, "Zero values not allowed in dimensions string\n");
-                errorFound = true;
-            }
+            fprintf(stderr, "Invalid median engine \"%s\"\n", medianEngineStr.c_str());
+            errorFound = true;
         }
     }
     
-    // If the output filepath is specified, make sure the location can be written to
-    if (specifiedOutputFilepath) {
-        if (result.m_OutputFilepath.empty()) {
-            fprintf(stderr, "Empty output filepath\n");
+    // Interpret the grayscale conversion name, if one was given
+    if (!grayConversionStr.empty()) {
+        if (grayConversionStr == "auto") {
+            result.m_ProcessorOptions.m_GrayConversion = GrayConversion::Auto;
+        }
+        else if (grayConversionStr == "sws") {
+            result.m_ProcessorOptions.m_GrayConversion = GrayConversion::Swscale;
+        }
+        else {
+            fprintf(stderr, "Invalid grayscale conversion \"%s\"\n", grayConversionStr.c_str());
             errorFound = true;
         }
+    }
+    
+    // Interpret the input I/O mode, if one was given
+    if (!inputIOModeStr.empty()) {
+        if (inputIOModeStr == "ffmpeg") {
+            result.m_InputIOMode = InputIOMode::Ffmpeg;
+        }
+        else if (inputIOModeStr == "mmap") {
+            result.m_InputIOMode = InputIOMode::Mmap;
+        }
+        else if (inputIOModeStr == "readahead") {
+            result.m_InputIOMode = InputIOMode::ReadAhead;
+        }
+        else if (inputIOModeStr == "stream") {
+            result.m_InputIOMode = InputIOMode::Stream;
+        }
         else {
-            // If a file is there, try to open it; if not, try to create a temporary file there
-            bool createdAFile = false;
-            int fd = open(result.m_OutputFilepath.c_str(), O_WRONLY);    // This will succeed if there's a writable file there
-            if (fd < 0) {                                       // No file there, so try to create one
-                fd = open(result.m_OutputFilepath.c_str(), O_WRONLY | O_CREAT, 0600);    // Readable and writable, but not executable
-                createdAFile = (fd >= 0);
+            fprintf(stderr, "Invalid input I/O mode \"%s\"\n", inputIOModeStr.c_str());
+            errorFound = true;
+        }
+    }
+    
+    // Stdin and FIFOs can only be streamed
+    if (inputIsStream) {
+        if (!inputIOModeStr.empty() && result.m_InputIOMode != InputIOMode::Stream) {
+            fprintf(stderr, "--io %s can't read from stdin or a FIFO\n", inputIOModeStr.c_str());
+            errorFound = true;
+        }
+        result.m_InputIOMode = InputIOMode::Stream;
+    }
+    
+    // Validate the segment count, if one was given
+    if (!segmentCountStr.empty() && !prvParseCount(segmentCountStr, result.m_SegmentCount)) {
+        fprintf(stderr, "Invalid segment count \"%s\"\n", segmentCountStr.c_str());
+        errorFound = true;
+    }
+    
+    // Validate the pipeline settings, if any were given
+    if (!workerCountStr.empty() && !prvParseCount(workerCountStr, result.m_PipelineOptions.m_WorkerCount)) {
+        fprintf(stderr, "Invalid worker count \"%s\"\n", workerCountStr.c_str());
+        errorFound = true;
+    }
+    if (!queueDepthStr.empty() && !prvParseCount(queueDepthStr, result.m_PipelineOptions.m_QueueDepth)) {
+        fprintf(stderr, "Invalid queue depth \"%s\"\n", queueDepthStr.c_str());
+        errorFound = true;
+    }
+    if (!bandThreadCountStr.empty() && !prvParseCount(bandThreadCountStr, result.m_BandThreadCount)) {
+        fprintf(stderr, "Invalid band thread count \"%s\"\n", bandThreadCountStr.c_str());
+        errorFound = true;
+    }
+    
+    // Interpret the output format, if one was given. Median files are finished by rewriting their
+    // header, so they can't go to stdout.
+    if (!outputFormatStr.empty()) {
+        if (outputFormatStr == "csv") {
+            result.m_OutputFormat = OutputFormat::Csv;
+        }
+        else if (outputFormatStr == "binary") {
+            result.m_OutputFormat = OutputFormat::Binary;
+            if (!specifiedOutputFilepath && !jobsNameFiles) {
+                fprintf(stderr, "The binary format needs an output file\n");
+                errorFound = true;
             }
-            if (fd < 0) {
-                fprintf(stderr, "Can't write output file at \"%s\"\n", result.m_OutputFilepath.c_str());
+        }
+        else if (outputFormatStr == "delta") {
+            result.m_OutputFormat = OutputFormat::Delta;
+        }
+        else if (outputFormatStr == "ring") {
+            result.m_OutputFormat = OutputFormat::Ring;
+            if (jobsNameFiles) {
+                fprintf(stderr, "The ring format can't be used with --batch or --daemon\n");
                 errorFound = true;
             }
-            else {
-                close(fd);
-                if (createdAFile) {             // Clean up the temporarily-created file
-                    unlink(result.m_OutputFilepath.c_str());
-                }
+            else if (!specifiedOutputFilepath) {
+                fprintf(stderr, "The ring format needs a ring name as the output\n");
+                errorFound = true;
             }
         }
+        else {
+            fprintf(stderr, "Invalid output format \"%s\"\n", outputFormatStr.c_str());
+            errorFound = true;
+        }
+    }
+    
+    // Validate the full row interval, if one was given
+    if (!fullRowIntervalStr.empty()) {
+        if (result.m_OutputFormat != OutputFormat::Delta) {
+            fprintf(stderr, "--full-row-interval needs --format delta\n");
+            errorFound = true;
+        }
+        else if (!prvParseCount(fullRowIntervalStr, result.m_FullRowInterval)) {
+            fprintf(stderr, "Invalid full row interval \"%s\"\n", fullRowIntervalStr.c_str());
+            errorFound = true;
+        }
+    }
+    
+    // Validate the ring slot count, if one was given
+    if (!ringSlotCountStr.empty()) {
+        if (result.m_OutputFormat != OutputFormat::Ring) {
+            fprintf(stderr, "--ring-slots needs --format ring\n");
+            errorFound = true;
+        }
+        else if (!prvParseCount(ringSlotCountStr, result.m_RingSlotCount)) {
+            fprintf(stderr, "Invalid ring slot count \"%s\"\n", ringSlotCountStr.c_str());
+            errorFound = true;
+        }
+    }
+    
+    // Interpret the flush policy, if one was given
+    if (!flushPolicyStr.empty()) {
+        if (flushPolicyStr == "buffer") {
+            result.m_FlushPolicy = CsvFlushPolicy::WhenFull;
+        }
+        else if (flushPolicyStr == "frame") {
+            result.m_FlushPolicy = CsvFlushPolicy::EveryFrame;
+        }
+        else {
+            fprintf(stderr, "Invalid flush policy \"%s\"\n", flushPolicyStr.c_str());
+            errorFound = true;
+        }
+    }
+    else if (result.m_InputIOMode == InputIOMode::Stream) {
+        result.m_FlushPolicy = CsvFlushPolicy::EveryFrame;  // Each row goes out as soon as it's ready
+    }
+    
+    // Validate the sample budget, if one was given
+    if (!sampleBudgetStr.empty() && !prvParseCount(sampleBudgetStr, result.m_ProcessorOptions.m_SampleBudget)) {
+        fprintf(stderr, "Invalid sample budget \"%s\"\n", sampleBudgetStr.c_str());
+        errorFound = true;
+    }
+    
+    // Validate the deadline, if one was given. It paces a single pass over the keyframes as they
+    // arrive, and needs a format with a column for each row's mode.
+    if (!deadlineStr.empty()) {
+        if (!prvParseCount(deadlineStr, result.m_DeadlineMilliseconds)) {
+            fprintf(stderr, "Invalid deadline \"%s\"\n", deadlineStr.c_str());
+            errorFound = true;
+        }
+        if (result.m_SegmentCount > 1 || result.m_PipelineOptions.m_WorkerCount > 0) {
+            fprintf(stderr, "--deadline can't be used with --segments or --workers\n");
+            errorFound = true;
+        }
+        if (result.m_OutputFormat != OutputFormat::Csv) {
+            fprintf(stderr, "--deadline needs the CSV format\n");
+            errorFound = true;
+        }
+    }
+    
+    // Interpret the deadline mode, if one was given
+    if (!deadlineModeStr.empty()) {
+        if (deadlineStr.empty()) {
+            fprintf(stderr, "--deadline-mode needs --deadline\n");
+            errorFound = true;
+        }
+        else if (deadlineModeStr == "auto") {
+            result.m_DeadlineMode = DeadlineMode::Auto;
+        }
+        else if (deadlineModeStr == "exact") {
+            result.m_DeadlineMode = DeadlineMode::Exact;
+        }
+        else if (deadlineModeStr == "subsampled") {
+            result.m_DeadlineMode = DeadlineMode::Subsampled;
+        }
+        else if (deadlineModeStr == "reduced") {
+            result.m_DeadlineMode = DeadlineMode::Reduced;
+        }
+        else {
+            fprintf(stderr, "Invalid deadline mode \"%s\"\n", deadlineModeStr.c_str());
+            errorFound = true;
+        }
+    }
+    
+    // If the output filepath is specified, make sure the locations can be written to
+    if (specifiedOutputFilepath && result.m_OutputFilepath.empty()) {
+        fprintf(stderr, "Empty output filepath\n");
+        errorFound = true;
+    }
+    else if (result.m_AllStreams && !jobsNameFiles && !specifiedOutputFilepath) {
+        fprintf(stderr, "--all-streams needs an output file\n");
+        errorFound = true;
+    }
+    else if (result.m_OutputFormat == OutputFormat::Ring) {
+        if (!jobsNameFiles && !prvValidateRingNames(result.m_OutputFilepath, result.m_Grids)) {
+            errorFound = true;
+        }
+    }
+    else if (!jobsNameFiles && !result.m_Grids.empty()) {
+        std::set<std::string> outputFilepaths;
+        if (!prvValidateGridOutputs(result.m_OutputFilepath, result.m_Grids, outputFilepaths)) {
+            errorFound = true;
+        }
     }
     
     if (errorFound) {
@@ -167,8 +806,64 @@ CommandLineArguments ProcessCommandLine(int argc, char **argv)
     return result;
 }
 
+// Inserts a suffix before the extension of the last path component, if it has one
+static std::string prvInsertBeforeExtension(const std::string &filepath, const std::string &suffix)
+{
+    size_t nameStart = filepath.rfind('/');
+    nameStart = (nameStart == std::string::npos) ? 0 : nameStart + 1;
+    size_t extensionStart = filepath.rfind('.');
+    if (extensionStart == std::string::npos || extensionStart <= nameStart) {
+        extensionStart = filepath.size();
+    }
+    return filepath.substr(0, extensionStart) + suffix + filepath.substr(extensionStart);
+}
+
+std::string StreamOutputFilepath(const std::string &outputFilepath, int streamIndex)
+{
+    assert(!outputFilepath.empty());
+    return prvInsertBeforeExtension(outputFilepath, "_stream" + std::to_string(streamIndex));
+}
+
+bool ValidateStreamOutputs(const CommandLineArguments &cliArgs, const std::vector<int> &streamIndices)
+{
+    bool succeeded = true;
+    std::set<std::string> outputFilepaths;
+    for (int streamIndex : streamIndices) {
+        std::string streamOutputFilepath = StreamOutputFilepath(cliArgs.m_OutputFilepath, streamIndex);
+        if (cliArgs.m_OutputFormat == OutputFormat::Ring) {
+            succeeded = prvValidateRingNames(streamOutputFilepath, cliArgs.m_Grids) && succeeded;
+        }
+        else {
+            succeeded = prvValidateGridOutputs(streamOutputFilepath, cliArgs.m_Grids, outputFilepaths) && succeeded;
+        }
+    }
+    return succeeded;
+}
+
+std::string GridOutputFilepath(const std::string &outputFilepath, const std::vector<GridSize> &grids,
+                               size_t gridIndex)
+{
+    assert(gridIndex < grids.size());
+    if (grids.size() == 1 || outputFilepath.empty()) {
+        return outputFilepath;
+    }
+    const GridSize &grid = grids[gridIndex];
+    return prvInsertBeforeExtension(outputFilepath, "_" + std::to_string(grid.m_Rows) + "x" + std::to_string(grid.m_Cols));
+}
+
 void usage(const char* exeName)
 {
-    fprintf(stderr, "Usage: %s --input <input movie file> --dim <NxM> [--output <output file>]\n", exeName);
+    fprintf(stderr, "Usage: %s --input <movie file, FIFO, or -> --dim <NxM>[,<NxM>...] [--output <output file>]\n"
+                    "        [--median <sort|histogram>] [--convert <auto|sws>] [--keyframes-only] [--all-streams]\n"
+                    "        [--segments <count>] [--workers <count>] [--queue-depth <count>]\n"
+                    "        [--band-threads <count>] [--format <csv|binary|delta|ring>] [--flush <buffer|frame>]\n"
+                    "        [--full-row-interval <count>] [--ring-slots <count>] [--io <ffmpeg|mmap|readahead|stream>]\n"
+                    "        [--fast-start] [--deadline <milliseconds>]\n"
+                    "        [--deadline-mode <auto|exact|subsampled|reduced>] [--sample-budget <count>] [--stats]\n"
+                    "   or: %s --batch <manifest> [--batch-threads <count>] [options other than\n"
+                    "        --input, --dim, and --output]\n"
+                    "   or: %s --daemon <socket path> [--watch <directory>] [--batch-threads <count>]\n"
+                    "        [options other than --input, --dim, and --output]\n"
+                    "   or: %s --benchmark-csv\n", exeName, exeName, exeName, exeName);
     exit(-1);
 };
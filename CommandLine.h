@@ -6,16 +6,80 @@
 #define __COMMANDLINE_H__ 1
 
 #include <string>
+#include <vector>
 
-struct CommandLineArguments
+#include "CsvWriter.hpp"
+#include "DeadlineScheduler.hpp"
+#include "FrameProcessor.hpp"
+#include "InputIO.hpp"
+#include "KeyframePipeline.hpp"
+#include "MedianRing.hpp"
+
+// How results are written
+enum class OutputFormat {
+    Csv,            // A line of text per keyframe
+    Binary,         // A median file (see MedianFile.hpp), for memory-mapping
+    Delta,          // A delta file (see DeltaFile.hpp), for archiving
+    Ring            // A median ring (see MedianRing.hpp) in shared memory, for readers on the same host
+};
+
+// One movie to analyze in batch mode, from a line of the manifest
+struct BatchJob
 {
     std::string m_InputFilepath;
+    std::vector<GridSize> m_Grids;
     std::string m_OutputFilepath;
-    int         m_Cols;
-    int         m_Rows;
+};
+
+struct CommandLineArguments
+{
+    std::string m_InputFilepath;
+    std::string m_OutputFilepath;           // Empty for stdout
+    std::vector<GridSize> m_Grids;          // At least one, unless in batch mode
+    bool        m_AllStreams;               // Analyze every video stream, not just the first
+    FrameProcessorOptions m_ProcessorOptions;
+    bool        m_KeyframesOnly;
+    int         m_SegmentCount;
+    PipelineOptions m_PipelineOptions;
+    int         m_BandThreadCount;
+    OutputFormat m_OutputFormat;
+    int         m_FullRowInterval;
+    int         m_RingSlotCount;
+    CsvFlushPolicy m_FlushPolicy;
+    InputIOMode m_InputIOMode;
+    bool        m_FastStart;                // Probe as little of the input as will find the video
+    int         m_DeadlineMilliseconds;     // Each keyframe's budget for real-time analysis, or 0 for none
+    DeadlineMode m_DeadlineMode;            // How each keyframe's analysis is picked with a deadline
+    bool        m_ReportStats;
+    std::vector<BatchJob> m_BatchJobs;      // Not empty in batch mode
+    int         m_BatchThreadCount;         // Also used by the daemon
+    std::string m_DaemonSocketPath;         // Not empty in daemon mode
+    std::string m_WatchDirectory;           // Where the daemon looks for manifests, if anywhere
+    bool        m_BenchmarkCsv;
 };
 
 CommandLineArguments    ProcessCommandLine(int argc, char **argv);
+
+// Interprets a line of a batch manifest, or a job sent to the daemon: the input movie, the
+// dimensions, and the output file separated by tabs. If outputOptional is true, the output file
+// can be left off. Reports any problems to stderr, returning false if there were any.
+bool ParseBatchJob(const std::string &line, bool outputOptional, BatchJob &job);
+
+// Where a video stream's results go with --all-streams: the output path with "_stream<index>"
+// inserted before the extension
+std::string StreamOutputFilepath(const std::string &outputFilepath, int streamIndex);
+
+// Makes sure every grid's output for each of the streams --all-streams analyzes can be written
+// to, and that no two are the same file. The stream indices aren't known until the movie is
+// open, so this can't be checked along with the command line. Reports any problems to stderr,
+// returning false if there were any.
+bool ValidateStreamOutputs(const CommandLineArguments &cliArgs, const std::vector<int> &streamIndices);
+
+// Where a grid's results go. With one grid, that's the output path as given; with several, each
+// grid's path has "_<rows>x<cols>" inserted before the extension.
+std::string GridOutputFilepath(const std::string &outputFilepath, const std::vector<GridSize> &grids,
+                               size_t gridIndex);
+
 void usage(const char* exeName);
 
 #endif // __COMMANDLINE_H__
@@ -0,0 +1,115 @@
+//
+//  CsvBenchmark.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "CsvBenchmark.hpp"
+#include "CsvWriter.hpp"
+#include "FrameData.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+// The formatting sample_p used before CsvWriter, kept here as the reference
+static std::string prvOstreamReport(const std::vector<FrameData> &frames)
+{
+    std::ostringstream accum;
+    
+    for (const FrameData &fr : frames) {
+        accum << fr.m_Timestamp;
+        
+        for (int med : fr.m_CellGrayMedians) {
+            accum << "," << med;
+        }
+        
+        accum << std::endl;
+    }
+    
+    return accum.str();
+}
+
+static std::string prvReadFile(FILE *file)
+{
+    std::string contents;
+    rewind(file);
+    char block[64 * 1024];
+    size_t readCount = fread(block, 1, sizeof(block), file);
+    while (readCount > 0) {
+        contents.append(block, readCount);
+        readCount = fread(block, 1, sizeof(block), file);
+    }
+    return contents;
+}
+
+static double prvMillisecondsSince(std::chrono::steady_clock::time_point startTime)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    return elapsed.count();
+}
+
+
+bool RunCsvBenchmark(int frameCount, int gridRows, int gridCols)
+{
+    // Make up results with the timestamps of a 29.97 fps movie with a keyframe every 2 seconds,
+    // plus some that stress the formatting of doubles
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> medianDistribution(0, 255);
+    std::vector<FrameData> frames(frameCount);
+    for (int i = 0; i < frameCount; i++) {
+        FrameData &frame = frames[i];
+        frame.m_Timestamp = (i * 60 * 1001) / 30000.0;
+        if (i % 100 == 99) {
+            frame.m_Timestamp = (i % 200 == 99) ? 1.0e-7 * i : 1.0e9 * i;
+        }
+        frame.m_CellGrayMedians.resize((size_t)gridRows * (size_t)gridCols);
+        for (int &med : frame.m_CellGrayMedians) {
+            med = medianDistribution(generator);
+        }
+    }
+    
+    // Time both ways of producing the text. Both include writing it to a file.
+    FILE *referenceFile = tmpfile();
+    FILE *csvFile = tmpfile();
+    if (referenceFile == NULL || csvFile == NULL) {
+        fprintf(stderr, "Can't create a temporary file\n");
+        return false;
+    }
+    
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::string referenceText = prvOstreamReport(frames);
+    referenceText += "\n";
+    fwrite(referenceText.data(), 1, referenceText.size(), referenceFile);
+    fflush(referenceFile);
+    double referenceMilliseconds = prvMillisecondsSince(startTime);
+    
+    startTime = std::chrono::steady_clock::now();
+    bool wroteCsv = false;
+    {
+        CsvWriter csvWriter(csvFile);
+        for (const FrameData &frame : frames) {
+            csvWriter.WriteFrame(frame);
+        }
+        wroteCsv = csvWriter.Finish();
+    }
+    double csvMilliseconds = prvMillisecondsSince(startTime);
+    
+    // Compare them
+    bool identical = wroteCsv && (prvReadFile(csvFile) == prvReadFile(referenceFile));
+    fclose(referenceFile);
+    fclose(csvFile);
+    
+    double megabytes = referenceText.size() / (1024.0 * 1024.0);
+    printf("%d frames of %dx%d cells, %.1f MB\n", frameCount, gridRows, gridCols, megabytes);
+    printf("std::ostream: %8.1f ms  (%.0f MB/s)\n", referenceMilliseconds, megabytes * 1000.0 / referenceMilliseconds);
+    printf("CsvWriter:    %8.1f ms  (%.0f MB/s)\n", csvMilliseconds, megabytes * 1000.0 / csvMilliseconds);
+    printf("Output is %s\n", identical ? "identical" : "DIFFERENT");
+    return identical;
+}
@@ -0,0 +1,17 @@
+//
+//  CsvBenchmark.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef CsvBenchmark_hpp
+#define CsvBenchmark_hpp
+
+// Formats synthetic results for a grid with both CsvWriter and the std::ostream code it
+// replaced, reports the time each takes to stdout, and returns whether their output is
+// byte-for-byte identical
+bool RunCsvBenchmark(int frameCount, int gridRows, int gridCols);
+
+#endif /* CsvBenchmark_hpp */
@@ -0,0 +1,145 @@
+//
+//  CsvWriter.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "CsvWriter.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+// The buffer is written once it holds this much
+static const size_t cFlushThreshold = 4 * 1024 * 1024;
+
+// "%g" is how std::ostream formats a double by default, and it never needs more than this
+static const size_t cMaxTimestampSize = 32;
+
+// Each FrameMode's column, with its leading comma
+static const char* const cModeTexts[3] = {",exact", ",subsampled", ",reduced"};
+static const size_t cMaxModeSize = 11;
+
+
+// Each possible median, formatted with its leading comma. The text is padded to 4 bytes so it
+// can always be copied with one fixed-size store; only m_Length bytes of it are kept.
+struct CellText
+{
+    char    m_Text[4];
+    uint8_t m_Length;
+};
+
+static const CellText* prvCellTextTable()
+{
+    static CellText sTable[256];
+    static bool sTableIsBuilt = [] {
+        for (int value = 0; value < 256; value++) {
+            CellText &cellText = sTable[value];
+            char text[8];
+            int length = snprintf(text, sizeof(text), ",%d", value);
+            memset(cellText.m_Text, 0, sizeof(cellText.m_Text));
+            memcpy(cellText.m_Text, text, length);
+            cellText.m_Length = (uint8_t)length;
+        }
+        return true;
+    }();
+    (void)sTableIsBuilt;
+    return sTable;
+}
+
+
+CsvWriter::CsvWriter(FILE *file, CsvFlushPolicy flushPolicy, bool writeModes) :
+m_File(file),
+m_FlushPolicy(flushPolicy),
+m_WriteModes(writeModes),
+m_Buffer(cFlushThreshold),
+m_BufferUsed(0),
+m_WriteFailed(false)
+{
+    assert(m_File != nullptr);
+}
+
+CsvWriter::~CsvWriter()
+{
+    prvWriteBuffer();
+}
+
+
+size_t CsvWriter::MaxLineSize(size_t cellCount)
+{
+    // The cells' padding means the last one can store 3 bytes past its text
+    return cMaxTimestampSize + cMaxModeSize + cellCount * sizeof(CellText::m_Text) + 1;
+}
+
+
+size_t CsvWriter::FormatLine(const FrameData &frameData, char *line, bool writeMode)
+{
+    char *next = line;
+    next += snprintf(next, cMaxTimestampSize, "%g", frameData.m_Timestamp);
+    if (writeMode) {
+        const char *modeText = cModeTexts[(int)frameData.m_Mode];
+        size_t modeLength = strlen(modeText);
+        memcpy(next, modeText, modeLength);
+        next += modeLength;
+    }
+    
+    const CellText *cellTextTable = prvCellTextTable();
+    for (int med : frameData.m_CellGrayMedians) {
+        assert(med >= 0 && med <= 255);
+        const CellText &cellText = cellTextTable[med];
+        memcpy(next, cellText.m_Text, sizeof(cellText.m_Text));
+        next += cellText.m_Length;
+    }
+    
+    *next++ = '\n';
+    return next - line;
+}
+
+
+void CsvWriter::WriteFrame(const FrameData &frameData)
+{
+    // Make room for the line, growing the buffer for a line too long to fit even when empty
+    size_t maxLineSize = MaxLineSize(frameData.m_CellGrayMedians.size());
+    if (m_BufferUsed + maxLineSize > m_Buffer.size()) {
+        prvWriteBuffer();
+        if (maxLineSize > m_Buffer.size()) {
+            m_Buffer.resize(maxLineSize);
+        }
+    }
+    
+    m_BufferUsed += FormatLine(frameData, m_Buffer.data() + m_BufferUsed, m_WriteModes);
+    if (m_FlushPolicy == CsvFlushPolicy::EveryFrame) {
+        Flush();
+    }
+}
+
+
+bool CsvWriter::Finish()
+{
+    if (m_BufferUsed == m_Buffer.size()) {
+        prvWriteBuffer();
+    }
+    m_Buffer[m_BufferUsed++] = '\n';
+    Flush();
+    return !m_WriteFailed;
+}
+
+
+void CsvWriter::Flush()
+{
+    prvWriteBuffer();
+    m_WriteFailed = m_WriteFailed || (fflush(m_File) != 0);
+}
+
+
+// Hands the buffer's contents to the file
+void CsvWriter::prvWriteBuffer()
+{
+    if (m_BufferUsed > 0) {
+        size_t writtenCount = fwrite(m_Buffer.data(), 1, m_BufferUsed, m_File);
+        m_WriteFailed = m_WriteFailed || (writtenCount != m_BufferUsed);
+        m_BufferUsed = 0;
+    }
+}
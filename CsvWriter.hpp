@@ -0,0 +1,60 @@
+//
+//  CsvWriter.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef CsvWriter_hpp
+#define CsvWriter_hpp
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "FrameData.hpp"
+
+// When a CsvWriter hands its buffer to the file
+enum class CsvFlushPolicy {
+    WhenFull,       // Write in large blocks; best for throughput
+    EveryFrame      // Write and flush each line as soon as it's formatted, for watching live output
+};
+
+// Writes each keyframe's results as a line of comma-separated values: the timestamp, then, if
+// asked for, how the medians were found ("exact", "subsampled", or "reduced"), then the cell
+// medians. Lines are formatted straight into a large buffer without allocating, and memory
+// use doesn't depend on the movie's length. The text is byte-for-byte what std::ostream gives
+// for the same values.
+class CsvWriter : public FrameDataSink
+{
+public:
+    // Writes to a file that's already open; the caller closes it after this is destroyed
+    explicit CsvWriter(FILE *file, CsvFlushPolicy flushPolicy = CsvFlushPolicy::WhenFull, bool writeModes = false);
+    ~CsvWriter();
+    
+    void WriteFrame(const FrameData &frameData) override;
+    
+    // Ends the output with an empty line, as sample_p always has, and writes everything that's
+    // buffered. Returns false if any write failed.
+    bool Finish() override;
+    
+    // Writes everything that's buffered
+    void Flush();
+    
+    // Formats one line into a buffer with room for MaxLineSize(), and returns its length
+    static size_t FormatLine(const FrameData &frameData, char *line, bool writeMode = false);
+    static size_t MaxLineSize(size_t cellCount);
+
+private:
+    FILE*           m_File;
+    CsvFlushPolicy  m_FlushPolicy;
+    bool            m_WriteModes;
+    std::vector<char> m_Buffer;
+    size_t          m_BufferUsed;
+    bool            m_WriteFailed;
+    
+    void prvWriteBuffer();
+};
+
+#endif /* CsvWriter_hpp */
@@ -0,0 +1,200 @@
+//
+//  DeadlineScheduler.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "DeadlineScheduler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+
+#if defined(__cplusplus)
+}
+#endif
+
+#include "ElapsedTime.hpp"
+#include "FrameProcessor.hpp"
+
+// How much each new timing moves a mode's recent seconds per keyframe
+static const double cTimingWeight = 0.25;
+
+// Until both have been timed, subsampling is guessed to take this much of the exact analysis's
+// time
+static const double cSubsampledTimeGuess = 0.35;
+
+// Set as the decoder's reordered_opaque while it skips its loop filter. The decoder copies it to
+// the frames decoded from the packets it's given then, so each frame says how it was decoded, even
+// when the decoder holds frames back for its threads.
+static const int64_t cReducedDecodeMarker = 0x5245445543454400;     // "REDUCED"
+
+static const char* const cFrameModeNames[3] = {"exact", "subsampled", "reduced"};
+
+
+static std::chrono::steady_clock::time_point prvSecondsAfter(std::chrono::steady_clock::time_point startTime,
+                                                             double seconds)
+{
+    return startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           std::chrono::duration<double>(seconds));
+}
+
+
+#pragma mark - DeadlineStats
+
+DeadlineStats::DeadlineStats() :
+m_ModeRowCounts{0, 0, 0},
+m_LateRowCount(0),
+m_MaxLagSeconds(0.0)
+{
+}
+
+
+void DeadlineStats::Add(const size_t modeRowCounts[3], size_t lateRowCount, double maxLagSeconds)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (int i = 0; i < 3; i++) {
+        m_ModeRowCounts[i] += modeRowCounts[i];
+    }
+    m_LateRowCount += lateRowCount;
+    m_MaxLagSeconds = std::max(m_MaxLagSeconds, maxLagSeconds);
+}
+
+
+void DeadlineStats::Report(FILE *file) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    fprintf(file, "Deadline rows:  ");
+    for (int i = 0; i < 3; i++) {
+        fprintf(file, "%s%zu %s", (i == 0) ? "" : ", ", m_ModeRowCounts[i], cFrameModeNames[i]);
+    }
+    fprintf(file, "\n");
+    if (m_LateRowCount == 0) {
+        fprintf(file, "Late rows:      none\n");
+    }
+    else {
+        fprintf(file, "Late rows:      %8zu, by up to %.3f s\n", m_LateRowCount, m_MaxLagSeconds);
+    }
+}
+
+
+#pragma mark - DeadlineScheduler
+
+DeadlineScheduler::DeadlineScheduler(double budgetSeconds, AVStream *stream, AVCodecContext *codecContext,
+                                     DeadlineMode mode) :
+m_BudgetSeconds(budgetSeconds),
+m_Mode(mode),
+m_Stream(stream),
+m_CodecContext(codecContext),
+m_SavedSkipLoopFilter(codecContext->skip_loop_filter),
+m_SavedReorderedOpaque(codecContext->reordered_opaque),
+m_ReducingDecode(false),
+m_Started(false),
+m_FirstFrameSeconds(0.0),
+m_ExactSeconds(-1.0),
+m_SubsampledSeconds(-1.0),
+m_SubsampledRatio(cSubsampledTimeGuess),
+m_ModeRowCounts{0, 0, 0},
+m_LateRowCount(0),
+m_MaxLagSeconds(0.0)
+{
+    assert(m_BudgetSeconds > 0.0);
+}
+
+DeadlineScheduler::~DeadlineScheduler()
+{
+    m_CodecContext->skip_loop_filter = (AVDiscard)m_SavedSkipLoopFilter;
+    m_CodecContext->reordered_opaque = m_SavedReorderedOpaque;
+}
+
+
+void DeadlineScheduler::ProcessKeyFrame(FrameProcessor &frameProcessor, const AVFrame *keyframe, FrameDataSink *sink)
+{
+    // Work out when the keyframe is due. A keyframe without a timestamp is just given the budget.
+    TimePoint arrivalTime = std::chrono::steady_clock::now();
+    TimePoint dueTime = prvSecondsAfter(arrivalTime, m_BudgetSeconds);
+    int64_t frameTime = (keyframe->pts != AV_NOPTS_VALUE) ? keyframe->pts : keyframe->best_effort_timestamp;
+    if (frameTime != AV_NOPTS_VALUE) {
+        double frameSeconds = frameTime * av_q2d(m_Stream->time_base);
+        if (!m_Started) {
+            m_Started = true;
+            m_FirstArrivalTime = arrivalTime;
+            m_FirstFrameSeconds = frameSeconds;
+        }
+        dueTime = prvSecondsAfter(m_FirstArrivalTime, frameSeconds - m_FirstFrameSeconds + m_BudgetSeconds);
+    }
+    double secondsLeft = SecondsBetween(arrivalTime, dueTime);
+    
+    // Pick the most exact analysis expected to finish in time, and if even subsampling won't,
+    // cheapen the decoding of the frames to come too
+    double exactSeconds = std::max(m_ExactSeconds, 0.0);
+    double subsampledSeconds = (m_SubsampledSeconds >= 0.0) ? m_SubsampledSeconds : exactSeconds * m_SubsampledRatio;
+    bool subsample = exactSeconds > secondsLeft;
+    bool reduceDecode = subsample && subsampledSeconds > secondsLeft;
+    if (m_Mode != DeadlineMode::Auto) {
+        subsample = (m_Mode != DeadlineMode::Exact);
+        reduceDecode = (m_Mode == DeadlineMode::Reduced);
+    }
+    prvSetReducedDecode(reduceDecode);
+    
+    FrameData frameData;
+    frameProcessor.AnalyzeKeyFrame(keyframe, frameData, subsample);
+    double analysisSeconds = SecondsBetween(arrivalTime, std::chrono::steady_clock::now());
+    double &recentSeconds = subsample ? m_SubsampledSeconds : m_ExactSeconds;
+    recentSeconds = (recentSeconds < 0.0) ? analysisSeconds : recentSeconds + cTimingWeight * (analysisSeconds - recentSeconds);
+    
+    // Exact analysis isn't timed while subsampling, so its time follows what the subsampled time
+    // says it would be now. Otherwise, once a brief slowdown had made it look too slow, it would
+    // never be tried again. Whenever both have been timed, how they compare is relearned.
+    if (!subsample && m_SubsampledSeconds > 0.0 && m_ExactSeconds > m_SubsampledSeconds) {
+        m_SubsampledRatio = m_SubsampledSeconds / m_ExactSeconds;
+    }
+    else if (subsample && m_ExactSeconds >= 0.0) {
+        double impliedExactSeconds = m_SubsampledSeconds / m_SubsampledRatio;
+        m_ExactSeconds += cTimingWeight * (impliedExactSeconds - m_ExactSeconds);
+    }
+    
+    if (keyframe->reordered_opaque == cReducedDecodeMarker) {
+        frameData.m_Mode = FrameMode::Reduced;
+    }
+    else {
+        frameData.m_Mode = subsample ? FrameMode::Subsampled : FrameMode::Exact;
+    }
+    m_ModeRowCounts[(int)frameData.m_Mode]++;
+    sink->WriteFrame(frameData);
+    
+    double lagSeconds = SecondsBetween(dueTime, std::chrono::steady_clock::now());
+    if (lagSeconds > 0.0) {
+        m_LateRowCount++;
+        m_MaxLagSeconds = std::max(m_MaxLagSeconds, lagSeconds);
+    }
+}
+
+
+void DeadlineScheduler::AddStats(DeadlineStats &stats) const
+{
+    stats.Add(m_ModeRowCounts, m_LateRowCount, m_MaxLagSeconds);
+}
+
+
+// Tells the decoder whether to skip its loop filter on the packets it's given from now on. That's
+// most of the work of decoding a keyframe that can be skipped without reopening the decoder, and
+// leaves the image a little blockier; codecs without a loop filter ignore it.
+void DeadlineScheduler::prvSetReducedDecode(bool reduce)
+{
+    if (reduce == m_ReducingDecode) {
+        return;
+    }
+    m_ReducingDecode = reduce;
+    m_CodecContext->skip_loop_filter = reduce ? AVDISCARD_ALL : (AVDiscard)m_SavedSkipLoopFilter;
+    m_CodecContext->reordered_opaque = reduce ? cReducedDecodeMarker : m_SavedReorderedOpaque;
+}
@@ -0,0 +1,111 @@
+//
+//  DeadlineScheduler.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef DeadlineScheduler_hpp
+#define DeadlineScheduler_hpp
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+
+#include "FrameData.hpp"
+
+// Foreward declarations
+struct AVCodecContext;
+struct AVFrame;
+struct AVStream;
+class FrameProcessor;
+
+// What the deadline schedulers of a run did, summed over its streams, for --stats. Any number of
+// threads can add to it at once.
+class DeadlineStats
+{
+public:
+    DeadlineStats();
+    
+    void Add(const size_t modeRowCounts[3], size_t lateRowCount, double maxLagSeconds);
+    
+    // Prints how many rows were found each way, and how many were late and by how much
+    void Report(FILE *file) const;
+
+private:
+    mutable std::mutex  m_Mutex;
+    size_t              m_ModeRowCounts[3];     // Indexed by FrameMode
+    size_t              m_LateRowCount;
+    double              m_MaxLagSeconds;
+};
+
+// How a DeadlineScheduler picks each keyframe's mode. Auto picks from the timings; the others use
+// that mode for every keyframe, whatever the timings, so each mode's results can be checked.
+enum class DeadlineMode {Auto, Exact, Subsampled, Reduced};
+
+// Runs a frame processor against a deadline for each keyframe, for live input, where a row that's
+// approximate but on time is worth more than an exact one that falls behind. Keyframes are paced
+// by their timestamps: the first is due the budget after it arrives, and each later one is due
+// the budget after its timestamp, counted from the first. Before each keyframe, the scheduler
+// picks the most exact mode it expects to finish in time, from how long each mode has recently
+// taken:
+//
+//   - Exact, if there's time for it
+//   - Subsampled, counting every few rows of pixels, if there's time for that
+//   - Otherwise subsampled, and the decoder is also told to skip its loop filter on the frames
+//     it decodes next, until the analysis catches up. Rows from frames decoded that way are
+//     marked Reduced.
+//
+// While subsampling, the exact analysis's expected time follows the subsampled time, scaled by
+// how the two last compared, so exact analysis is tried again once a slowdown passes. Each row
+// is marked with its mode, and rows finished after their deadline are counted as late.
+class DeadlineScheduler
+{
+public:
+    // The decoder's context must stay open until this is destroyed, which puts its loop filter
+    // back as it was
+    DeadlineScheduler(double budgetSeconds, AVStream *stream, AVCodecContext *codecContext,
+                      DeadlineMode mode = DeadlineMode::Auto);
+    ~DeadlineScheduler();
+    
+    DeadlineScheduler(const DeadlineScheduler&) = delete;
+    DeadlineScheduler& operator=(const DeadlineScheduler&) = delete;
+    
+    // Finds the keyframe's medians with the processor, as exactly as its deadline allows, and
+    // writes them to the sink
+    void ProcessKeyFrame(FrameProcessor &frameProcessor, const AVFrame *keyframe, FrameDataSink *sink);
+    
+    // Adds what the scheduler did to the run's totals
+    void AddStats(DeadlineStats &stats) const;
+
+private:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+    
+    double          m_BudgetSeconds;
+    DeadlineMode    m_Mode;
+    AVStream*       m_Stream;
+    AVCodecContext* m_CodecContext;
+    int             m_SavedSkipLoopFilter;
+    int64_t         m_SavedReorderedOpaque;
+    bool            m_ReducingDecode;
+    
+    bool            m_Started;
+    TimePoint       m_FirstArrivalTime;
+    double          m_FirstFrameSeconds;
+    
+    // Recent seconds per keyframe for each analysis, or negative before it's been timed
+    double          m_ExactSeconds;
+    double          m_SubsampledSeconds;
+    double          m_SubsampledRatio;      // Subsampled seconds over exact seconds
+    
+    size_t          m_ModeRowCounts[3];
+    size_t          m_LateRowCount;
+    double          m_MaxLagSeconds;
+    
+    void prvSetReducedDecode(bool reduce);
+};
+
+#endif /* DeadlineScheduler_hpp */
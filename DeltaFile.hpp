@@ -0,0 +1,114 @@
+//
+//  DeltaFile.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef DeltaFile_hpp
+#define DeltaFile_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+// A delta file holds a movie's results compactly, for archiving and for sending over slow links.
+// Most cells' medians don't change from one keyframe to the next, so most keyframes are stored
+// as the changes from the keyframe before. It's written front to back, so it can go to a pipe.
+//
+//   DeltaFileHeader
+//   One record per keyframe, each starting with a kind byte and the keyframe's timestamp, in
+//   seconds, as a double:
+//     cDeltaRecordFull:    The cell medians, one byte per cell
+//     cDeltaRecordDelta:   A varint byte count, then that many bytes of changes from the previous
+//                          keyframe's medians: pairs of a varint count of unchanged cells and a
+//                          zigzag varint difference for the next cell, ending with a varint count
+//                          that reaches the last cell
+//   cDeltaRecordEnd
+//   The index: for each full record, its keyframe number (uint64_t), file offset (uint64_t),
+//   and timestamp (double)
+//   DeltaFileTrailer
+//
+// The first keyframe, and every m_FullRowInterval-th one after it, is a full record, as is any
+// keyframe whose changes would take more room than its medians. A reader can start decoding at
+// any full record. Numbers are little-endian. A file that ends before its trailer was cut short;
+// its records can still be decoded up to that point.
+
+const char      cDeltaFileMagic[8] = {'M', 'E', 'D', 'D', 'E', 'L', 'T', 'A'};
+const char      cDeltaFileIndexMagic[4] = {'D', 'I', 'D', 'X'};
+const uint32_t  cDeltaFileVersion = 1;
+
+const uint8_t   cDeltaRecordFull = 0;
+const uint8_t   cDeltaRecordDelta = 1;
+const uint8_t   cDeltaRecordEnd = 0xFF;
+
+struct DeltaFileHeader
+{
+    char        m_Magic[8];
+    uint32_t    m_Version;
+    uint32_t    m_HeaderSize;           // sizeof(DeltaFileHeader) when written
+    uint32_t    m_GridRows;
+    uint32_t    m_GridCols;
+    uint32_t    m_FullRowInterval;
+    uint32_t    m_Reserved;
+};
+
+struct DeltaFileIndexEntry
+{
+    uint64_t    m_FrameNumber;
+    uint64_t    m_Offset;               // Of the record's kind byte
+    double      m_Timestamp;
+};
+
+struct DeltaFileTrailer
+{
+    uint64_t    m_IndexOffset;
+    uint32_t    m_IndexEntryCount;
+    char        m_Magic[4];
+};
+
+static_assert(sizeof(DeltaFileHeader) == 32, "The delta file header's layout has changed");
+static_assert(sizeof(DeltaFileIndexEntry) == 24, "The delta file index's layout has changed");
+static_assert(sizeof(DeltaFileTrailer) == 16, "The delta file trailer's layout has changed");
+
+// A varint holds 7 bits per byte, low bits first, with the top bit set on all but the last byte.
+// Zigzag encoding interleaves signed values (0, -1, 1, -2, ...) so small differences of either
+// sign take one byte.
+
+inline uint32_t DeltaZigzagEncode(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+inline int32_t DeltaZigzagDecode(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Appends a varint, returning the position after it. Needs room for 5 bytes.
+inline uint8_t *DeltaPutVarint(uint8_t *p, uint32_t value)
+{
+    while (value >= 0x80) {
+        *p++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+// Reads a varint from [p, end), returning the position after it, or nullptr if it runs past
+// end or is too long for 32 bits
+inline const uint8_t *DeltaGetVarint(const uint8_t *p, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+#endif /* DeltaFile_hpp */
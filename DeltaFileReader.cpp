@@ -0,0 +1,223 @@
+//
+//  DeltaFileReader.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "DeltaFileReader.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <sys/stat.h>
+
+// The file is read through a buffer this big
+static const size_t cReadBufferSize = 1024 * 1024;
+
+
+DeltaFileReader::DeltaFileReader() :
+m_File(nullptr),
+m_CellCount(0),
+m_FileSize(0),
+m_IsComplete(false)
+{
+    memset(&m_Header, 0, sizeof(m_Header));
+}
+
+DeltaFileReader::~DeltaFileReader()
+{
+    if (m_File) {
+        fclose(m_File);
+    }
+}
+
+
+bool DeltaFileReader::IsDeltaFile(const std::string &filepath)
+{
+    char magic[sizeof(cDeltaFileMagic)];
+    FILE *file = fopen(filepath.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    bool result = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, cDeltaFileMagic, sizeof(magic)) == 0;
+    fclose(file);
+    return result;
+}
+
+
+bool DeltaFileReader::Open(const std::string &filepath)
+{
+    assert(m_File == nullptr);
+    m_Filepath = filepath;
+    m_File = fopen(filepath.c_str(), "rb");
+    if (m_File == NULL) {
+        return prvFail("can't be opened");
+    }
+    setvbuf(m_File, NULL, _IOFBF, cReadBufferSize);
+    
+    // Check the header
+    if (fread(&m_Header, sizeof(m_Header), 1, m_File) != 1
+        || memcmp(m_Header.m_Magic, cDeltaFileMagic, sizeof(m_Header.m_Magic)) != 0) {
+        return prvFail("isn't a delta file");
+    }
+    if (m_Header.m_Version != cDeltaFileVersion || m_Header.m_HeaderSize != sizeof(DeltaFileHeader)) {
+        return prvFail("is a delta file version this program can't read");
+    }
+    if (m_Header.m_GridRows == 0 || m_Header.m_GridCols == 0 || m_Header.m_FullRowInterval == 0) {
+        return prvFail("has a damaged header");
+    }
+    m_CellCount = (size_t)m_Header.m_GridRows * (size_t)m_Header.m_GridCols;
+    
+    struct stat statbuf;
+    if (fstat(fileno(m_File), &statbuf) != 0) {
+        return prvFail("can't be read");
+    }
+    m_FileSize = (uint64_t)statbuf.st_size;
+    
+    m_IsComplete = prvReadIndex();
+    return true;
+}
+
+
+bool DeltaFileReader::Decode(FrameDataSink &sink, double fromTime, double toTime)
+{
+    assert(m_File != nullptr);
+    
+    // Start at the last full row at or before the first keyframe wanted, or at the first record
+    uint64_t startOffset = sizeof(DeltaFileHeader);
+    std::vector<DeltaFileIndexEntry>::const_iterator after =
+        std::upper_bound(m_Index.begin(), m_Index.end(), fromTime,
+                         [](double timestamp, const DeltaFileIndexEntry &entry) { return timestamp < entry.m_Timestamp; });
+    if (after != m_Index.begin()) {
+        startOffset = (after - 1)->m_Offset;
+    }
+    if (fseeko(m_File, (off_t)startOffset, SEEK_SET) != 0) {
+        return prvFail("can't be read");
+    }
+    
+    FrameData frameData;
+    bool haveRow = false;
+    while (true) {
+        int kind = getc(m_File);
+        if (kind == cDeltaRecordEnd) {
+            return true;
+        }
+        if (kind == EOF || fread(&frameData.m_Timestamp, sizeof(double), 1, m_File) != 1) {
+            return prvFail("was cut short");
+        }
+        
+        if (kind == cDeltaRecordFull) {
+            if (m_CellCount > m_FileSize) {       // The header's grid is wrong
+                return prvFail("is damaged");
+            }
+            m_Changes.resize(m_CellCount);
+            if (fread(m_Changes.data(), 1, m_CellCount, m_File) != m_CellCount) {
+                return prvFail("was cut short");
+            }
+            frameData.m_CellGrayMedians.assign(m_Changes.begin(), m_Changes.end());
+            haveRow = true;
+        }
+        else if (kind == cDeltaRecordDelta && haveRow) {
+            // Read the size of the changes a byte at a time, then the changes
+            uint8_t sizeBytes[5];
+            size_t sizeLength = 0;
+            int byte = 0;
+            do {
+                byte = getc(m_File);
+                if (byte == EOF) {
+                    return prvFail("was cut short");
+                }
+                sizeBytes[sizeLength++] = (uint8_t)byte;
+            } while ((byte & 0x80) != 0 && sizeLength < sizeof(sizeBytes));
+            uint32_t changesSize = 0;
+            if (DeltaGetVarint(sizeBytes, sizeBytes + sizeLength, changesSize) == nullptr) {
+                return prvFail("is damaged");
+            }
+            if (!prvApplyChanges(changesSize, frameData.m_CellGrayMedians)) {
+                return false;
+            }
+        }
+        else {
+            return prvFail("is damaged");
+        }
+        
+        if (frameData.m_Timestamp > toTime) {
+            return true;
+        }
+        if (frameData.m_Timestamp >= fromTime) {
+            sink.WriteFrame(frameData);
+        }
+    }
+}
+
+
+// Reads the trailer and the index of full rows, if the file has them
+bool DeltaFileReader::prvReadIndex()
+{
+    DeltaFileTrailer trailer;
+    if (fseeko(m_File, -(off_t)sizeof(trailer), SEEK_END) != 0
+        || fread(&trailer, sizeof(trailer), 1, m_File) != 1
+        || memcmp(trailer.m_Magic, cDeltaFileIndexMagic, sizeof(trailer.m_Magic)) != 0) {
+        return false;
+    }
+    
+    // The index must fill the space between its offset and the trailer
+    off_t trailerOffset = ftello(m_File) - (off_t)sizeof(trailer);
+    uint64_t indexSize = (uint64_t)trailer.m_IndexEntryCount * sizeof(DeltaFileIndexEntry);
+    if (trailer.m_IndexOffset < sizeof(DeltaFileHeader) || trailer.m_IndexOffset + indexSize != (uint64_t)trailerOffset) {
+        return false;
+    }
+    m_Index.resize(trailer.m_IndexEntryCount);
+    if (fseeko(m_File, (off_t)trailer.m_IndexOffset, SEEK_SET) != 0
+        || (!m_Index.empty() && fread(m_Index.data(), sizeof(DeltaFileIndexEntry), m_Index.size(), m_File) != m_Index.size())) {
+        m_Index.clear();
+        return false;
+    }
+    return true;
+}
+
+// Reads a delta record's changes, and applies them to the previous keyframe's medians
+bool DeltaFileReader::prvApplyChanges(size_t changesSize, std::vector<int> &medians)
+{
+    m_Changes.resize(changesSize);
+    if (fread(m_Changes.data(), 1, changesSize, m_File) != changesSize) {
+        return prvFail("was cut short");
+    }
+    
+    const uint8_t *p = m_Changes.data();
+    const uint8_t *end = p + changesSize;
+    size_t cell = 0;
+    while (true) {
+        uint32_t unchangedCount = 0;
+        p = DeltaGetVarint(p, end, unchangedCount);
+        if (p == nullptr || unchangedCount > m_CellCount - cell) {
+            return prvFail("is damaged");
+        }
+        cell += unchangedCount;
+        if (cell == m_CellCount) {
+            break;
+        }
+        
+        uint32_t difference = 0;
+        p = DeltaGetVarint(p, end, difference);
+        if (p == nullptr) {
+            return prvFail("is damaged");
+        }
+        int64_t median = (int64_t)medians[cell] + DeltaZigzagDecode(difference);
+        if (median < 0 || median > 255) {
+            return prvFail("is damaged");
+        }
+        medians[cell++] = (int)median;
+    }
+    return (p == end) || prvFail("is damaged");
+}
+
+
+// Reports why the file can't be read
+bool DeltaFileReader::prvFail(const char *reason) const
+{
+    fprintf(stderr, "\"%s\" %s\n", m_Filepath.c_str(), reason);
+    return false;
+}
@@ -0,0 +1,63 @@
+//
+//  DeltaFileReader.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef DeltaFileReader_hpp
+#define DeltaFileReader_hpp
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "DeltaFile.hpp"
+#include "FrameData.hpp"
+
+// Reads a delta file (see DeltaFile.hpp), and turns it back into exactly the results that were
+// written to it
+class DeltaFileReader
+{
+public:
+    DeltaFileReader();
+    ~DeltaFileReader();
+    
+    // Returns true if a file starts like a delta file
+    static bool IsDeltaFile(const std::string &filepath);
+    
+    // Opens the file, and reads its header and, if it was finished, its index. On failure,
+    // reports why to stderr and returns false.
+    bool Open(const std::string &filepath);
+    
+    const DeltaFileHeader&  Header() const          { return m_Header; }
+    size_t                  CellCount() const       { return m_CellCount; }
+    
+    // False if the file was cut short before its index was written
+    bool                    IsComplete() const      { return m_IsComplete; }
+    
+    // Passes the keyframes from one time to another, inclusive, to the sink in order. If the
+    // file is complete, decoding starts at the last full row at or before fromTime. If the
+    // records are damaged or cut short, reports why to stderr and returns false; the keyframes
+    // before that have been passed on.
+    bool Decode(FrameDataSink &sink, double fromTime = -INFINITY, double toTime = INFINITY);
+
+private:
+    std::string             m_Filepath;
+    FILE*                   m_File;
+    DeltaFileHeader         m_Header;
+    size_t                  m_CellCount;
+    uint64_t                m_FileSize;
+    bool                    m_IsComplete;
+    std::vector<DeltaFileIndexEntry> m_Index;
+    std::vector<uint8_t>    m_Changes;              // Scratch space for a delta record's changes
+    
+    bool prvReadIndex();
+    bool prvApplyChanges(size_t changesSize, std::vector<int> &medians);
+    bool prvFail(const char *reason) const;
+};
+
+#endif /* DeltaFileReader_hpp */
@@ -0,0 +1,130 @@
+//
+//  DeltaFileWriter.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "DeltaFileWriter.hpp"
+
+#include <cassert>
+#include <cstring>
+
+// A changed cell takes at most a 1-byte count of unchanged cells and a 2-byte difference, and
+// the final count of unchanged cells takes at most 5 bytes
+static size_t prvMaxChangesSize(size_t cellCount)
+{
+    return cellCount * 3 + 5;
+}
+
+
+DeltaFileWriter::DeltaFileWriter(FILE *file, int gridRows, int gridCols, int fullRowInterval) :
+m_File(file),
+m_CellCount((size_t)gridRows * (size_t)gridCols),
+m_FullRowInterval(fullRowInterval),
+m_FrameCount(0),
+m_Offset(0),
+m_PreviousRow(m_CellCount),
+m_Row(m_CellCount),
+m_Changes(prvMaxChangesSize(m_CellCount)),
+m_WriteFailed(false)
+{
+    assert(m_File != nullptr);
+    assert(m_FullRowInterval >= 1);
+    
+    DeltaFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.m_Magic, cDeltaFileMagic, sizeof(header.m_Magic));
+    header.m_Version = cDeltaFileVersion;
+    header.m_HeaderSize = sizeof(DeltaFileHeader);
+    header.m_GridRows = gridRows;
+    header.m_GridCols = gridCols;
+    header.m_FullRowInterval = fullRowInterval;
+    prvWrite(&header, sizeof(header));
+}
+
+
+void DeltaFileWriter::WriteFrame(const FrameData &frameData)
+{
+    assert(frameData.m_CellGrayMedians.size() == m_CellCount);
+    for (size_t i = 0; i < m_CellCount; i++) {
+        assert(frameData.m_CellGrayMedians[i] >= 0 && frameData.m_CellGrayMedians[i] <= 255);
+        m_Row[i] = (uint8_t)frameData.m_CellGrayMedians[i];
+    }
+    
+    // Write the changes unless it's time for a full row, or the changes would take more room
+    // than one
+    bool writeFullRow = (m_FrameCount % m_FullRowInterval) == 0;
+    size_t changesSize = 0;
+    if (!writeFullRow) {
+        changesSize = prvEncodeChanges();
+        writeFullRow = changesSize >= m_CellCount;
+    }
+    
+    uint64_t recordOffset = m_Offset;
+    if (writeFullRow) {
+        prvWrite(&cDeltaRecordFull, 1);
+        prvWrite(&frameData.m_Timestamp, sizeof(double));
+        prvWrite(m_Row.data(), m_CellCount);
+        m_Index.push_back({ m_FrameCount, recordOffset, frameData.m_Timestamp });
+    }
+    else {
+        uint8_t sizeBytes[5];
+        size_t sizeLength = DeltaPutVarint(sizeBytes, (uint32_t)changesSize) - sizeBytes;
+        prvWrite(&cDeltaRecordDelta, 1);
+        prvWrite(&frameData.m_Timestamp, sizeof(double));
+        prvWrite(sizeBytes, sizeLength);
+        prvWrite(m_Changes.data(), changesSize);
+    }
+    
+    m_PreviousRow.swap(m_Row);
+    m_FrameCount++;
+}
+
+
+bool DeltaFileWriter::Finish()
+{
+    prvWrite(&cDeltaRecordEnd, 1);
+    
+    DeltaFileTrailer trailer;
+    trailer.m_IndexOffset = m_Offset;
+    trailer.m_IndexEntryCount = (uint32_t)m_Index.size();
+    memcpy(trailer.m_Magic, cDeltaFileIndexMagic, sizeof(trailer.m_Magic));
+    if (!m_Index.empty()) {
+        prvWrite(m_Index.data(), m_Index.size() * sizeof(DeltaFileIndexEntry));
+    }
+    prvWrite(&trailer, sizeof(trailer));
+    
+    m_WriteFailed = m_WriteFailed || (fflush(m_File) != 0);
+    return !m_WriteFailed;
+}
+
+
+void DeltaFileWriter::prvWrite(const void *data, size_t size)
+{
+    m_WriteFailed = m_WriteFailed || (fwrite(data, 1, size, m_File) != size);
+    m_Offset += size;
+}
+
+// Encodes how m_Row differs from m_PreviousRow into m_Changes, and returns the encoding's size
+size_t DeltaFileWriter::prvEncodeChanges()
+{
+    uint8_t *changes = m_Changes.data();
+    uint8_t *p = changes;
+    uint32_t unchangedCount = 0;
+    for (size_t i = 0; i < m_CellCount; i++) {
+        int32_t difference = (int32_t)m_Row[i] - (int32_t)m_PreviousRow[i];
+        if (difference == 0) {
+            unchangedCount++;
+        }
+        else {
+            p = DeltaPutVarint(p, unchangedCount);
+            p = DeltaPutVarint(p, DeltaZigzagEncode(difference));
+            unchangedCount = 0;
+        }
+    }
+    p = DeltaPutVarint(p, unchangedCount);
+    assert((size_t)(p - changes) <= m_Changes.size());
+    return p - changes;
+}
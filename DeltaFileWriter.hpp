@@ -0,0 +1,49 @@
+//
+//  DeltaFileWriter.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef DeltaFileWriter_hpp
+#define DeltaFileWriter_hpp
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "DeltaFile.hpp"
+#include "FrameData.hpp"
+
+// Writes results as a delta file (see DeltaFile.hpp): each keyframe's medians as the changes
+// from the keyframe before, with a full row every so often
+class DeltaFileWriter : public FrameDataSink
+{
+public:
+    // Writes to a file that's already open, which can be a pipe; the caller closes it after this
+    // is destroyed. Every fullRowInterval-th keyframe is written in full.
+    DeltaFileWriter(FILE *file, int gridRows, int gridCols, int fullRowInterval);
+    
+    void WriteFrame(const FrameData &frameData) override;
+    
+    // Ends the records, and writes the index of full rows. Returns false if any write failed.
+    bool Finish() override;
+
+private:
+    FILE*                   m_File;
+    size_t                  m_CellCount;
+    int                     m_FullRowInterval;
+    uint64_t                m_FrameCount;
+    uint64_t                m_Offset;           // Bytes written so far; the file may not be seekable
+    std::vector<uint8_t>    m_PreviousRow;
+    std::vector<uint8_t>    m_Row;
+    std::vector<uint8_t>    m_Changes;          // Scratch space for a delta record's changes
+    std::vector<DeltaFileIndexEntry> m_Index;
+    bool                    m_WriteFailed;
+    
+    void prvWrite(const void *data, size_t size);
+    size_t prvEncodeChanges();
+};
+
+#endif /* DeltaFileWriter_hpp */
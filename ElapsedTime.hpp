@@ -0,0 +1,28 @@
+//
+//  ElapsedTime.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef ElapsedTime_hpp
+#define ElapsedTime_hpp
+
+#include <chrono>
+
+// Seconds from startTime to endTime
+inline double SecondsBetween(std::chrono::steady_clock::time_point startTime,
+                             std::chrono::steady_clock::time_point endTime)
+{
+    std::chrono::duration<double> elapsed = endTime - startTime;
+    return elapsed.count();
+}
+
+// Seconds from startTime to now
+inline double SecondsSince(std::chrono::steady_clock::time_point startTime)
+{
+    return SecondsBetween(startTime, std::chrono::steady_clock::now());
+}
+
+#endif /* ElapsedTime_hpp */
@@ -0,0 +1,41 @@
+//
+//  FrameAnalyzer.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef FrameAnalyzer_hpp
+#define FrameAnalyzer_hpp
+
+// Foreward declarations
+struct AVFrame;
+struct AVStream;
+struct AVCodecContext;
+
+// Something done with each keyframe of a video stream. The decode loop in MovieAnalysis.cpp hands
+// every keyframe to each of its analyzers in turn, so several analyses share one demux and
+// decode. MedianGridAnalyzer is the median grid analysis; others can be added in
+// prvMakeAnalyzers().
+class FrameAnalyzer
+{
+public:
+    virtual ~FrameAnalyzer() {}
+    
+    // Called before the first keyframe, with the stream and its decoder's context, which stay
+    // valid until after EndStream(). On failure, reports why to stderr and returns false.
+    virtual bool BeginStream(AVStream *stream, AVCodecContext *codecContext) = 0;
+    
+    // Called for each keyframe, in presentation order. The frame belongs to the decoder, which
+    // reuses it once this returns; an analyzer that keeps it longer takes its own reference to
+    // its buffers with av_frame_ref(), rather than copying the image.
+    virtual void ProcessKeyFrame(const AVFrame *keyframe) = 0;
+    
+    // Called after the last keyframe. Returns false if the analysis failed. If decoding has to
+    // start over before the first keyframe arrives, the analyzer is destroyed without this
+    // being called.
+    virtual bool EndStream() = 0;
+};
+
+#endif /* FrameAnalyzer_hpp */
@@ -0,0 +1,49 @@
+//
+//  FrameData.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef FrameData_hpp
+#define FrameData_hpp
+
+#include <vector>
+
+// The number of cells down and across a grid
+struct GridSize
+{
+    int     m_Rows;
+    int     m_Cols;
+};
+
+// How a keyframe's medians were found. Only a deadline (see DeadlineScheduler.hpp) makes them
+// anything but exact.
+enum class FrameMode {
+    Exact,          // Every pixel of the fully decoded frame
+    Subsampled,     // Every few rows of pixels of the fully decoded frame
+    Reduced         // Every few rows of pixels of a frame decoded without its loop filter
+};
+
+// The medians found for one keyframe
+struct FrameData
+{
+    double  m_Timestamp;                    // Seconds from the start of the stream
+    std::vector<int> m_CellGrayMedians;     // Row by row, left to right; grid after grid, if there are several
+    FrameMode m_Mode = FrameMode::Exact;
+};
+
+// Receives each keyframe's results as soon as they're known, in time order
+class FrameDataSink
+{
+public:
+    virtual ~FrameDataSink() {}
+    
+    virtual void WriteFrame(const FrameData &frameData) = 0;
+    
+    // Called after the last frame. Returns false if any results couldn't be written.
+    virtual bool Finish() { return true; }
+};
+
+#endif /* FrameData_hpp */
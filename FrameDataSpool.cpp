@@ -0,0 +1,87 @@
+//
+//  FrameDataSpool.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "FrameDataSpool.hpp"
+
+#include <cassert>
+
+// Each frame is spooled as its timestamp, its cell count, and one byte per median
+
+
+FrameDataSpool::FrameDataSpool() :
+m_File(nullptr),
+m_WriteFailed(false)
+{
+}
+
+FrameDataSpool::~FrameDataSpool()
+{
+    if (m_File) {
+        fclose(m_File);
+    }
+}
+
+
+bool FrameDataSpool::Open()
+{
+    assert(m_File == nullptr);
+    m_File = tmpfile();
+    if (m_File == NULL) {
+        fprintf(stderr, "Can't create a temporary file\n");
+        return false;
+    }
+    return true;
+}
+
+
+void FrameDataSpool::WriteFrame(const FrameData &frameData)
+{
+    assert(m_File != nullptr);
+    uint32_t cellCount = (uint32_t)frameData.m_CellGrayMedians.size();
+    m_Cells.resize(cellCount);
+    for (uint32_t i = 0; i < cellCount; i++) {
+        assert(frameData.m_CellGrayMedians[i] >= 0 && frameData.m_CellGrayMedians[i] <= 255);
+        m_Cells[i] = (uint8_t)frameData.m_CellGrayMedians[i];
+    }
+    
+    bool wrote = (fwrite(&frameData.m_Timestamp, sizeof(frameData.m_Timestamp), 1, m_File) == 1 &&
+                  fwrite(&cellCount, sizeof(cellCount), 1, m_File) == 1 &&
+                  fwrite(m_Cells.data(), 1, cellCount, m_File) == cellCount);
+    m_WriteFailed = m_WriteFailed || !wrote;
+}
+
+
+bool FrameDataSpool::Finish()
+{
+    m_WriteFailed = m_WriteFailed || (fflush(m_File) != 0);
+    return !m_WriteFailed;
+}
+
+
+bool FrameDataSpool::Replay(FrameDataSink &sink)
+{
+    if (!Finish()) {
+        return false;
+    }
+    
+    rewind(m_File);
+    FrameData frameData;
+    uint32_t cellCount = 0;
+    while (fread(&frameData.m_Timestamp, sizeof(frameData.m_Timestamp), 1, m_File) == 1) {
+        if (fread(&cellCount, sizeof(cellCount), 1, m_File) != 1) {
+            return false;
+        }
+        m_Cells.resize(cellCount);
+        if (fread(m_Cells.data(), 1, cellCount, m_File) != cellCount) {
+            return false;
+        }
+        frameData.m_CellGrayMedians.assign(m_Cells.begin(), m_Cells.end());
+        sink.WriteFrame(frameData);
+    }
+    return !ferror(m_File);
+}
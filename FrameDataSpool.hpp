@@ -0,0 +1,42 @@
+//
+//  FrameDataSpool.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef FrameDataSpool_hpp
+#define FrameDataSpool_hpp
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "FrameData.hpp"
+
+// Holds results in a temporary file until they can be passed on, so results that are ready
+// before their turn, such as a later segment's, don't build up in memory
+class FrameDataSpool : public FrameDataSink
+{
+public:
+    FrameDataSpool();
+    ~FrameDataSpool();
+    
+    // Creates the temporary file. On failure, reports why to stderr and returns false.
+    bool Open();
+    
+    void WriteFrame(const FrameData &frameData) override;
+    bool Finish() override;
+    
+    // Passes everything written so far to the sink, in order. Returns false if the spooled
+    // results couldn't be read back.
+    bool Replay(FrameDataSink &sink);
+
+private:
+    FILE*   m_File;
+    bool    m_WriteFailed;
+    std::vector<uint8_t> m_Cells;       // Scratch space for one frame's medians
+};
+
+#endif /* FrameDataSpool_hpp */
@@ -7,9 +7,12 @@
 //
 
 #include "FrameProcessor.hpp"
+#include "FusedLuma.hpp"
+#include "GridHistogram.hpp"
+#include "ThreadPool.hpp"
 
-#include <sstream>
 #include <algorithm>
+#include <cmath>
 
 #if defined(__cplusplus)
 extern "C" {
@@ -20,6 +23,7 @@ extern "C" {
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 #include "libswscale/swscale.h"
     
 #if defined(__cplusplus)
@@ -27,15 +31,169 @@ extern "C" {
 #endif
 
 
-FrameProcessor::FrameProcessor(AVStream *stream, AVCodecContext* codecContext, int gridRows, int gridCols) :
+// The median is the value at the middle rank, or the mean of the values at the two middle ranks
+// if the count is even. Both engines use these ranks, so they produce identical results.
+static inline size_t prvLowMedianRank(size_t valueCount)
+{
+    return (valueCount - 1) / 2;
+}
+
+static inline size_t prvHighMedianRank(size_t valueCount)
+{
+    return valueCount / 2;
+}
+
+// When subsampling, every this many rows of pixels are counted, starting with the top row. Rows
+// are taken rather than columns so the row kernels can still count whole rows.
+static const int cSubsampleRowStep = 4;
+
+// The number of rows in [firstRow, endRow) that are counted when every rowStep-th row is
+static inline size_t prvSampledRowCount(int firstRow, int endRow, int rowStep)
+{
+    return (size_t)((endRow + rowStep - 1) / rowStep - (firstRow + rowStep - 1) / rowStep);
+}
+
+// Returns the value at the given rank in a 256-bin histogram
+static inline int prvValueAtRank(const uint32_t *histogram, size_t rank)
+{
+    size_t cumulativeCount = 0;
+    for (int value = 0; value < cHistogramBinCount; value++) {
+        cumulativeCount += histogram[value];
+        if (cumulativeCount > rank) {
+            return value;
+        }
+    }
+    assert(false);      // The rank is larger than the histogram's count
+    return 255;
+}
+
+
+// Returns whether the frame's first plane holds 8-bit luma values that can be used directly as
+// grayscale, as in yuv420p, yuvj420p, nv12, yuv422p, and gray8. If so, also returns whether they
+// are full range (0-255) rather than limited range (16-235).
+static bool prvFrameHasLumaPlane(const AVFrame *frame, bool &isFullRange)
+{
+    AVPixelFormat pixelFormat = (AVPixelFormat)frame->format;
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get(pixelFormat);
+    if (descriptor == nullptr) {
+        return false;
+    }
+    
+    // Paletted, RGB, hardware, and bitstream formats have no luma plane
+    const uint64_t cNoLumaPlaneFlags = AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_RGB |
+                                       AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM;
+    if (descriptor->flags & cNoLumaPlaneFlags) {
+        return false;
+    }
+    
+    // Luma must be packed one byte per pixel, by itself, in the first plane
+    const AVComponentDescriptor &luma = descriptor->comp[0];
+    if (luma.plane != 0 || luma.step != 1 || luma.offset != 0 || luma.shift != 0 || luma.depth != 8) {
+        return false;
+    }
+    
+    // swscale treats gray and the "J" formats as full range. Other formats are full range only
+    // if the decoder says so.
+    switch (pixelFormat) {
+        case AV_PIX_FMT_GRAY8:
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_YUVJ422P:
+        case AV_PIX_FMT_YUVJ444P:
+        case AV_PIX_FMT_YUVJ440P:
+        case AV_PIX_FMT_YUVJ411P:
+            isFullRange = true;
+            break;
+            
+        default:
+            isFullRange = (frame->color_range == AVCOL_RANGE_JPEG);
+            break;
+    }
+    return true;
+}
+
+// Where the histogram engine gets each image row's gray values
+struct FrameProcessor::GrayRowSource {
+    const uint8_t*          m_Image = nullptr;          // 8-bit gray rows, either in the frame or converted...
+    int                     m_RowBytes = 0;
+    const FusedLumaKernel*  m_FusedKernel = nullptr;    // ...or computed by a kernel from the frame
+    const uint8_t*          m_HistogramTable = nullptr; // If set, a mapping applied to the counts
+};
+
+// Redistributes a histogram's counts through a value mapping table
+static void prvMapHistogram(const uint32_t *histogram, const uint8_t *table, uint32_t *mappedHistogram)
+{
+    std::fill(mappedHistogram, mappedHistogram + cHistogramBinCount, 0);
+    for (int value = 0; value < cHistogramBinCount; value++) {
+        mappedHistogram[table[value]] += histogram[value];
+    }
+}
+
+static int prvGreatestCommonDivisor(int a, int b)
+{
+    while (b != 0) {
+        int remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+    return a;
+}
+
+// Adds one cell's 256 counts into another's. The loop is simple enough for the compiler to
+// vectorize, so summing a histogram costs about as much as counting a few dozen pixels.
+static inline void prvAddHistogram(const uint32_t *histogram, uint32_t *sum)
+{
+    for (int value = 0; value < cHistogramBinCount; value++) {
+        sum[value] += histogram[value];
+    }
+}
+
+// Finds the medians of one row of a grid's cells from their counts, which are histogramStride
+// apart in histograms, and which cover every rowStep-th row of pixels
+static void prvRowMediansFromHistograms(const uint32_t *histograms, size_t histogramStride, int w, int h, int rowStep,
+                                        int gridCols, int imageRowsInGridCell, int imageColsInGridCell,
+                                        int gridRow, const uint8_t *histogramTable, int *medians)
+{
+    uint32_t mappedHistogram[cHistogramBinCount];
+    int firstImageRow = std::min(gridRow * imageRowsInGridCell, h);
+    int endImageRow = std::min(firstImageRow + imageRowsInGridCell, h);
+    size_t cellRowCount = prvSampledRowCount(firstImageRow, endImageRow, rowStep);
+    for (int thisGridCol = 0; thisGridCol < gridCols; thisGridCol++) {
+        int firstImageCol = std::min(thisGridCol * imageColsInGridCell, w);
+        int endImageCol = std::min(firstImageCol + imageColsInGridCell, w);
+        size_t valueCount = cellRowCount * (endImageCol - firstImageCol);
+        const uint32_t *histogram = &histograms[thisGridCol * histogramStride];
+        if (histogramTable != nullptr) {
+            prvMapHistogram(histogram, histogramTable, mappedHistogram);
+            histogram = mappedHistogram;
+        }
+        int median = 0;
+        if (valueCount > 0) {
+            median = (prvValueAtRank(histogram, prvLowMedianRank(valueCount)) +
+                      prvValueAtRank(histogram, prvHighMedianRank(valueCount))) / 2;
+        }
+        medians[thisGridCol] = median;
+    }
+}
+
+FrameProcessor::FrameProcessor(AVStream *stream, AVCodecContext* codecContext, const std::vector<GridSize> &grids,
+                               FrameDataSink *sink, const FrameProcessorOptions &options) :
 m_AVStream(stream),
 m_AVCodecContext(codecContext),
-m_GridRows(gridRows),
-m_GridCols(gridCols),
-m_SwsContext(nullptr)
+m_Grids(grids),
+m_CellCount(0),
+m_Options(options),
+m_Sink(sink),
+m_SwsContext(nullptr),
+m_LayoutWidth(0),
+m_LayoutHeight(0),
+m_SubsampleRowStep(1)
 {
     assert(m_AVStream != nullptr);
     assert(m_AVCodecContext != nullptr);
+    assert(!m_Grids.empty());
+    for (const GridSize &grid : m_Grids) {
+        m_CellCount += (size_t)grid.m_Rows * (size_t)grid.m_Cols;
+    }
 }
 
 FrameProcessor::~FrameProcessor()
@@ -46,9 +204,20 @@ FrameProcessor::~FrameProcessor()
 }
 
 
-void FrameProcessor::ProcessKeyFrame(AVFrame *frame)
+void FrameProcessor::ProcessKeyFrame(const AVFrame *frame)
 {
+    assert(m_Sink != nullptr);
     FrameData frameData;
+    AnalyzeKeyFrame(frame, frameData);
+    
+    // Pass the result for this frame along
+    m_Sink->WriteFrame(frameData);
+}
+
+
+void FrameProcessor::AnalyzeKeyFrame(const AVFrame *frame, FrameData &frameData, bool subsample)
+{
+    frameData.m_CellGrayMedians.clear();
     
     // Determine the frame time
     int64_t presentationTime = frame->pts;
@@ -58,6 +227,177 @@ void FrameProcessor::ProcessKeyFrame(AVFrame *frame)
     frameData.m_Timestamp = frameTimeInSeconds;
     
     
+    // Find the grayscale values. When the frame already has an 8-bit luma plane, the histogram
+    // engine reads it in place; the plane's values may need mapping from limited to full range,
+    // which is done on the histograms rather than on every pixel. Formats without one, such as
+    // RGB and 10-bit YUV, are converted and counted in a single pass where there's a kernel for
+    // them. Everything else, and the sort engine, goes through swscale, which converts the whole
+    // frame up front even when bands are analyzed in parallel, since one context's slices have
+    // to be converted in order. Sampling reads pixels one at a time, which the fused kernels can't
+    // do, so with a sample budget those formats go through swscale too.
+    int w = frame->width;
+    int h = frame->height;
+    GrayRowSource graySource;
+    bool lumaIsFullRange = false;
+    bool canSkipSwscale = (m_Options.m_MedianEngine == MedianEngine::Histogram &&
+                           m_Options.m_GrayConversion == GrayConversion::Auto);
+    if (canSkipSwscale && prvFrameHasLumaPlane(frame, lumaIsFullRange)) {
+        graySource.m_Image = frame->data[0];
+        graySource.m_RowBytes = frame->linesize[0];
+        if (!lumaIsFullRange) {
+            graySource.m_HistogramTable = LimitedToFullRangeTable();
+        }
+    }
+    else if (canSkipSwscale && m_Options.m_SampleBudget == 0 && m_FusedLumaKernel.Prepare(frame)) {
+        graySource.m_FusedKernel = &m_FusedLumaKernel;
+        graySource.m_HistogramTable = m_FusedLumaKernel.HistogramTable();
+    }
+    else {
+        graySource.m_Image = prvConvertToGray(frame);
+        graySource.m_RowBytes = w;
+    }
+
+    
+    // Calculate and store the median values for the grid cells
+    prvPrepareLayouts(w, h);
+    int rowStep = subsample ? m_SubsampleRowStep : 1;
+    frameData.m_CellGrayMedians.assign(m_CellCount, 0);
+    if (m_Options.m_SampleBudget > 0) {
+        // Both engines count the samples the same way; there are too few to be worth bands
+        int sampleBudget = subsample ? std::max(m_Options.m_SampleBudget / cSubsampleRowStep, 1) :
+                                       m_Options.m_SampleBudget;
+        for (const GridLayout &grid : m_Layouts) {
+            prvSampledMedians(graySource, w, h, sampleBudget, grid, &frameData.m_CellGrayMedians[grid.m_FirstMedian]);
+        }
+    }
+    else {
+        switch (m_Options.m_MedianEngine) {
+            case MedianEngine::Sort:
+                assert(graySource.m_Image != nullptr);
+                for (const GridLayout &grid : m_Layouts) {
+                    prvSortMedians(graySource.m_Image, w, h, graySource.m_RowBytes, rowStep,
+                                   grid, &frameData.m_CellGrayMedians[grid.m_FirstMedian]);
+                }
+                break;
+                
+            case MedianEngine::Histogram:
+                for (const GridFamily &family : m_Families) {
+                    prvHistogramMedians(graySource, w, h, rowStep, family, frameData);
+                }
+                break;
+        }
+    }
+    assert(frameData.m_CellGrayMedians.size() == m_CellCount);
+}
+
+
+void FrameProcessor::SampleLattice(int cellRows, int cellCols, int sampleBudget, int &strataRows, int &strataCols)
+{
+    assert(cellRows > 0 && cellCols > 0 && sampleBudget > 0);
+    if ((int64_t)cellRows * (int64_t)cellCols <= sampleBudget) {
+        strataRows = cellRows;
+        strataCols = cellCols;
+        return;
+    }
+    
+    // Make the strata as square as the budget allows. A cell too narrow or too short for that
+    // gets all its columns or rows, and the rest of the budget goes the other way.
+    strataRows = (int)lround(sqrt((double)sampleBudget * cellRows / cellCols));
+    strataRows = std::max(std::min(strataRows, cellRows), 1);
+    strataCols = std::max(std::min(sampleBudget / strataRows, cellCols), 1);
+    strataRows = std::max(std::min(sampleBudget / strataCols, cellRows), 1);
+}
+
+
+double FrameProcessor::RankErrorBound(size_t sampleCount, size_t pixelCount)
+{
+    if (sampleCount == 0 || sampleCount >= pixelCount) {
+        return 0.0;
+    }
+    return sqrt(log(2.0 / (1.0 - cRankErrorConfidence)) / (2.0 * (double)sampleCount));
+}
+
+
+// Works out where each grid's cells fall on frames of this size, and which grids can be summed
+// from finer ones. Grids are taken finest first; each becomes the root of a new family unless its
+// cells are exact blocks of an existing root's cells, in which case it joins the family whose
+// root has the largest cells, so it sums the fewest histograms.
+void FrameProcessor::prvPrepareLayouts(int w, int h)
+{
+    // Summing a cell's histogram costs about as much as counting this many of its pixels, so
+    // smaller cells aren't worth summing from
+    const int cMinRootCellPixelCount = 64;
+    
+    if (w == m_LayoutWidth && h == m_LayoutHeight) {
+        return;
+    }
+    m_LayoutWidth = w;
+    m_LayoutHeight = h;
+    
+    // Determine the dest image's grid cell sizes. These are rounded up so that, for instance,
+    // if dividing a 100x100 image into 3x3 cells, you don't wind up with 33 rows x 33 columns
+    // per cell, and wind up with some pixels not getting counted.
+    m_Layouts.clear();
+    size_t firstMedian = 0;
+    for (const GridSize &grid : m_Grids) {
+        GridLayout layout;
+        layout.m_Rows = grid.m_Rows;
+        layout.m_Cols = grid.m_Cols;
+        layout.m_ImageRowsInCell = ceil((double)h / (double)grid.m_Rows);
+        layout.m_ImageColsInCell = ceil((double)w / (double)grid.m_Cols);
+        layout.m_FirstMedian = firstMedian;
+        m_Layouts.push_back(layout);
+        firstMedian += (size_t)grid.m_Rows * (size_t)grid.m_Cols;
+    }
+    
+    // Subsample no more sparsely than the shortest cell, including the last row of cells, which
+    // can be cut short, so every cell with pixels has some of them counted
+    m_SubsampleRowStep = cSubsampleRowStep;
+    for (const GridLayout &layout : m_Layouts) {
+        int lastCellRowCount = h - ((h - 1) / layout.m_ImageRowsInCell) * layout.m_ImageRowsInCell;
+        m_SubsampleRowStep = std::min({m_SubsampleRowStep, layout.m_ImageRowsInCell, lastCellRowCount});
+    }
+    
+    std::vector<size_t> finestFirst(m_Layouts.size());
+    for (size_t i = 0; i < finestFirst.size(); i++) {
+        finestFirst[i] = i;
+    }
+    auto cellPixelCount = [this](size_t i) {
+        return m_Layouts[i].m_ImageRowsInCell * m_Layouts[i].m_ImageColsInCell;
+    };
+    std::stable_sort(finestFirst.begin(), finestFirst.end(), [&cellPixelCount](size_t a, size_t b) {
+        return cellPixelCount(a) < cellPixelCount(b);
+    });
+    
+    m_Families.clear();
+    for (size_t gridIndex : finestFirst) {
+        const GridLayout &grid = m_Layouts[gridIndex];
+        GridFamily *bestFamily = nullptr;
+        for (GridFamily &family : m_Families) {
+            const GridLayout &root = m_Layouts[family.m_Root];
+            bool canSum = (cellPixelCount(family.m_Root) >= cMinRootCellPixelCount &&
+                           grid.m_ImageRowsInCell % root.m_ImageRowsInCell == 0 &&
+                           grid.m_ImageColsInCell % root.m_ImageColsInCell == 0);
+            if (canSum && (bestFamily == nullptr || cellPixelCount(family.m_Root) > cellPixelCount(bestFamily->m_Root))) {
+                bestFamily = &family;
+            }
+        }
+        if (bestFamily != nullptr) {
+            bestFamily->m_Derived.push_back(gridIndex);
+        }
+        else {
+            GridFamily family;
+            family.m_Root = gridIndex;
+            m_Families.push_back(family);
+        }
+    }
+}
+
+
+// Converts the frame to 8-bit grayscale with swscale, and returns the converted image, which has
+// frame->width bytes per row
+const uint8_t* FrameProcessor::prvConvertToGray(const AVFrame *frame)
+{
     // Get a context for converting the image, recreating one if needed
     int w = frame->width;
     int h = frame->height;
@@ -72,11 +412,12 @@ void FrameProcessor::ProcessKeyFrame(AVFrame *frame)
                                         NULL,               // No dest filter
                                         NULL);              // The nonexistent scaling algorithm doesn't need tuning
     
-    // Allocate an array to hold the grayscale values
+    // Make room to hold the grayscale values
     int destBytesPerPixel = 1;
     int destRowBytes = w * destBytesPerPixel;
     int destImageSize = h * destRowBytes;
-    uint8_t *destImageBuffer = new uint8_t[destImageSize];
+    m_GrayImage.resize(destImageSize);
+    uint8_t *destImageBuffer = m_GrayImage.data();
     
     // Do the conversion
     int outputSliceHeight = ::sws_scale(m_SwsContext,
@@ -84,41 +425,46 @@ void FrameProcessor::ProcessKeyFrame(AVFrame *frame)
                                       0, h,                                                // Convert all source rows, starting at row 0
                                       &destImageBuffer, &destRowBytes);
     assert(outputSliceHeight == h);
-
-    
-    // Determine the dest image's grid cell sizes. These are rounded up so that, for instance,
-    // if dividing a 100x100 image into 3x3 cells, you don't wind up with 33 rows x 33 columns
-    // per cell, and wind up with some pixels not getting counted.
-    int imageRowsInGridCell = ceil((double)h / (double)m_GridRows);
-    int imageColsInGridCell = ceil((double)w / (double)m_GridCols);
     
+    return destImageBuffer;
+}
+
+// Reference implementation: collect every value in each cell, from every rowStep-th row, sort
+// them, and pick the middle
+void FrameProcessor::prvSortMedians(const uint8_t *grayImage, int w, int h, int rowBytes, int rowStep,
+                                    const GridLayout &grid, int *medians)
+{
     // Prepare to collect the values in each of the cells
+    const int gridRows = grid.m_Rows;
+    const int gridCols = grid.m_Cols;
+    const int imageRowsInGridCell = grid.m_ImageRowsInCell;
+    const int imageColsInGridCell = grid.m_ImageColsInCell;
     typedef std::vector<uint8_t> uint8_t_vector;
-    uint8_t_vector accum[m_GridRows][m_GridCols];
+    uint8_t_vector accum[gridRows][gridCols];
     
     // Reserve space in the accumulators to avoid memory thrashing
     int maxGridCellPixelCount = imageRowsInGridCell * imageColsInGridCell;
-    for (size_t thisGridRow = 0; thisGridRow < m_GridRows; thisGridRow++) {
-        for (size_t thisGridCol = 0; thisGridCol < m_GridCols; thisGridCol++) {
+    for (size_t thisGridRow = 0; thisGridRow < gridRows; thisGridRow++) {
+        for (size_t thisGridCol = 0; thisGridCol < gridCols; thisGridCol++) {
             uint8_t_vector &thisAccum = accum[thisGridRow][thisGridCol];
             thisAccum.reserve(maxGridCellPixelCount);
         }
     }
     
-    // Walk destImageBuffer, figure out where each offset is in the grid, and apply the values
+    // Walk the image, figure out where each offset is in the grid, and apply the values
     // to the accumulators
-    uint8_t *thisGrayscaleValuePtr = destImageBuffer;
-    for (size_t thisImageRow = 0; thisImageRow < h; thisImageRow++) {
+    for (size_t thisImageRow = 0; thisImageRow < h; thisImageRow += rowStep) {
         
         // Convert the image row to a grid row
         size_t thisGridRow = thisImageRow / imageRowsInGridCell;
-        assert(thisGridRow < m_GridRows);
+        assert(thisGridRow < gridRows);
         
+        const uint8_t *thisGrayscaleValuePtr = grayImage + thisImageRow * rowBytes;
         for (size_t thisImageCol = 0; thisImageCol < w; thisImageCol++) {
             
             // Convert the image column to a grid column
             size_t thisGridCol = thisImageCol / imageColsInGridCell;
-            assert(thisGridCol < m_GridCols);
+            assert(thisGridCol < gridCols);
                    
             // Accumulate this value
             uint8_t_vector &thisAccum = accum[thisGridRow][thisGridCol];
@@ -130,50 +476,204 @@ void FrameProcessor::ProcessKeyFrame(AVFrame *frame)
     }
     
     // Calculate and store the median values for the grid cells
-    for (size_t thisGridRow = 0; thisGridRow < m_GridRows; thisGridRow++) {
-        for (size_t thisGridCol = 0; thisGridCol < m_GridCols; thisGridCol++) {
+    for (size_t thisGridRow = 0; thisGridRow < gridRows; thisGridRow++) {
+        for (size_t thisGridCol = 0; thisGridCol < gridCols; thisGridCol++) {
             // Sort the accumulated values
             uint8_t_vector &thisAccum = accum[thisGridRow][thisGridCol];
             std::sort(thisAccum.begin(), thisAccum.end());
             
-            // Determine and store the median
+            // Determine and store the median. Rounding the cell size up can leave cells at the
+            // right and bottom edges with no pixels at all; those report 0.
             size_t valueCount = thisAccum.size();
-            size_t halfValueCount = valueCount / 2;
-            uint8_t median;
-            if (valueCount & 0x01) {        // The count is odd
-                // The median is the middle value
-                median = thisAccum[halfValueCount + 1];
-            }
-            else {                          // The count is even
-                // The median is the mean of the two middle values
+            int median = 0;
+            if (valueCount > 0) {
                 // Do some casting to avoid overflow in the addition
-                median = ((int)thisAccum[halfValueCount] + (int)thisAccum[halfValueCount + 1]) / 2;
+                median = ((int)thisAccum[prvLowMedianRank(valueCount)] +
+                          (int)thisAccum[prvHighMedianRank(valueCount)]) / 2;
             }
-            frameData.m_CellGrayMedians.push_back(median);
+            medians[thisGridRow * gridCols + thisGridCol] = median;
         }
     }
-    
-    // Cache the result for this frame, and clean up
-    m_FrameData.push_back(frameData);
-    delete [] destImageBuffer;
 }
 
 
-std::string FrameProcessor::Report() const
+// Approximates each cell's median from the pixels SampleLattice() picks. Each stratum's pixel is
+// placed by hashing the stratum's position, so the same pixels are used in every frame, and the
+// samples don't line up in rows and columns the way a regular lattice's would.
+void FrameProcessor::prvSampledMedians(const GrayRowSource &graySource, int w, int h, int sampleBudget,
+                                       const GridLayout &grid, int *medians) const
 {
-    std::ostringstream accum;
-    
-    for (const FrameData &fr : m_FrameData) {
-        accum << fr.m_Timestamp;
-        
-        for (int med : fr.m_CellGrayMedians) {
-            accum << "," << med;
+    assert(graySource.m_Image != nullptr);
+    uint32_t histogram[cHistogramBinCount];
+    uint32_t mappedHistogram[cHistogramBinCount];
+    for (int thisGridRow = 0; thisGridRow < grid.m_Rows; thisGridRow++) {
+        int firstImageRow = std::min(thisGridRow * grid.m_ImageRowsInCell, h);
+        int cellRows = std::min(firstImageRow + grid.m_ImageRowsInCell, h) - firstImageRow;
+        for (int thisGridCol = 0; thisGridCol < grid.m_Cols; thisGridCol++) {
+            int firstImageCol = std::min(thisGridCol * grid.m_ImageColsInCell, w);
+            int cellCols = std::min(firstImageCol + grid.m_ImageColsInCell, w) - firstImageCol;
+            int &median = medians[thisGridRow * grid.m_Cols + thisGridCol];
+            median = 0;
+            if (cellRows == 0 || cellCols == 0) {
+                continue;
+            }
+            
+            // Count one pixel from each stratum
+            int strataRows = 0;
+            int strataCols = 0;
+            SampleLattice(cellRows, cellCols, sampleBudget, strataRows, strataCols);
+            std::fill(histogram, histogram + cHistogramBinCount, 0);
+            for (int stratumRow = 0; stratumRow < strataRows; stratumRow++) {
+                int firstRow = firstImageRow + (int)((int64_t)stratumRow * cellRows / strataRows);
+                int rowCount = firstImageRow + (int)((int64_t)(stratumRow + 1) * cellRows / strataRows) - firstRow;
+                for (int stratumCol = 0; stratumCol < strataCols; stratumCol++) {
+                    int firstCol = firstImageCol + (int)((int64_t)stratumCol * cellCols / strataCols);
+                    int colCount = firstImageCol + (int)((int64_t)(stratumCol + 1) * cellCols / strataCols) - firstCol;
+                    uint32_t hash = (uint32_t)stratumRow * 0x9E3779B1u ^ (uint32_t)stratumCol * 0x85EBCA77u;
+                    hash ^= hash >> 15;
+                    hash *= 0x2C1B3C6Du;
+                    hash ^= hash >> 12;
+                    int y = firstRow + (int)((hash & 0xFFFF) % (uint32_t)rowCount);
+                    int x = firstCol + (int)((hash >> 16) % (uint32_t)colCount);
+                    histogram[graySource.m_Image[(size_t)y * graySource.m_RowBytes + x]]++;
+                }
+            }
+            
+            // Find the median of the samples
+            const uint32_t *countedHistogram = histogram;
+            if (graySource.m_HistogramTable != nullptr) {
+                prvMapHistogram(histogram, graySource.m_HistogramTable, mappedHistogram);
+                countedHistogram = mappedHistogram;
+            }
+            size_t sampleCount = (size_t)strataRows * (size_t)strataCols;
+            median = (prvValueAtRank(countedHistogram, prvLowMedianRank(sampleCount)) +
+                      prvValueAtRank(countedHistogram, prvHighMedianRank(sampleCount))) / 2;
         }
-        
-        accum << std::endl;
+    }
+}
+
+
+// Count the values in each cell of one grid row at a time, then find each cell's median by
+// walking the cumulative counts. This avoids storing and sorting every pixel. The counting is
+// done by a kernel chosen for this CPU (see GridHistogram.hpp), or by a fused conversion kernel
+// (see FusedLuma.hpp). The family's other grids add up the root grid's counts as each of its rows
+// is done, and find their medians when they have all the root rows their cells cover.
+//
+// Grid rows don't share any pixels, so a large frame is split into bands of whole grid rows,
+// which are analyzed in parallel when there's a thread pool, each with its own histograms. Bands
+// start and end on a row boundary of every grid in the family.
+void FrameProcessor::prvHistogramMedians(const GrayRowSource &graySource, int w, int h, int rowStep,
+                                         const GridFamily &family, FrameData &frameData)
+{
+    // Bands smaller than this aren't worth the cost of handing them to another thread
+    const size_t cMinBandPixelCount = 256 * 1024;
+    
+    const GridLayout &root = m_Layouts[family.m_Root];
+    int unitRowCount = 1;           // Root rows per band unit
+    for (size_t gridIndex : family.m_Derived) {
+        int rowRatio = m_Layouts[gridIndex].m_ImageRowsInCell / root.m_ImageRowsInCell;
+        unitRowCount = std::min(unitRowCount / prvGreatestCommonDivisor(unitRowCount, rowRatio) * rowRatio, root.m_Rows);
+    }
+    int unitCount = (root.m_Rows + unitRowCount - 1) / unitRowCount;
+    
+    int bandCount = 1;
+    ThreadPool *threadPool = m_Options.m_BandThreadPool;
+    if (threadPool != nullptr) {
+        size_t bandsForFrameSize = std::max<size_t>((size_t)w * (size_t)h / cMinBandPixelCount, 1);
+        bandCount = (int)std::min<size_t>(bandsForFrameSize, std::min(unitCount, threadPool->ThreadCount()));
+    }
+    
+    int laneCount = HistogramLaneCount(root.m_ImageRowsInCell * root.m_ImageColsInCell);
+    size_t cellHistogramsSize = laneCount * cHistogramBinCount;
+    size_t rowHistogramsSize = (size_t)root.m_Cols * cellHistogramsSize;
+    size_t bandHistogramsSize = rowHistogramsSize;
+    for (size_t gridIndex : family.m_Derived) {
+        bandHistogramsSize += (size_t)m_Layouts[gridIndex].m_Cols * cHistogramBinCount;
+    }
+    if (m_BandHistograms.size() < (size_t)bandCount) {
+        m_BandHistograms.resize(bandCount);
+    }
+    for (int band = 0; band < bandCount; band++) {
+        m_BandHistograms[band].resize(bandHistogramsSize);
     }
     
-    std::string result = accum.str();
-    return result;
+    int *medians = frameData.m_CellGrayMedians.data();
+    auto analyzeBand = [&](size_t band) {
+        int firstGridRow = (int)(band * unitCount / bandCount) * unitRowCount;
+        int endGridRow = std::min((int)((band + 1) * unitCount / bandCount) * unitRowCount, root.m_Rows);
+        uint32_t *rowHistograms = m_BandHistograms[band].data();
+        uint32_t *derivedHistograms = rowHistograms + rowHistogramsSize;
+        std::fill(derivedHistograms, rowHistograms + bandHistogramsSize, 0);
+        for (int thisGridRow = firstGridRow; thisGridRow < endGridRow; thisGridRow++) {
+            prvHistogramGridRow(graySource, w, h, rowStep, root, thisGridRow, rowHistograms,
+                                &medians[root.m_FirstMedian + thisGridRow * root.m_Cols]);
+            
+            // Add this row's counts to the other grids' cells that cover it
+            uint32_t *gridHistograms = derivedHistograms;
+            for (size_t gridIndex : family.m_Derived) {
+                const GridLayout &grid = m_Layouts[gridIndex];
+                int rowRatio = grid.m_ImageRowsInCell / root.m_ImageRowsInCell;
+                int colRatio = grid.m_ImageColsInCell / root.m_ImageColsInCell;
+                int gridRow = thisGridRow / rowRatio;
+                if (gridRow < grid.m_Rows) {
+                    int rootColCount = std::min(root.m_Cols, grid.m_Cols * colRatio);
+                    for (int rootCol = 0; rootCol < rootColCount; rootCol++) {
+                        prvAddHistogram(&rowHistograms[rootCol * cellHistogramsSize],
+                                        &gridHistograms[(rootCol / colRatio) * cHistogramBinCount]);
+                    }
+                    if ((thisGridRow + 1) % rowRatio == 0 || thisGridRow + 1 == endGridRow) {
+                        prvRowMediansFromHistograms(gridHistograms, cHistogramBinCount, w, h, rowStep, grid.m_Cols,
+                                                    grid.m_ImageRowsInCell, grid.m_ImageColsInCell, gridRow,
+                                                    graySource.m_HistogramTable,
+                                                    &medians[grid.m_FirstMedian + gridRow * grid.m_Cols]);
+                        std::fill(gridHistograms, gridHistograms + grid.m_Cols * cHistogramBinCount, 0);
+                    }
+                }
+                gridHistograms += grid.m_Cols * cHistogramBinCount;
+            }
+        }
+    };
+    if (bandCount > 1) {
+        threadPool->ParallelFor(bandCount, analyzeBand);
+    }
+    else {
+        analyzeBand(0);
+    }
 }
 
+// Finds the medians for the cells in one grid row, counting every rowStep-th row of pixels, using
+// rowHistograms as scratch space. Leaves each cell's counts in the first of its lanes.
+void FrameProcessor::prvHistogramGridRow(const GrayRowSource &graySource, int w, int h, int rowStep,
+                                         const GridLayout &grid, int gridRow,
+                                         uint32_t *rowHistograms, int *medians) const
+{
+    GrayRowHistogramKernel rowKernel = GetGrayRowHistogramKernel();
+    int imageRowsInGridCell = grid.m_ImageRowsInCell;
+    int imageColsInGridCell = grid.m_ImageColsInCell;
+    int laneCount = HistogramLaneCount(imageRowsInGridCell * imageColsInGridCell);
+    size_t cellHistogramsSize = laneCount * cHistogramBinCount;
+    
+    // Determine the image rows covered by this grid row
+    int firstImageRow = std::min(gridRow * imageRowsInGridCell, h);
+    int endImageRow = std::min(firstImageRow + imageRowsInGridCell, h);
+    
+    // Count the values in each cell
+    std::fill(rowHistograms, rowHistograms + grid.m_Cols * cellHistogramsSize, 0);
+    int firstSampledRow = (firstImageRow + rowStep - 1) / rowStep * rowStep;
+    for (int thisImageRow = firstSampledRow; thisImageRow < endImageRow; thisImageRow += rowStep) {
+        if (graySource.m_FusedKernel != nullptr) {
+            graySource.m_FusedKernel->AddRow(thisImageRow, imageColsInGridCell,
+                                             laneCount, rowHistograms);
+        }
+        else {
+            rowKernel(graySource.m_Image + thisImageRow * graySource.m_RowBytes, w, imageColsInGridCell,
+                      laneCount, rowHistograms);
+        }
+    }
+    FoldHistogramLanes(rowHistograms, grid.m_Cols, laneCount);
+    
+    // Find the medians from the counts
+    prvRowMediansFromHistograms(rowHistograms, cellHistogramsSize, w, h, rowStep, grid.m_Cols,
+                                imageRowsInGridCell, imageColsInGridCell, gridRow,
+                                graySource.m_HistogramTable, medians);
+}
@@ -9,38 +9,137 @@
 #ifndef FrameProcessor_hpp
 #define FrameProcessor_hpp
 
-#include <string>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
+#include "FrameData.hpp"
+#include "FusedLuma.hpp"
+
 // Foreward declarations
 struct AVFrame;
 struct AVStream;
 struct AVCodecContext;
 struct SwsContext;
+class ThreadPool;
+
+// How the median of each grid cell is determined
+enum class MedianEngine {
+    Sort,           // Collect each cell's values and sort them; the reference implementation
+    Histogram       // Count each cell's values in 256 bins and walk the cumulative counts
+};
+
+// How frames are turned into grayscale values
+enum class GrayConversion {
+    Auto,           // Read luma directly from the frame when its format allows, otherwise use swscale
+    Swscale         // Always convert to GRAY8 with swscale
+};
+
+// The confidence of FrameProcessor::RankErrorBound()
+const double cRankErrorConfidence = 0.99;
+
+struct FrameProcessorOptions
+{
+    MedianEngine    m_MedianEngine = MedianEngine::Histogram;
+    GrayConversion  m_GrayConversion = GrayConversion::Auto;
+    
+    // If set, the histogram engine splits large frames into bands of grid rows and analyzes them
+    // in parallel on this pool. The pool can be shared by several frame processors.
+    ThreadPool*     m_BandThreadPool = nullptr;
+    
+    // If set, each cell's median is approximated from about this many of its pixels, picked by
+    // SampleLattice(), rather than from all of them. Cells with no more pixels than this are
+    // still exact.
+    int             m_SampleBudget = 0;
+};
 
+// Finds the medians of the cells of one or more grids laid over each keyframe. With several
+// grids, the frame is decoded and turned into grayscale once for all of them, and a grid whose
+// cells are exact blocks of a finer grid's cells has its counts summed from the finer grid's,
+// rather than counted from the pixels again.
 class FrameProcessor
 {
 public:
-    FrameProcessor(AVStream *stream, AVCodecContext* codecContext, int gridRows, int gridCols);
+    // The sink receives the results of ProcessKeyFrame(); it can be null if only
+    // AnalyzeKeyFrame() is used. Each frame's results hold the grids' medians one grid after
+    // another, in the order given; GridSplitter separates them.
+    FrameProcessor(AVStream *stream, AVCodecContext* codecContext, const std::vector<GridSize> &grids,
+                   FrameDataSink *sink, const FrameProcessorOptions &options = FrameProcessorOptions());
     ~FrameProcessor();
     
-    void ProcessKeyFrame(AVFrame *frame);
+    // Finds a frame's medians and writes them to the sink
+    void ProcessKeyFrame(const AVFrame *frame);
+    
+    // Finds a frame's medians without writing them, for callers that order results themselves.
+    // With subsample, only every few rows of pixels are counted, which is several times faster;
+    // the rows are the same for every grid and both engines. With a sample budget, subsample
+    // quarters the budget instead. The mode in frameData isn't set.
+    void AnalyzeKeyFrame(const AVFrame *frame, FrameData &frameData, bool subsample = false);
+    
+    // How a cell of cellRows x cellCols pixels is sampled with a budget: it's divided into
+    // strataRows x strataCols nearly equal rectangles, as close to square as the budget allows,
+    // and one pixel is taken from each, at a fixed pseudo-random place within it. That spreads
+    // the samples evenly over the cell without lining up with the codec's blocks.
+    static void SampleLattice(int cellRows, int cellCols, int sampleBudget, int &strataRows, int &strataCols);
     
-    std::string Report() const;
+    // How far, as a fraction of a cell's pixels, the rank of a median found from sampleCount of
+    // its pixelCount pixels can be from the true median's, with cRankErrorConfidence confidence.
+    // This is the Dvoretzky-Kiefer-Wolfowitz bound for independent random samples; a stratified
+    // sample usually does better. It's 0 when every pixel is counted.
+    static double RankErrorBound(size_t sampleCount, size_t pixelCount);
     
 protected:
     AVStream*       m_AVStream;
     AVCodecContext* m_AVCodecContext;
-    int             m_GridRows;
-    int             m_GridCols;
+    std::vector<GridSize> m_Grids;
+    size_t          m_CellCount;            // In all the grids
+    FrameProcessorOptions m_Options;
+    FrameDataSink*  m_Sink;
+    
+    SwsContext*     m_SwsContext;
+    std::vector<uint8_t> m_GrayImage;       // swscale's output, reused from frame to frame
+    FusedLumaKernel m_FusedLumaKernel;
     
-    struct FrameData {
-        double  m_Timestamp;
-        std::vector<int> m_CellGrayMedians;
+    // Where a grid's cells fall on frames of the current size, and where its medians go in a
+    // frame's results
+    struct GridLayout {
+        int         m_Rows;
+        int         m_Cols;
+        int         m_ImageRowsInCell;
+        int         m_ImageColsInCell;
+        size_t      m_FirstMedian;
     };
-    std::vector<FrameData> m_FrameData;
     
-    SwsContext*     m_SwsContext;
+    // A grid whose cells are counted from the pixels, and the grids whose cells are exact blocks
+    // of its cells, which are summed from its counts instead. Indexes are into m_Layouts.
+    struct GridFamily {
+        size_t      m_Root;
+        std::vector<size_t> m_Derived;
+    };
+    
+    int             m_LayoutWidth;
+    int             m_LayoutHeight;
+    std::vector<GridLayout> m_Layouts;
+    std::vector<GridFamily> m_Families;
+    int             m_SubsampleRowStep;     // Every cell, even at the edges, has a row this far apart
+    
+    // Per-cell value counts for one row of grid cells, and the sums for the grids made from
+    // them, one set for each band of a frame that's analyzed in parallel, reused from frame to
+    // frame
+    std::vector<std::vector<uint32_t>> m_BandHistograms;
+    
+    void prvPrepareLayouts(int w, int h);
+    void prvSortMedians(const uint8_t *grayImage, int w, int h, int rowBytes, int rowStep,
+                        const GridLayout &grid, int *medians);
+    struct GrayRowSource;
+    void prvHistogramMedians(const GrayRowSource &graySource, int w, int h, int rowStep,
+                             const GridFamily &family, FrameData &frameData);
+    void prvHistogramGridRow(const GrayRowSource &graySource, int w, int h, int rowStep,
+                             const GridLayout &grid, int gridRow,
+                             uint32_t *rowHistograms, int *medians) const;
+    void prvSampledMedians(const GrayRowSource &graySource, int w, int h, int sampleBudget,
+                           const GridLayout &grid, int *medians) const;
+    const uint8_t* prvConvertToGray(const AVFrame *frame);
 };
 
 #endif /* FrameProcessor_hpp */
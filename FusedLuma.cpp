@@ -0,0 +1,277 @@
+//
+//  FusedLuma.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "FusedLuma.hpp"
+#include "GridHistogram.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <libavutil/common.h>
+#include <libavutil/frame.h>
+#include <libavutil/intreadwrite.h>
+#include <libavutil/pixdesc.h>
+
+#if defined(__cplusplus)
+}
+#endif
+
+
+// Full-range luma weights in 16-bit fixed point; each set sums to 65536
+struct LumaWeights {
+    static const int cRed601 = 19595, cGreen601 = 38470, cBlue601 = 7471;      // BT.601: .299 .587 .114
+    static const int cRed709 = 13933, cGreen709 = 46871, cBlue709 = 4732;      // BT.709: .2126 .7152 .0722
+};
+
+template <bool kBT709>
+static inline int prvLuma(int red, int green, int blue)
+{
+    const int cRed = kBT709 ? LumaWeights::cRed709 : LumaWeights::cRed601;
+    const int cGreen = kBT709 ? LumaWeights::cGreen709 : LumaWeights::cGreen601;
+    const int cBlue = kBT709 ? LumaWeights::cBlue709 : LumaWeights::cBlue601;
+    return (cRed * red + cGreen * green + cBlue * blue + 32768) >> 16;
+}
+
+
+const uint8_t* LimitedToFullRangeTable()
+{
+    struct Table {
+        uint8_t m_Values[cHistogramBinCount];
+        
+        Table() {
+            for (int value = 0; value < cHistogramBinCount; value++) {
+                int value15 = value << 7;                                           // 15-bit intermediate
+                int full15 = (std::min(value15, 30189) * 19077 - 39057361) >> 14;   // Expand the range
+                m_Values[value] = av_clip_uint8((full15 + 64) >> 7);                // Round back to 8 bits
+            }
+        }
+    };
+    static const Table sTable;
+    return sTable.m_Values;
+}
+
+
+FusedLumaKernel::FusedLumaKernel() :
+m_RowKernel(nullptr),
+m_Name(""),
+m_Frame(nullptr),
+m_HistogramTable(nullptr),
+m_DeepLumaDepth(0),
+m_DeepLumaShift(0),
+m_DeepLumaIsFullRange(false)
+{
+}
+
+
+bool FusedLumaKernel::Prepare(const AVFrame *frame)
+{
+    m_Frame = frame;
+    m_HistogramTable = nullptr;
+    
+    // RGB frames say BT.709 when they were made from BT.709 video; otherwise use BT.601, as swscale does
+    bool isBT709 = (frame->colorspace == AVCOL_SPC_BT709);
+    bool yuvIsFullRange = (frame->color_range == AVCOL_RANGE_JPEG);
+    
+    switch ((AVPixelFormat)frame->format) {
+            // Packed RGB, with or without alpha or padding
+        case AV_PIX_FMT_RGB24:
+            m_RowKernel = isBT709 ? prvPackedRGBRow<0, 1, 2, 3, true> : prvPackedRGBRow<0, 1, 2, 3, false>;
+            m_Name = "rgb24";
+            break;
+        case AV_PIX_FMT_BGR24:
+            m_RowKernel = isBT709 ? prvPackedRGBRow<2, 1, 0, 3, true> : prvPackedRGBRow<2, 1, 0, 3, false>;
+            m_Name = "bgr24";
+            break;
+        case AV_PIX_FMT_RGBA:
+        case AV_PIX_FMT_RGB0:
+            m_RowKernel = isBT709 ? prvPackedRGBRow<0, 1, 2, 4, true> : prvPackedRGBRow<0, 1, 2, 4, false>;
+            m_Name = "rgba";
+            break;
+        case AV_PIX_FMT_BGRA:
+        case AV_PIX_FMT_BGR0:
+            m_RowKernel = isBT709 ? prvPackedRGBRow<2, 1, 0, 4, true> : prvPackedRGBRow<2, 1, 0, 4, false>;
+            m_Name = "bgra";
+            break;
+        case AV_PIX_FMT_ARGB:
+        case AV_PIX_FMT_0RGB:
+            m_RowKernel = isBT709 ? prvPackedRGBRow<1, 2, 3, 4, true> : prvPackedRGBRow<1, 2, 3, 4, false>;
+            m_Name = "argb";
+            break;
+        case AV_PIX_FMT_ABGR:
+        case AV_PIX_FMT_0BGR:
+            m_RowKernel = isBT709 ? prvPackedRGBRow<3, 2, 1, 4, true> : prvPackedRGBRow<3, 2, 1, 4, false>;
+            m_Name = "abgr";
+            break;
+            
+            // Planar RGB, as from 4:4:4 RGB codecs
+        case AV_PIX_FMT_GBRP:
+        case AV_PIX_FMT_GBRAP:
+            m_RowKernel = isBT709 ? prvPlanarGBRRow<true> : prvPlanarGBRRow<false>;
+            m_Name = "gbrp";
+            break;
+            
+            // Packed 4:2:2 YUV: the luma bytes are counted as they are, and mapped to full range
+            // on the histograms if needed
+        case AV_PIX_FMT_YUYV422:
+        case AV_PIX_FMT_YVYU422:
+            m_RowKernel = prvPackedYUVRow<0>;
+            m_HistogramTable = yuvIsFullRange ? nullptr : LimitedToFullRangeTable();
+            m_Name = "yuyv422";
+            break;
+        case AV_PIX_FMT_UYVY422:
+            m_RowKernel = prvPackedYUVRow<1>;
+            m_HistogramTable = yuvIsFullRange ? nullptr : LimitedToFullRangeTable();
+            m_Name = "uyvy422";
+            break;
+        
+        default:
+            // 9-16 bit YUV, e.g. yuv422p10le from ProRes
+            if (!prvPrepareDeepLuma(frame)) {
+                m_RowKernel = nullptr;
+                m_Name = "";
+                return false;
+            }
+            m_RowKernel = prvDeepLumaRow;
+            m_Name = "deep luma";
+            break;
+    }
+    return true;
+}
+
+
+void FusedLumaKernel::AddRow(int y, int cellWidth, int laneCount, uint32_t *cellHistograms) const
+{
+    assert(m_RowKernel != nullptr);
+    m_RowKernel(*this, y, cellWidth, laneCount, cellHistograms);
+}
+
+
+// Sets up a table from 9-16 bit little-endian luma in the first plane to 8-bit full-range gray
+bool FusedLumaKernel::prvPrepareDeepLuma(const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *descriptor = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    if (descriptor == nullptr) {
+        return false;
+    }
+    const uint64_t cUnsupportedFlags = AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_BE |
+                                       AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM |
+                                       AV_PIX_FMT_FLAG_FLOAT;
+    if (descriptor->flags & cUnsupportedFlags) {
+        return false;
+    }
+    const AVComponentDescriptor &luma = descriptor->comp[0];
+    if (luma.plane != 0 || luma.step != 2 || luma.offset != 0 || luma.depth <= 8 || luma.depth > 16) {
+        return false;
+    }
+    
+    // The J formats are all 8-bit, so only the decoder can say a deep format is full range
+    bool isFullRange = (frame->color_range == AVCOL_RANGE_JPEG);
+    if (luma.depth == m_DeepLumaDepth && luma.shift == m_DeepLumaShift &&
+        isFullRange == m_DeepLumaIsFullRange && !m_DeepLumaTable.empty()) {
+        return true;        // The table is already set up
+    }
+    
+    m_DeepLumaDepth = luma.depth;
+    m_DeepLumaShift = luma.shift;
+    m_DeepLumaIsFullRange = isFullRange;
+    int valueCount = 1 << luma.depth;
+    m_DeepLumaTable.resize(valueCount);
+    
+    // Limited range runs from 16 to 235, scaled up to the bit depth
+    int depthScale = 1 << (luma.depth - 8);
+    int black = isFullRange ? 0 : 16 * depthScale;
+    int span = isFullRange ? valueCount - 1 : 219 * depthScale;
+    for (int value = 0; value < valueCount; value++) {
+        int gray = ((value - black) * 255 + span / 2) / span;
+        if (value < black) {
+            gray = 0;       // Round toward black rather than toward zero
+        }
+        m_DeepLumaTable[value] = av_clip_uint8(gray);
+    }
+    return true;
+}
+
+
+// -------- Row kernels --------
+//
+// Each walks the row a grid cell at a time, so there's no division per pixel, and counts into
+// the first lane of each cell's histograms.
+
+template <int kRedOffset, int kGreenOffset, int kBlueOffset, int kStep, bool kBT709>
+void FusedLumaKernel::prvPackedRGBRow(const FusedLumaKernel &kernel, int y, int cellWidth,
+                                      int laneCount, uint32_t *cellHistograms)
+{
+    const AVFrame *frame = kernel.m_Frame;
+    const uint8_t *pixel = frame->data[0] + y * frame->linesize[0];
+    int width = frame->width;
+    for (int firstCol = 0; firstCol < width; firstCol += cellWidth) {
+        int endCol = std::min(firstCol + cellWidth, width);
+        for (int col = firstCol; col < endCol; col++) {
+            cellHistograms[prvLuma<kBT709>(pixel[kRedOffset], pixel[kGreenOffset], pixel[kBlueOffset])]++;
+            pixel += kStep;
+        }
+        cellHistograms += laneCount * cHistogramBinCount;
+    }
+}
+
+template <bool kBT709>
+void FusedLumaKernel::prvPlanarGBRRow(const FusedLumaKernel &kernel, int y, int cellWidth,
+                                      int laneCount, uint32_t *cellHistograms)
+{
+    const AVFrame *frame = kernel.m_Frame;
+    const uint8_t *green = frame->data[0] + y * frame->linesize[0];
+    const uint8_t *blue = frame->data[1] + y * frame->linesize[1];
+    const uint8_t *red = frame->data[2] + y * frame->linesize[2];
+    int width = frame->width;
+    for (int firstCol = 0; firstCol < width; firstCol += cellWidth) {
+        int endCol = std::min(firstCol + cellWidth, width);
+        for (int col = firstCol; col < endCol; col++) {
+            cellHistograms[prvLuma<kBT709>(red[col], green[col], blue[col])]++;
+        }
+        cellHistograms += laneCount * cHistogramBinCount;
+    }
+}
+
+template <int kLumaOffset>
+void FusedLumaKernel::prvPackedYUVRow(const FusedLumaKernel &kernel, int y, int cellWidth,
+                                      int laneCount, uint32_t *cellHistograms)
+{
+    const AVFrame *frame = kernel.m_Frame;
+    const uint8_t *luma = frame->data[0] + y * frame->linesize[0] + kLumaOffset;
+    int width = frame->width;
+    for (int firstCol = 0; firstCol < width; firstCol += cellWidth) {
+        int endCol = std::min(firstCol + cellWidth, width);
+        for (int col = firstCol; col < endCol; col++) {
+            cellHistograms[luma[2 * col]]++;
+        }
+        cellHistograms += laneCount * cHistogramBinCount;
+    }
+}
+
+void FusedLumaKernel::prvDeepLumaRow(const FusedLumaKernel &kernel, int y, int cellWidth,
+                                     int laneCount, uint32_t *cellHistograms)
+{
+    const AVFrame *frame = kernel.m_Frame;
+    const uint8_t *luma = frame->data[0] + y * frame->linesize[0];
+    const uint8_t *table = kernel.m_DeepLumaTable.data();
+    int shift = kernel.m_DeepLumaShift;
+    int valueMask = (1 << kernel.m_DeepLumaDepth) - 1;
+    int width = frame->width;
+    for (int firstCol = 0; firstCol < width; firstCol += cellWidth) {
+        int endCol = std::min(firstCol + cellWidth, width);
+        for (int col = firstCol; col < endCol; col++) {
+            int value = AV_RL16(luma + 2 * col);        // Little-endian, as checked in Prepare()
+            cellHistograms[table[(value >> shift) & valueMask]]++;
+        }
+        cellHistograms += laneCount * cHistogramBinCount;
+    }
+}
@@ -0,0 +1,72 @@
+//
+//  FusedLuma.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef FusedLuma_hpp
+#define FusedLuma_hpp
+
+#include <cstdint>
+#include <vector>
+
+// Foreward declarations
+struct AVFrame;
+
+// Computes grayscale values from frames that have no 8-bit luma plane, such as packed and planar
+// RGB, packed YUV, and 9-16 bit YUV like ProRes 4:2:2 10-bit, and counts them into grid cell
+// histograms in the same pass. Each source byte is read once, and no gray image is stored.
+class FusedLumaKernel
+{
+public:
+    FusedLumaKernel();
+    
+    // Sets up for a frame, and returns whether there's a kernel for its pixel format
+    bool Prepare(const AVFrame *frame);
+    
+    // Adds the gray values for image row y to the histograms of the grid cells the row crosses,
+    // laid out as for GrayRowHistogramKernel, but only using each cell's first lane
+    void AddRow(int y, int cellWidth, int laneCount, uint32_t *cellHistograms) const;
+    
+    // A mapping to apply to the counts before finding medians, or null if none is needed
+    const uint8_t* HistogramTable() const { return m_HistogramTable; }
+    
+    const char* Name() const { return m_Name; }
+
+private:
+    typedef void (*RowKernel)(const FusedLumaKernel &kernel, int y, int cellWidth,
+                              int laneCount, uint32_t *cellHistograms);
+    
+    RowKernel       m_RowKernel;
+    const char*     m_Name;
+    const AVFrame*  m_Frame;
+    const uint8_t*  m_HistogramTable;
+    
+    // For 9-16 bit luma: maps each possible value to 8-bit full-range gray
+    std::vector<uint8_t> m_DeepLumaTable;
+    int             m_DeepLumaDepth;
+    int             m_DeepLumaShift;
+    bool            m_DeepLumaIsFullRange;
+    
+    template <int kRedOffset, int kGreenOffset, int kBlueOffset, int kStep, bool kBT709>
+    static void prvPackedRGBRow(const FusedLumaKernel &kernel, int y, int cellWidth,
+                                int laneCount, uint32_t *cellHistograms);
+    template <bool kBT709>
+    static void prvPlanarGBRRow(const FusedLumaKernel &kernel, int y, int cellWidth,
+                                int laneCount, uint32_t *cellHistograms);
+    template <int kLumaOffset>
+    static void prvPackedYUVRow(const FusedLumaKernel &kernel, int y, int cellWidth,
+                                int laneCount, uint32_t *cellHistograms);
+    static void prvDeepLumaRow(const FusedLumaKernel &kernel, int y, int cellWidth,
+                               int laneCount, uint32_t *cellHistograms);
+    
+    bool prvPrepareDeepLuma(const AVFrame *frame);
+};
+
+// Returns a table that maps limited-range 8-bit luma (16-235) to full-range gray (0-255), using
+// the same fixed-point steps as swscale's conversion to GRAY8
+const uint8_t* LimitedToFullRangeTable();
+
+#endif /* FusedLuma_hpp */
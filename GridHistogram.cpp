@@ -0,0 +1,231 @@
+//
+//  GridHistogram.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "GridHistogram.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <libavutil/cpu.h>
+
+#if defined(__cplusplus)
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GRID_HISTOGRAM_X86 1
+#include <immintrin.h>
+#endif
+
+
+// Cells with at least this many pixels spread their counts over several histogram lanes
+const int cMinPixelCountForLanes = 16 * 1024;
+const int cLaneCount = 4;
+
+// -------- Scalar building blocks, inlined into every kernel --------
+
+static inline uint64_t prvLoad64(const uint8_t *p)
+{
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));     // Unaligned-safe; compiles to a single load
+    return word;
+}
+
+// Counts the 8 bytes in a little-endian word, rotating through the lanes
+template <int kLanes>
+static inline void prvAddWord(uint64_t word, uint32_t *histogram)
+{
+    for (int i = 0; i < 8; i++) {
+        histogram[(i % kLanes) * cHistogramBinCount + (word & 0xFF)]++;
+        word >>= 8;
+    }
+}
+
+template <int kLanes>
+static inline void prvAddBytes(const uint8_t *p, int count, uint32_t *histogram)
+{
+    for (int i = 0; i < count; i++) {
+        histogram[(i % kLanes) * cHistogramBinCount + p[i]]++;
+    }
+}
+
+
+// -------- Span kernels: count one cell's worth of a row --------
+//
+// Each kernel looks at a block of bytes at a time. Flat areas such as letterboxing and fades are
+// common in video, and when every byte in a block matches, the whole block is counted with a single
+// add. Otherwise the block is counted 8 bytes at a time from 64-bit words.
+
+template <int kLanes>
+static void prvSpanScalar(const uint8_t *p, int count, uint32_t *histogram)
+{
+    const uint64_t cByteSpread = 0x0101010101010101ULL;
+    while (count >= 8) {
+        uint64_t word = prvLoad64(p);
+        if (word == (word & 0xFF) * cByteSpread) {
+            histogram[p[0]] += 8;
+        }
+        else {
+            prvAddWord<kLanes>(word, histogram);
+        }
+        p += 8;
+        count -= 8;
+    }
+    prvAddBytes<kLanes>(p, count, histogram);
+}
+
+#if GRID_HISTOGRAM_X86
+
+template <int kLanes>
+__attribute__((target("sse2")))
+static void prvSpanSSE2(const uint8_t *p, int count, uint32_t *histogram)
+{
+    while (count >= 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        __m128i first = _mm_set1_epi8((char)p[0]);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(block, first)) == 0xFFFF) {
+            histogram[p[0]] += 16;
+        }
+        else {
+            prvAddWord<kLanes>(prvLoad64(p), histogram);
+            prvAddWord<kLanes>(prvLoad64(p + 8), histogram);
+        }
+        p += 16;
+        count -= 16;
+    }
+    prvAddBytes<kLanes>(p, count, histogram);
+}
+
+template <int kLanes>
+__attribute__((target("avx2")))
+static void prvSpanAVX2(const uint8_t *p, int count, uint32_t *histogram)
+{
+    while (count >= 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)p);
+        __m256i first = _mm256_set1_epi8((char)p[0]);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, first)) == -1) {
+            histogram[p[0]] += 32;
+        }
+        else {
+            for (int i = 0; i < 32; i += 8) {
+                prvAddWord<kLanes>(prvLoad64(p + i), histogram);
+            }
+        }
+        p += 32;
+        count -= 32;
+    }
+    prvAddBytes<kLanes>(p, count, histogram);
+}
+
+template <int kLanes>
+__attribute__((target("avx512f,avx512bw")))
+static void prvSpanAVX512(const uint8_t *p, int count, uint32_t *histogram)
+{
+    while (count >= 64) {
+        __m512i block = _mm512_loadu_si512((const void *)p);
+        __m512i first = _mm512_set1_epi8((char)p[0]);
+        if (_mm512_cmpeq_epi8_mask(block, first) == ~0ULL) {
+            histogram[p[0]] += 64;
+        }
+        else {
+            for (int i = 0; i < 64; i += 8) {
+                prvAddWord<kLanes>(prvLoad64(p + i), histogram);
+            }
+        }
+        p += 64;
+        count -= 64;
+    }
+    prvAddBytes<kLanes>(p, count, histogram);
+}
+
+#endif // GRID_HISTOGRAM_X86
+
+
+// -------- Row kernels: walk a row in cell-width spans, so there's no division per pixel --------
+
+typedef void (*SpanKernel)(const uint8_t *p, int count, uint32_t *histogram);
+
+template <SpanKernel kSingleLaneSpan, SpanKernel kMultiLaneSpan>
+static void prvRowKernel(const uint8_t *row, int width, int cellWidth,
+                         int laneCount, uint32_t *cellHistograms)
+{
+    assert(laneCount == 1 || laneCount == cLaneCount);
+    SpanKernel spanKernel = (laneCount == 1) ? kSingleLaneSpan : kMultiLaneSpan;
+    size_t cellHistogramsSize = laneCount * cHistogramBinCount;
+    for (int firstCol = 0; firstCol < width; firstCol += cellWidth) {
+        int spanWidth = std::min(cellWidth, width - firstCol);
+        spanKernel(row + firstCol, spanWidth, cellHistograms);
+        cellHistograms += cellHistogramsSize;
+    }
+}
+
+struct KernelChoice {
+    GrayRowHistogramKernel  m_Kernel;
+    const char*             m_Name;
+};
+
+static KernelChoice prvChooseKernel()
+{
+#if GRID_HISTOGRAM_X86
+    int cpuFlags = av_get_cpu_flags();
+    if (cpuFlags & AV_CPU_FLAG_AVX512) {
+        return { prvRowKernel<prvSpanAVX512<1>, prvSpanAVX512<cLaneCount> >, "AVX-512" };
+    }
+    if (cpuFlags & AV_CPU_FLAG_AVX2) {
+        return { prvRowKernel<prvSpanAVX2<1>, prvSpanAVX2<cLaneCount> >, "AVX2" };
+    }
+    if (cpuFlags & AV_CPU_FLAG_SSE2) {
+        return { prvRowKernel<prvSpanSSE2<1>, prvSpanSSE2<cLaneCount> >, "SSE2" };
+    }
+#endif
+    return { prvRowKernel<prvSpanScalar<1>, prvSpanScalar<cLaneCount> >, "scalar" };
+}
+
+static const KernelChoice &prvKernelChoice()
+{
+    static const KernelChoice sKernelChoice = prvChooseKernel();     // Thread-safe one-time init
+    return sKernelChoice;
+}
+
+GrayRowHistogramKernel GetGrayRowHistogramKernel()
+{
+    return prvKernelChoice().m_Kernel;
+}
+
+const char* GetGrayRowHistogramKernelName()
+{
+    return prvKernelChoice().m_Name;
+}
+
+
+int HistogramLaneCount(int cellPixelCount)
+{
+    return (cellPixelCount >= cMinPixelCountForLanes) ? cLaneCount : 1;
+}
+
+void FoldHistogramLanes(uint32_t *cellHistograms, int cellCount, int laneCount)
+{
+    if (laneCount == 1) {
+        return;
+    }
+    for (int cell = 0; cell < cellCount; cell++) {
+        uint32_t *firstLane = cellHistograms;
+        for (int lane = 1; lane < laneCount; lane++) {
+            const uint32_t *thisLane = cellHistograms + lane * cHistogramBinCount;
+            for (int bin = 0; bin < cHistogramBinCount; bin++) {
+                firstLane[bin] += thisLane[bin];
+            }
+        }
+        cellHistograms += laneCount * cHistogramBinCount;
+    }
+}
@@ -0,0 +1,35 @@
+//
+//  GridHistogram.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef GridHistogram_hpp
+#define GridHistogram_hpp
+
+#include <cstdint>
+
+const int cHistogramBinCount = 256;
+
+// Adds the values in one row of 8-bit gray pixels to the histograms of the grid cells the row
+// crosses. Cells are cellWidth pixels wide, except possibly the last one. Each cell has laneCount
+// consecutive 256-bin histograms in cellHistograms; successive pixels are spread across the lanes
+// so runs of similar values don't stall on incrementing the same counter. Call
+// FoldHistogramLanes() before reading the counts.
+typedef void (*GrayRowHistogramKernel)(const uint8_t *row, int width, int cellWidth,
+                                       int laneCount, uint32_t *cellHistograms);
+
+// Returns the fastest kernel for this CPU, chosen once using av_get_cpu_flags()
+GrayRowHistogramKernel  GetGrayRowHistogramKernel();
+const char*             GetGrayRowHistogramKernelName();
+
+// Returns how many histogram lanes are worth using for cells with this many pixels. Lanes cost
+// a fold per grid row, so small cells use just one.
+int     HistogramLaneCount(int cellPixelCount);
+
+// Sums each cell's lanes into its first lane
+void    FoldHistogramLanes(uint32_t *cellHistograms, int cellCount, int laneCount);
+
+#endif /* GridHistogram_hpp */
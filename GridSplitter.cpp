@@ -0,0 +1,46 @@
+//
+//  GridSplitter.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "GridSplitter.hpp"
+
+#include <cassert>
+
+
+GridSplitter::GridSplitter(const std::vector<GridSize> &grids, const std::vector<FrameDataSink*> &sinks) :
+m_Sinks(sinks)
+{
+    assert(grids.size() == sinks.size());
+    for (const GridSize &grid : grids) {
+        m_CellCounts.push_back((size_t)grid.m_Rows * (size_t)grid.m_Cols);
+    }
+}
+
+
+void GridSplitter::WriteFrame(const FrameData &frameData)
+{
+    m_GridFrameData.m_Timestamp = frameData.m_Timestamp;
+    m_GridFrameData.m_Mode = frameData.m_Mode;
+    std::vector<int>::const_iterator gridMedians = frameData.m_CellGrayMedians.begin();
+    for (size_t i = 0; i < m_Sinks.size(); i++) {
+        assert(frameData.m_CellGrayMedians.end() - gridMedians >= (ptrdiff_t)m_CellCounts[i]);
+        m_GridFrameData.m_CellGrayMedians.assign(gridMedians, gridMedians + m_CellCounts[i]);
+        m_Sinks[i]->WriteFrame(m_GridFrameData);
+        gridMedians += m_CellCounts[i];
+    }
+    assert(gridMedians == frameData.m_CellGrayMedians.end());
+}
+
+
+bool GridSplitter::Finish()
+{
+    bool succeeded = true;
+    for (FrameDataSink *sink : m_Sinks) {
+        succeeded = sink->Finish() && succeeded;
+    }
+    return succeeded;
+}
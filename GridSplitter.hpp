@@ -0,0 +1,36 @@
+//
+//  GridSplitter.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef GridSplitter_hpp
+#define GridSplitter_hpp
+
+#include <cstddef>
+#include <vector>
+
+#include "FrameData.hpp"
+
+// Takes the results of a FrameProcessor with several grids, and passes each grid's medians to
+// that grid's own sink
+class GridSplitter : public FrameDataSink
+{
+public:
+    // There's a sink for each grid, in the same order
+    GridSplitter(const std::vector<GridSize> &grids, const std::vector<FrameDataSink*> &sinks);
+    
+    void WriteFrame(const FrameData &frameData) override;
+    
+    // Finishes every grid's sink, and returns false if any of them failed
+    bool Finish() override;
+
+private:
+    std::vector<size_t>         m_CellCounts;
+    std::vector<FrameDataSink*> m_Sinks;
+    FrameData                   m_GridFrameData;    // Reused from frame to frame
+};
+
+#endif /* GridSplitter_hpp */
@@ -0,0 +1,425 @@
+//
+//  InputIO.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "InputIO.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <libavformat/avio.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+
+#if defined(__cplusplus)
+}
+#endif
+
+#include "ElapsedTime.hpp"
+
+// libavformat reads through a buffer this big. It's larger than its default, since every read
+// goes through a callback.
+static const int cIOContextBufferSize = 256 * 1024;
+
+// The read-ahead thread reads in chunks this big, into a ring buffer this big
+static const size_t cReadAheadChunkSize = 1024 * 1024;
+static const size_t cReadAheadBufferSize = 32 * 1024 * 1024;
+
+
+#pragma mark - Memory-mapped input
+
+// Copies from a map of the whole file. The time spent copying is counted as waiting, since it's
+// where page faults read the file in.
+class MmapInputIO : public InputIO
+{
+public:
+    MmapInputIO() : m_Mapping(nullptr), m_Position(0) {}
+    
+    ~MmapInputIO()
+    {
+        if (m_Mapping) {
+            munmap(m_Mapping, (size_t)m_FileSize);
+        }
+    }
+
+protected:
+    bool prvOpen(const std::string &filepath) override
+    {
+        if (!InputIO::prvOpen(filepath)) {
+            return false;
+        }
+        if (m_FileSize == 0) {
+            fprintf(stderr, "\"%s\" is empty\n", filepath.c_str());
+            return false;
+        }
+        void *mapping = mmap(nullptr, (size_t)m_FileSize, PROT_READ, MAP_SHARED, m_FD, 0);
+        if (mapping == MAP_FAILED) {
+            fprintf(stderr, "Can't map \"%s\"\n", filepath.c_str());
+            return false;
+        }
+        m_Mapping = (uint8_t *)mapping;
+        madvise(m_Mapping, (size_t)m_FileSize, MADV_SEQUENTIAL);
+        return true;
+    }
+    
+    int prvRead(uint8_t *buffer, int size) override
+    {
+        int readSize = (int)std::min<int64_t>(size, m_FileSize - m_Position);
+        if (readSize <= 0) {
+            return AVERROR_EOF;
+        }
+        std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+        memcpy(buffer, m_Mapping + m_Position, readSize);
+        m_IOWaitSeconds += SecondsSince(startTime);
+        m_Position += readSize;
+        return readSize;
+    }
+    
+    int64_t prvSeek(int64_t position) override
+    {
+        m_Position = position;
+        return m_Position;
+    }
+    
+    int64_t prvPosition() const override
+    {
+        return m_Position;
+    }
+
+private:
+    uint8_t*    m_Mapping;
+    int64_t     m_Position;
+};
+
+
+#pragma mark - Read-ahead input
+
+// A thread reads the file ahead of the demuxer into a ring buffer, so the demuxer only waits when
+// the disk or network falls behind. Seeks within the buffered data skip ahead in the buffer;
+// other seeks restart the reading at the new position.
+class ReadAheadInputIO : public InputIO
+{
+public:
+    ReadAheadInputIO() :
+    m_Buffer(cReadAheadBufferSize),
+    m_Position(0),
+    m_Head(0),
+    m_Count(0),
+    m_Generation(0),
+    m_ReadFailed(false),
+    m_Stopping(false)
+    {
+    }
+    
+    ~ReadAheadInputIO()
+    {
+        if (m_Thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stopping = true;
+            }
+            m_SpaceAvailable.notify_one();
+            m_Thread.join();
+        }
+    }
+
+protected:
+    bool prvOpen(const std::string &filepath) override
+    {
+        if (!InputIO::prvOpen(filepath)) {
+            return false;
+        }
+        m_Thread = std::thread(&ReadAheadInputIO::prvReadLoop, this);
+        return true;
+    }
+    
+    int prvRead(uint8_t *buffer, int size) override
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        if (m_Count == 0 && m_Position < m_FileSize && !m_ReadFailed) {
+            std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+            m_DataAvailable.wait(lock, [this]() { return m_Count > 0 || m_ReadFailed; });
+            m_IOWaitSeconds += SecondsSince(startTime);
+        }
+        if (m_Count == 0) {
+            return (m_Position >= m_FileSize) ? AVERROR_EOF : AVERROR(EIO);
+        }
+        
+        // Copy what's contiguous in the ring; the demuxer asks again for the rest
+        size_t readSize = std::min(std::min((size_t)size, m_Count), m_Buffer.size() - m_Head);
+        memcpy(buffer, &m_Buffer[m_Head], readSize);
+        prvConsume(readSize);
+        lock.unlock();
+        m_SpaceAvailable.notify_one();
+        return (int)readSize;
+    }
+    
+    int64_t prvSeek(int64_t position) override
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        if (position >= m_Position && position <= m_Position + (int64_t)m_Count) {
+            prvConsume((size_t)(position - m_Position));
+        }
+        else {
+            // Drop the buffer, including anything the thread is reading now
+            m_Generation++;
+            m_Position = position;
+            m_Head = 0;
+            m_Count = 0;
+            m_ReadFailed = false;
+        }
+        lock.unlock();
+        m_SpaceAvailable.notify_one();
+        return position;
+    }
+    
+    int64_t prvPosition() const override
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Position;
+    }
+
+private:
+    std::vector<uint8_t>    m_Buffer;
+    int64_t                 m_Position;         // The file offset of the next byte the demuxer gets
+    size_t                  m_Head;             // Where that byte is in the ring
+    size_t                  m_Count;            // How many bytes from there on are ready
+    uint64_t                m_Generation;       // Changes when a seek drops the buffer
+    bool                    m_ReadFailed;
+    bool                    m_Stopping;
+    
+    mutable std::mutex      m_Mutex;
+    std::condition_variable m_DataAvailable;
+    std::condition_variable m_SpaceAvailable;
+    std::thread             m_Thread;
+    
+    // Must be called with the mutex locked
+    void prvConsume(size_t size)
+    {
+        assert(size <= m_Count);
+        m_Head = (m_Head + size) % m_Buffer.size();
+        m_Count -= size;
+        m_Position += size;
+    }
+    
+    void prvReadLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (!m_Stopping) {
+            // Wait until there's room in the ring and more of the file to read
+            int64_t readPosition = m_Position + (int64_t)m_Count;
+            size_t space = m_Buffer.size() - m_Count;
+            if (space == 0 || readPosition >= m_FileSize || m_ReadFailed) {
+                m_SpaceAvailable.wait(lock);
+                continue;
+            }
+            
+            // Read into the free space after the ready bytes, without holding the lock. The
+            // demuxer never looks at that space, and a seek only changes the generation.
+            size_t tail = (m_Head + m_Count) % m_Buffer.size();
+            size_t readSize = std::min(std::min(cReadAheadChunkSize, space), m_Buffer.size() - tail);
+            readSize = (size_t)std::min<int64_t>((int64_t)readSize, m_FileSize - readPosition);
+            uint64_t generation = m_Generation;
+            lock.unlock();
+            ssize_t readCount = pread(m_FD, &m_Buffer[tail], readSize, readPosition);
+            int readError = errno;
+            lock.lock();
+            
+            if (generation != m_Generation) {         // A seek dropped what was read
+                continue;
+            }
+            if (readCount > 0) {
+                m_Count += (size_t)readCount;
+            }
+            else if (readCount == 0 || readError != EINTR) {
+                m_ReadFailed = true;                    // The file is shorter than it was, or unreadable
+            }
+            m_DataAvailable.notify_one();
+        }
+    }
+};
+
+
+#pragma mark - Streamed input
+
+// Reads a pipe, FIFO, or stdin front to back, handing the demuxer whatever has arrived rather than
+// waiting to fill its buffer, so each packet is demuxed as soon as its last byte comes in. The
+// input can't seek, and its size isn't known.
+class StreamInputIO : public InputIO
+{
+public:
+    StreamInputIO() : m_Position(0) {}
+
+protected:
+    bool prvOpen(const std::string &filepath) override
+    {
+        m_FD = (filepath == cStdinFilepath) ? dup(STDIN_FILENO) : open(filepath.c_str(), O_RDONLY);
+        if (m_FD < 0) {
+            fprintf(stderr, "Can't read \"%s\"\n", filepath.c_str());
+            return false;
+        }
+        m_FileSize = -1;
+        return true;
+    }
+    
+    bool prvCanSeek() const override
+    {
+        return false;
+    }
+    
+    int prvRead(uint8_t *buffer, int size) override
+    {
+        std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+        ssize_t readCount = -1;
+        do {
+            readCount = read(m_FD, buffer, (size_t)size);
+        } while (readCount < 0 && errno == EINTR);
+        m_IOWaitSeconds += SecondsSince(startTime);
+        if (readCount == 0) {
+            return AVERROR_EOF;
+        }
+        if (readCount < 0) {
+            return AVERROR(EIO);
+        }
+        m_Position += readCount;
+        return (int)readCount;
+    }
+    
+    int64_t prvSeek(int64_t) override
+    {
+        assert(false);
+        return AVERROR(ESPIPE);
+    }
+    
+    int64_t prvPosition() const override
+    {
+        return m_Position;
+    }
+
+private:
+    int64_t     m_Position;
+};
+
+
+#pragma mark - InputIO
+
+std::unique_ptr<InputIO> InputIO::Open(const std::string &filepath, InputIOMode mode)
+{
+    std::unique_ptr<InputIO> inputIO;
+    switch (mode) {
+        case InputIOMode::Mmap:
+            inputIO.reset(new MmapInputIO);
+            break;
+        case InputIOMode::ReadAhead:
+            inputIO.reset(new ReadAheadInputIO);
+            break;
+        case InputIOMode::Stream:
+            inputIO.reset(new StreamInputIO);
+            break;
+        case InputIOMode::Ffmpeg:
+            assert(false);
+            return nullptr;
+    }
+    if (!inputIO->prvOpen(filepath)) {
+        return nullptr;
+    }
+    
+    uint8_t *buffer = (uint8_t *)av_malloc(cIOContextBufferSize);
+    if (buffer == NULL) {
+        fprintf(stderr, "Can't allocate an I/O buffer\n");
+        return nullptr;
+    }
+    inputIO->m_IOContext = avio_alloc_context(buffer, cIOContextBufferSize, 0, inputIO.get(), prvReadCallback,
+                                              NULL, inputIO->prvCanSeek() ? prvSeekCallback : NULL);
+    if (inputIO->m_IOContext == NULL) {
+        av_free(buffer);
+        fprintf(stderr, "Can't allocate an I/O context\n");
+        return nullptr;
+    }
+    return inputIO;
+}
+
+
+InputIO::InputIO() :
+m_FD(-1),
+m_FileSize(0),
+m_IOWaitSeconds(0.0),
+m_IOContext(nullptr)
+{
+}
+
+InputIO::~InputIO()
+{
+    // libavformat may have replaced the buffer, so free the one the context has now
+    if (m_IOContext) {
+        av_freep(&m_IOContext->buffer);
+        avio_context_free(&m_IOContext);
+    }
+    if (m_FD >= 0) {
+        close(m_FD);
+    }
+}
+
+
+bool InputIO::prvOpen(const std::string &filepath)
+{
+    m_FD = open(filepath.c_str(), O_RDONLY);
+    struct stat statbuf;
+    if (m_FD < 0 || fstat(m_FD, &statbuf) != 0) {
+        fprintf(stderr, "Can't read \"%s\"\n", filepath.c_str());
+        return false;
+    }
+    m_FileSize = (int64_t)statbuf.st_size;
+    return true;
+}
+
+
+int InputIO::prvReadCallback(void *opaque, uint8_t *buffer, int size)
+{
+    return ((InputIO *)opaque)->prvRead(buffer, size);
+}
+
+int64_t InputIO::prvSeekCallback(void *opaque, int64_t offset, int whence)
+{
+    InputIO *inputIO = (InputIO *)opaque;
+    int64_t position = 0;
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE:
+            return inputIO->m_FileSize;
+        case SEEK_SET:
+            position = offset;
+            break;
+        case SEEK_CUR:
+            position = inputIO->prvPosition() + offset;
+            break;
+        case SEEK_END:
+            position = inputIO->m_FileSize + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+    if (position < 0 || position > inputIO->m_FileSize) {
+        return AVERROR(EINVAL);
+    }
+    return inputIO->prvSeek(position);
+}
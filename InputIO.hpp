@@ -0,0 +1,73 @@
+//
+//  InputIO.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef InputIO_hpp
+#define InputIO_hpp
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Foreward declarations
+struct AVIOContext;
+
+// How the input movie file is read
+enum class InputIOMode {
+    Ffmpeg,         // libavformat's own file I/O
+    Mmap,           // Copy from a memory map of the whole file
+    ReadAhead,      // A thread reads ahead into a large ring buffer
+    Stream          // Read front to back as data arrives, without seeking, as from a pipe
+};
+
+// The input path that means stdin
+const char* const cStdinFilepath = "-";
+
+// Feeds an input file to libavformat through a custom AVIOContext, and keeps track of how long
+// the demuxer waits for data. Set IOContext() as the format context's pb before opening it.
+class InputIO
+{
+public:
+    // Opens the file for a mode other than Ffmpeg. With Stream, the file can be a FIFO, or
+    // cStdinFilepath for stdin. On failure, reports why to stderr and returns nullptr.
+    static std::unique_ptr<InputIO> Open(const std::string &filepath, InputIOMode mode);
+    
+    virtual ~InputIO();
+    
+    InputIO(const InputIO&) = delete;
+    InputIO& operator=(const InputIO&) = delete;
+    
+    AVIOContext*    IOContext() const       { return m_IOContext; }
+    
+    // The time spent waiting for the file's data, in seconds. Call it on the thread that reads
+    // packets.
+    double          IOWaitSeconds() const   { return m_IOWaitSeconds; }
+
+protected:
+    InputIO();
+    
+    int             m_FD;
+    int64_t         m_FileSize;
+    double          m_IOWaitSeconds;
+    
+    // Called by libavformat through the AVIOContext. prvRead() returns the number of bytes
+    // read, or an AVERROR code such as AVERROR_EOF. prvSeek() moves to a position within the
+    // file, and returns it.
+    virtual bool    prvOpen(const std::string &filepath);
+    virtual bool    prvCanSeek() const { return true; }
+    virtual int     prvRead(uint8_t *buffer, int size) = 0;
+    virtual int64_t prvSeek(int64_t position) = 0;
+    virtual int64_t prvPosition() const = 0;
+
+private:
+    AVIOContext*    m_IOContext;
+    
+    static int      prvReadCallback(void *opaque, uint8_t *buffer, int size);
+    static int64_t  prvSeekCallback(void *opaque, int64_t offset, int whence);
+};
+
+#endif /* InputIO_hpp */
@@ -0,0 +1,150 @@
+//
+//  KeyframePipeline.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "KeyframePipeline.hpp"
+
+#include <cassert>
+#include <utility>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <libavutil/frame.h>
+
+#if defined(__cplusplus)
+}
+#endif
+
+
+KeyframePipeline::KeyframePipeline(AVStream *stream, AVCodecContext* codecContext, const std::vector<GridSize> &grids,
+                                   FrameDataSink *sink, const FrameProcessorOptions &processorOptions,
+                                   const PipelineOptions &pipelineOptions) :
+m_Sink(sink),
+m_WorkQueue(pipelineOptions.m_QueueDepth),
+m_NextSubmitSequence(0),
+m_Finished(false),
+m_NextReleaseSequence(0),
+m_InFlightCount(0),
+m_InFlightLimit(pipelineOptions.m_QueueDepth + pipelineOptions.m_WorkerCount)
+{
+    assert(m_Sink != nullptr);
+    assert(pipelineOptions.m_WorkerCount > 0);
+    assert(pipelineOptions.m_QueueDepth > 0);
+    
+    // Each worker gets its own frame processor, since they keep per-frame scratch buffers. They
+    // don't write results themselves; that's done here, in order.
+    for (int i = 0; i < pipelineOptions.m_WorkerCount; i++) {
+        m_Processors.emplace_back(new FrameProcessor(stream, codecContext, grids, nullptr,
+                                                     processorOptions));
+    }
+    for (int i = 0; i < pipelineOptions.m_WorkerCount; i++) {
+        FrameProcessor &frameProcessor = *m_Processors[i];
+        m_Workers.emplace_back([this, &frameProcessor]() {
+            prvWorkerLoop(frameProcessor);
+        });
+    }
+}
+
+KeyframePipeline::~KeyframePipeline()
+{
+    Finish();
+}
+
+
+void KeyframePipeline::SubmitKeyFrame(const AVFrame *frame)
+{
+    assert(!m_Finished);
+    
+    // Wait for room. This is what bounds memory: the frame references held here keep the
+    // decoder's buffers alive.
+    {
+        std::unique_lock<std::mutex> lock(m_ReorderMutex);
+        m_SlotReleased.wait(lock, [this]() { return m_InFlightCount < m_InFlightLimit; });
+        m_InFlightCount++;
+    }
+    
+    AVFrame *frameReference = av_frame_alloc();
+    assert(frameReference != nullptr);
+    int status = av_frame_ref(frameReference, frame);
+    assert(status >= 0);
+    (void)status;
+    
+    WorkItem item;
+    item.m_Sequence = m_NextSubmitSequence++;
+    item.m_Frame = frameReference;
+    m_WorkQueue.Push(item);
+}
+
+
+void KeyframePipeline::Finish()
+{
+    if (m_Finished) {
+        return;
+    }
+    m_Finished = true;
+    
+    // Each worker stops when it gets a null frame, after everything queued before it
+    for (size_t i = 0; i < m_Workers.size(); i++) {
+        WorkItem item;
+        item.m_Sequence = 0;
+        item.m_Frame = nullptr;
+        m_WorkQueue.Push(item);
+    }
+    for (std::thread &worker : m_Workers) {
+        worker.join();
+    }
+    
+    assert(m_PendingResults.empty());
+    assert(m_NextReleaseSequence == m_NextSubmitSequence);
+}
+
+
+void KeyframePipeline::prvWorkerLoop(FrameProcessor &frameProcessor)
+{
+    for (;;) {
+        WorkItem item;
+        m_WorkQueue.Pop(item);
+        if (item.m_Frame == nullptr) {
+            break;
+        }
+        
+        FrameData frameData;
+        frameProcessor.AnalyzeKeyFrame(item.m_Frame, frameData);
+        av_frame_free(&item.m_Frame);
+        
+        prvAddResult(item.m_Sequence, std::move(frameData));
+    }
+}
+
+
+// Holds a result until the ones before it have arrived, then writes it and any that were
+// waiting on it. Writing while holding the lock keeps the sink's calls in order.
+void KeyframePipeline::prvAddResult(size_t sequence, FrameData &&frameData)
+{
+    std::lock_guard<std::mutex> lock(m_ReorderMutex);
+    if (sequence != m_NextReleaseSequence) {
+        m_PendingResults.emplace(sequence, std::move(frameData));
+        return;
+    }
+    
+    m_Sink->WriteFrame(frameData);
+    size_t releasedCount = 1;
+    m_NextReleaseSequence++;
+    auto next = m_PendingResults.find(m_NextReleaseSequence);
+    while (next != m_PendingResults.end()) {
+        m_Sink->WriteFrame(next->second);
+        m_PendingResults.erase(next);
+        releasedCount++;
+        m_NextReleaseSequence++;
+        next = m_PendingResults.find(m_NextReleaseSequence);
+    }
+    
+    m_InFlightCount -= releasedCount;
+    m_SlotReleased.notify_all();
+}
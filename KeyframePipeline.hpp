@@ -0,0 +1,81 @@
+//
+//  KeyframePipeline.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef KeyframePipeline_hpp
+#define KeyframePipeline_hpp
+
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.hpp"
+#include "FrameData.hpp"
+#include "FrameProcessor.hpp"
+
+// Foreward declarations
+struct AVCodecContext;
+struct AVFrame;
+struct AVStream;
+
+struct PipelineOptions
+{
+    int     m_WorkerCount = 0;      // Zero analyzes keyframes on the decoding thread, with no pipeline
+    int     m_QueueDepth = 8;       // Keyframes waiting for a worker
+};
+
+// Analyzes keyframes on a pool of worker threads while the caller keeps decoding. Keyframes are
+// handed to the workers by reference, without copying their images, through a bounded queue, and
+// the workers' results are put back in submission order before going to the sink. The number of keyframes held at once
+// is capped at the queue depth plus the worker count, so a slow stage makes the decoder wait
+// rather than letting memory grow.
+class KeyframePipeline
+{
+public:
+    KeyframePipeline(AVStream *stream, AVCodecContext* codecContext, const std::vector<GridSize> &grids,
+                     FrameDataSink *sink, const FrameProcessorOptions &processorOptions,
+                     const PipelineOptions &pipelineOptions);
+    ~KeyframePipeline();
+    
+    // Queues a keyframe for analysis, waiting if too many are already held. The pipeline takes
+    // its own reference to the frame's buffers, so the caller can unref the frame afterward.
+    void SubmitKeyFrame(const AVFrame *frame);
+    
+    // Waits for every submitted keyframe to be analyzed and written, and stops the workers
+    void Finish();
+
+private:
+    struct WorkItem {
+        size_t      m_Sequence;
+        AVFrame*    m_Frame;        // Null tells a worker to stop
+    };
+    
+    FrameDataSink*              m_Sink;
+    BoundedQueue<WorkItem>      m_WorkQueue;
+    std::vector<std::unique_ptr<FrameProcessor>> m_Processors;
+    std::vector<std::thread>    m_Workers;
+    size_t                      m_NextSubmitSequence;
+    bool                        m_Finished;
+    
+    // Reordering: results that arrive before earlier ones are held until they can be written in
+    // order. m_InFlightCount is the number of keyframes submitted but not yet written.
+    std::mutex                  m_ReorderMutex;
+    std::condition_variable     m_SlotReleased;
+    std::map<size_t, FrameData> m_PendingResults;
+    size_t                      m_NextReleaseSequence;
+    size_t                      m_InFlightCount;
+    size_t                      m_InFlightLimit;
+    
+    void prvWorkerLoop(FrameProcessor &frameProcessor);
+    void prvAddResult(size_t sequence, FrameData &&frameData);
+};
+
+#endif /* KeyframePipeline_hpp */
@@ -0,0 +1,61 @@
+//
+//  MedianFile.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef MedianFile_hpp
+#define MedianFile_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+// A median file holds a movie's results in a form that can be memory-mapped and read in place:
+//
+//   Offset 0:                  MedianFileHeader
+//   m_MatrixOffset (4096):     The median matrix: m_FrameCount rows of m_GridRows * m_GridCols
+//                              uint8_t medians, one row per keyframe, each row's cells in
+//                              grid row order, left to right
+//   m_TimestampOffset:         The timestamp column: m_FrameCount doubles, each keyframe's time
+//                              in seconds from the start of the stream, aligned to 64 bytes
+//
+// Numbers are stored little-endian, which is the byte order of every Mac. The matrix is written
+// as the keyframes are analyzed, and the timestamps and counts when the file is finished; until
+// then m_TimestampOffset is 0, and readers treat the file as incomplete.
+
+const char      cMedianFileMagic[8] = {'M', 'E', 'D', 'I', 'A', 'N', 'S', '\0'};
+const uint32_t  cMedianFileVersion = 1;
+const uint64_t  cMedianFileMatrixOffset = 4096;     // A page boundary, so mapped rows are aligned
+const uint64_t  cMedianFileColumnAlignment = 64;
+
+struct MedianFileHeader
+{
+    char        m_Magic[8];
+    uint32_t    m_Version;
+    uint32_t    m_HeaderSize;           // sizeof(MedianFileHeader) when written
+    
+    // The grid, and where the data is
+    uint32_t    m_GridRows;
+    uint32_t    m_GridCols;
+    uint64_t    m_FrameCount;
+    uint64_t    m_MatrixOffset;
+    uint64_t    m_TimestampOffset;
+    
+    // The video stream the results came from
+    int32_t     m_TimeBaseNum;          // The stream's time base, in seconds
+    int32_t     m_TimeBaseDen;
+    int64_t     m_StreamStartTime;      // In the time base; timestamps are relative to this
+    int32_t     m_StreamIndex;
+    int32_t     m_SourceWidth;
+    int32_t     m_SourceHeight;
+    int32_t     m_Reserved;
+    char        m_CodecName[32];        // Null-terminated, and truncated if need be
+    char        m_SourcePath[1024];
+};
+
+static_assert(sizeof(MedianFileHeader) == 1136, "The median file header's layout has changed");
+static_assert(sizeof(MedianFileHeader) <= cMedianFileMatrixOffset, "The median file header is too big");
+
+#endif /* MedianFile_hpp */
@@ -0,0 +1,141 @@
+//
+//  MedianFileReader.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "MedianFileReader.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+MedianFileReader::MedianFileReader() :
+m_Mapping(nullptr),
+m_MappingSize(0),
+m_Header(nullptr),
+m_Matrix(nullptr),
+m_Timestamps(nullptr),
+m_FrameCount(0),
+m_CellCount(0)
+{
+}
+
+MedianFileReader::~MedianFileReader()
+{
+    if (m_Mapping) {
+        munmap(m_Mapping, m_MappingSize);
+    }
+}
+
+
+bool MedianFileReader::Open(const std::string &filepath)
+{
+    assert(m_Mapping == nullptr);
+    m_Filepath = filepath;
+    
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return prvFail("can't be opened");
+    }
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0 || (uint64_t)statbuf.st_size < cMedianFileMatrixOffset) {
+        close(fd);
+        return prvFail("is too short to be a median file");
+    }
+    m_MappingSize = (size_t)statbuf.st_size;
+    void *mapping = mmap(nullptr, m_MappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);                                  // The mapping keeps the file open
+    if (mapping == MAP_FAILED) {
+        return prvFail("can't be mapped");
+    }
+    m_Mapping = mapping;
+    m_Header = (const MedianFileHeader *)m_Mapping;
+    
+    // Check the header
+    const MedianFileHeader &header = *m_Header;
+    if (memcmp(header.m_Magic, cMedianFileMagic, sizeof(header.m_Magic)) != 0) {
+        return prvFail("isn't a median file");
+    }
+    if (header.m_Version != cMedianFileVersion || header.m_HeaderSize != sizeof(MedianFileHeader)) {
+        return prvFail("is a median file version this program can't read");
+    }
+    if (header.m_TimestampOffset == 0) {
+        return prvFail("is incomplete; the run that wrote it didn't finish");
+    }
+    if (header.m_GridRows == 0 || header.m_GridCols == 0 || header.m_MatrixOffset < sizeof(MedianFileHeader)) {
+        return prvFail("has a damaged header");
+    }
+    
+    // Make sure the matrix and timestamp column are inside the file. Each check bounds the
+    // values the next one multiplies, so none of them can overflow.
+    m_FrameCount = (size_t)header.m_FrameCount;
+    m_CellCount = (size_t)header.m_GridRows * (size_t)header.m_GridCols;
+    uint64_t fileSize = m_MappingSize;
+    bool fits = header.m_MatrixOffset <= fileSize
+                && header.m_FrameCount <= (fileSize - header.m_MatrixOffset) / m_CellCount
+                && header.m_TimestampOffset >= header.m_MatrixOffset + header.m_FrameCount * m_CellCount
+                && header.m_TimestampOffset % sizeof(double) == 0
+                && header.m_TimestampOffset <= fileSize
+                && header.m_FrameCount <= (fileSize - header.m_TimestampOffset) / sizeof(double);
+    if (!fits) {
+        return prvFail("is shorter than its header says");
+    }
+    m_Matrix = (const uint8_t *)m_Mapping + header.m_MatrixOffset;
+    m_Timestamps = (const double *)((const uint8_t *)m_Mapping + header.m_TimestampOffset);
+    
+    // Most queries scan the matrix from front to back
+    madvise(m_Mapping, m_MappingSize, MADV_SEQUENTIAL);
+    return true;
+}
+
+
+size_t MedianFileReader::LowerBound(double timestamp) const
+{
+    return std::lower_bound(m_Timestamps, m_Timestamps + m_FrameCount, timestamp) - m_Timestamps;
+}
+
+size_t MedianFileReader::UpperBound(double timestamp) const
+{
+    return std::upper_bound(m_Timestamps, m_Timestamps + m_FrameCount, timestamp) - m_Timestamps;
+}
+
+size_t MedianFileReader::Nearest(double timestamp) const
+{
+    assert(m_FrameCount > 0);
+    size_t after = LowerBound(timestamp);
+    if (after == 0) {
+        return 0;
+    }
+    if (after == m_FrameCount) {
+        return m_FrameCount - 1;
+    }
+    size_t before = after - 1;
+    return (timestamp - m_Timestamps[before] <= m_Timestamps[after] - timestamp) ? before : after;
+}
+
+
+// Reports why the file can't be read, and unmaps it
+bool MedianFileReader::prvFail(const char *reason)
+{
+    fprintf(stderr, "\"%s\" %s\n", m_Filepath.c_str(), reason);
+    if (m_Mapping) {
+        munmap(m_Mapping, m_MappingSize);
+    }
+    m_Mapping = nullptr;
+    m_MappingSize = 0;
+    m_Header = nullptr;
+    m_Matrix = nullptr;
+    m_Timestamps = nullptr;
+    m_FrameCount = 0;
+    m_CellCount = 0;
+    return false;
+}
@@ -0,0 +1,65 @@
+//
+//  MedianFileReader.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef MedianFileReader_hpp
+#define MedianFileReader_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "MedianFile.hpp"
+
+// Memory-maps a finished median file (see MedianFile.hpp) read-only, and gives access to its
+// matrix and timestamp column in place. Nothing is copied; pages are read in as they're touched.
+class MedianFileReader
+{
+public:
+    MedianFileReader();
+    ~MedianFileReader();
+    
+    // Maps the file, and checks that its header is one this code understands and that the file
+    // is complete and as long as the header says. On failure, reports why to stderr and returns
+    // false.
+    bool Open(const std::string &filepath);
+    
+    const std::string&          Filepath() const        { return m_Filepath; }
+    const MedianFileHeader&     Header() const          { return *m_Header; }
+    size_t                      FrameCount() const      { return m_FrameCount; }
+    size_t                      CellCount() const       { return m_CellCount; }
+    
+    // A keyframe's medians: CellCount() bytes, in grid row order, left to right
+    const uint8_t* Row(size_t frameIndex) const         { return m_Matrix + frameIndex * m_CellCount; }
+    
+    // FrameCount() timestamps, in seconds, in increasing order
+    const double* Timestamps() const                    { return m_Timestamps; }
+    
+    // Returns the index of the first keyframe at or after a time; FrameCount() if there is none
+    size_t LowerBound(double timestamp) const;
+    
+    // Returns the index of the first keyframe after a time; FrameCount() if there is none
+    size_t UpperBound(double timestamp) const;
+    
+    // Returns the index of the keyframe whose time is nearest to a time; the earlier one on a
+    // tie. The file must have at least one keyframe.
+    size_t Nearest(double timestamp) const;
+
+private:
+    std::string             m_Filepath;
+    void*                   m_Mapping;
+    size_t                  m_MappingSize;
+    const MedianFileHeader* m_Header;
+    const uint8_t*          m_Matrix;
+    const double*           m_Timestamps;
+    size_t                  m_FrameCount;
+    size_t                  m_CellCount;
+    
+    bool prvFail(const char *reason);
+};
+
+#endif /* MedianFileReader_hpp */
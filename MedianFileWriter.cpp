@@ -0,0 +1,118 @@
+//
+//  MedianFileWriter.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "MedianFileWriter.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+// The file is written through a buffer this big
+static const size_t cWriteBufferSize = 4 * 1024 * 1024;
+
+
+MedianFileWriter::MedianFileWriter() :
+m_File(nullptr),
+m_CellCount(0),
+m_WriteFailed(false)
+{
+    memset(&m_Header, 0, sizeof(m_Header));
+}
+
+MedianFileWriter::~MedianFileWriter()
+{
+    if (m_File) {
+        fclose(m_File);
+    }
+}
+
+
+bool MedianFileWriter::Open(const std::string &filepath, const MedianFileHeader &sourceHeader)
+{
+    assert(m_File == nullptr);
+    m_File = fopen(filepath.c_str(), "wb");
+    if (m_File == NULL) {
+        fprintf(stderr, "Can't write output file at \"%s\"\n", filepath.c_str());
+        return false;
+    }
+    setvbuf(m_File, NULL, _IOFBF, cWriteBufferSize);
+    
+    m_Header = sourceHeader;
+    memcpy(m_Header.m_Magic, cMedianFileMagic, sizeof(m_Header.m_Magic));
+    m_Header.m_Version = cMedianFileVersion;
+    m_Header.m_HeaderSize = sizeof(MedianFileHeader);
+    m_Header.m_FrameCount = 0;
+    m_Header.m_MatrixOffset = cMedianFileMatrixOffset;
+    m_Header.m_TimestampOffset = 0;         // Marks the file as incomplete until Finish()
+    m_CellCount = (size_t)m_Header.m_GridRows * (size_t)m_Header.m_GridCols;
+    m_Row.resize(m_CellCount);
+    
+    // Write the header as it stands, then pad out to the matrix
+    m_WriteFailed = (fwrite(&m_Header, sizeof(m_Header), 1, m_File) != 1) || !prvPadTo(m_Header.m_MatrixOffset);
+    return true;
+}
+
+
+void MedianFileWriter::WriteFrame(const FrameData &frameData)
+{
+    assert(m_File != nullptr);
+    assert(frameData.m_CellGrayMedians.size() == m_CellCount);
+    for (size_t i = 0; i < m_CellCount; i++) {
+        assert(frameData.m_CellGrayMedians[i] >= 0 && frameData.m_CellGrayMedians[i] <= 255);
+        m_Row[i] = (uint8_t)frameData.m_CellGrayMedians[i];
+    }
+    m_WriteFailed = m_WriteFailed || (fwrite(m_Row.data(), 1, m_CellCount, m_File) != m_CellCount);
+    m_Timestamps.push_back(frameData.m_Timestamp);
+}
+
+
+bool MedianFileWriter::Finish()
+{
+    assert(m_File != nullptr);
+    
+    // Append the timestamp column
+    uint64_t matrixEnd = m_Header.m_MatrixOffset + m_Timestamps.size() * m_CellCount;
+    uint64_t timestampOffset = (matrixEnd + cMedianFileColumnAlignment - 1) / cMedianFileColumnAlignment
+                               * cMedianFileColumnAlignment;
+    m_WriteFailed = m_WriteFailed || !prvPadTo(timestampOffset);
+    if (!m_Timestamps.empty()) {
+        size_t writtenCount = fwrite(m_Timestamps.data(), sizeof(double), m_Timestamps.size(), m_File);
+        m_WriteFailed = m_WriteFailed || (writtenCount != m_Timestamps.size());
+    }
+    
+    // Complete the header
+    m_Header.m_FrameCount = m_Timestamps.size();
+    m_Header.m_TimestampOffset = timestampOffset;
+    m_WriteFailed = m_WriteFailed || (fseeko(m_File, 0, SEEK_SET) != 0);
+    m_WriteFailed = m_WriteFailed || (fwrite(&m_Header, sizeof(m_Header), 1, m_File) != 1);
+    
+    m_WriteFailed = m_WriteFailed || (fclose(m_File) != 0);
+    m_File = nullptr;
+    return !m_WriteFailed;
+}
+
+
+// Writes zeros up to an offset, which must be at or after the current position
+bool MedianFileWriter::prvPadTo(uint64_t offset)
+{
+    off_t position = ftello(m_File);
+    if (position < 0 || (uint64_t)position > offset) {
+        return false;
+    }
+    
+    static const char sZeros[cMedianFileColumnAlignment] = {};
+    uint64_t padding = offset - position;
+    while (padding > 0) {
+        size_t chunkSize = (size_t)std::min<uint64_t>(padding, sizeof(sZeros));
+        if (fwrite(sZeros, 1, chunkSize, m_File) != chunkSize) {
+            return false;
+        }
+        padding -= chunkSize;
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+//
+//  MedianFileWriter.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef MedianFileWriter_hpp
+#define MedianFileWriter_hpp
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "FrameData.hpp"
+#include "MedianFile.hpp"
+
+// Writes results as a median file (see MedianFile.hpp). Each keyframe's medians are appended to
+// the matrix as they arrive; the timestamp column and the final header are written by Finish().
+class MedianFileWriter : public FrameDataSink
+{
+public:
+    MedianFileWriter();
+    ~MedianFileWriter();
+    
+    // Creates the file, and reserves room for the header. The header's grid and source fields
+    // are taken from sourceHeader; the rest are filled in here. On failure, reports why to
+    // stderr and returns false.
+    bool Open(const std::string &filepath, const MedianFileHeader &sourceHeader);
+    
+    void WriteFrame(const FrameData &frameData) override;
+    bool Finish() override;
+
+private:
+    FILE*               m_File;
+    MedianFileHeader    m_Header;
+    size_t              m_CellCount;
+    std::vector<uint8_t> m_Row;             // Scratch space for one frame's medians
+    std::vector<double> m_Timestamps;       // 8 bytes per keyframe, written at the end
+    bool                m_WriteFailed;
+    
+    bool prvPadTo(uint64_t offset);
+};
+
+#endif /* MedianFileWriter_hpp */
@@ -0,0 +1,73 @@
+//
+//  MedianGridAnalyzer.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "MedianGridAnalyzer.hpp"
+
+#include <cassert>
+
+
+MedianGridAnalyzer::MedianGridAnalyzer(const std::vector<GridSize> &grids, FrameDataSink *sink,
+                                       const FrameProcessorOptions &processorOptions,
+                                       const PipelineOptions &pipelineOptions,
+                                       double deadlineSeconds, DeadlineStats *deadlineStats,
+                                       DeadlineMode deadlineMode) :
+m_Grids(grids),
+m_Sink(sink),
+m_ProcessorOptions(processorOptions),
+m_PipelineOptions(pipelineOptions),
+m_DeadlineSeconds(deadlineSeconds),
+m_DeadlineStats(deadlineStats),
+m_DeadlineMode(deadlineMode)
+{
+    assert(m_Sink != nullptr);
+    assert(m_DeadlineSeconds <= 0.0 || m_PipelineOptions.m_WorkerCount == 0);
+}
+
+
+bool MedianGridAnalyzer::BeginStream(AVStream *stream, AVCodecContext *codecContext)
+{
+    assert(!m_FrameProcessor && !m_Pipeline);
+    if (m_PipelineOptions.m_WorkerCount > 0) {
+        m_Pipeline.reset(new KeyframePipeline(stream, codecContext, m_Grids, m_Sink,
+                                              m_ProcessorOptions, m_PipelineOptions));
+    }
+    else {
+        m_FrameProcessor.reset(new FrameProcessor(stream, codecContext, m_Grids, m_Sink, m_ProcessorOptions));
+        if (m_DeadlineSeconds > 0.0) {
+            m_DeadlineScheduler.reset(new DeadlineScheduler(m_DeadlineSeconds, stream, codecContext, m_DeadlineMode));
+        }
+    }
+    return true;
+}
+
+
+void MedianGridAnalyzer::ProcessKeyFrame(const AVFrame *keyframe)
+{
+    if (m_Pipeline) {
+        m_Pipeline->SubmitKeyFrame(keyframe);
+    }
+    else if (m_DeadlineScheduler) {
+        m_DeadlineScheduler->ProcessKeyFrame(*m_FrameProcessor, keyframe, m_Sink);
+    }
+    else {
+        assert(m_FrameProcessor);
+        m_FrameProcessor->ProcessKeyFrame(keyframe);
+    }
+}
+
+
+bool MedianGridAnalyzer::EndStream()
+{
+    if (m_Pipeline) {
+        m_Pipeline->Finish();
+    }
+    if (m_DeadlineScheduler && m_DeadlineStats != nullptr) {
+        m_DeadlineScheduler->AddStats(*m_DeadlineStats);
+    }
+    return true;
+}
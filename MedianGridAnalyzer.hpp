@@ -0,0 +1,52 @@
+//
+//  MedianGridAnalyzer.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef MedianGridAnalyzer_hpp
+#define MedianGridAnalyzer_hpp
+
+#include <memory>
+#include <vector>
+
+#include "DeadlineScheduler.hpp"
+#include "FrameAnalyzer.hpp"
+#include "FrameData.hpp"
+#include "FrameProcessor.hpp"
+#include "KeyframePipeline.hpp"
+
+// Finds the gray medians of each keyframe's grid cells, and writes them to a sink. Keyframes are
+// analyzed as they arrive, or on a pipeline of workers if the pipeline options ask for any. With
+// a deadline, in seconds, they're analyzed as they arrive by a DeadlineScheduler, which adds
+// what it did to the stats, if given, when the stream ends, and picks each keyframe's mode as
+// the deadline mode says; that can't be used with workers.
+class MedianGridAnalyzer : public FrameAnalyzer
+{
+public:
+    MedianGridAnalyzer(const std::vector<GridSize> &grids, FrameDataSink *sink,
+                       const FrameProcessorOptions &processorOptions, const PipelineOptions &pipelineOptions,
+                       double deadlineSeconds = 0.0, DeadlineStats *deadlineStats = nullptr,
+                       DeadlineMode deadlineMode = DeadlineMode::Auto);
+    
+    bool BeginStream(AVStream *stream, AVCodecContext *codecContext) override;
+    void ProcessKeyFrame(const AVFrame *keyframe) override;
+    bool EndStream() override;
+
+private:
+    std::vector<GridSize>   m_Grids;
+    FrameDataSink*          m_Sink;
+    FrameProcessorOptions   m_ProcessorOptions;
+    PipelineOptions         m_PipelineOptions;
+    double                  m_DeadlineSeconds;
+    DeadlineStats*          m_DeadlineStats;
+    DeadlineMode            m_DeadlineMode;
+    
+    std::unique_ptr<FrameProcessor>     m_FrameProcessor;   // One or the other, once the stream begins
+    std::unique_ptr<KeyframePipeline>   m_Pipeline;
+    std::unique_ptr<DeadlineScheduler>  m_DeadlineScheduler;    // Runs m_FrameProcessor, if there's a deadline
+};
+
+#endif /* MedianGridAnalyzer_hpp */
@@ -0,0 +1,85 @@
+//
+//  MedianQuery.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "MedianQuery.hpp"
+#include "MedianFileReader.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+// SSE2 is part of every x86-64 CPU, so unlike the histogram kernels these don't need to check
+// for it at run time
+#if defined(__SSE2__)
+#define MEDIAN_QUERY_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+void FindFramesAbove(const MedianFileReader &reader, size_t cell, uint8_t threshold,
+                     size_t firstFrame, size_t endFrame, std::vector<size_t> &frames)
+{
+    assert(cell < reader.CellCount());
+    assert(firstFrame <= endFrame && endFrame <= reader.FrameCount());
+    const size_t cellCount = reader.CellCount();
+    const uint8_t *column = reader.Row(0) + cell;
+    size_t frame = firstFrame;
+
+#if MEDIAN_QUERY_SSE2
+    // A cell's medians are a row apart, so gather 16 of them, and compare them all at once.
+    // SSE2 only compares signed bytes, so flip the top bits to keep unsigned order.
+    const __m128i cSignBits = _mm_set1_epi8((char)0x80);
+    const __m128i limit = _mm_set1_epi8((char)(threshold ^ 0x80));
+    alignas(16) uint8_t block[16];
+    for ( ; frame + 16 <= endFrame; frame += 16) {
+        const uint8_t *p = column + frame * cellCount;
+        for (int i = 0; i < 16; i++) {
+            block[i] = p[i * cellCount];
+        }
+        __m128i values = _mm_xor_si128(_mm_load_si128((const __m128i *)block), cSignBits);
+        unsigned int aboveMask = (unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(values, limit));
+        while (aboveMask != 0) {
+            frames.push_back(frame + __builtin_ctz(aboveMask));
+            aboveMask &= aboveMask - 1;
+        }
+    }
+#endif
+
+    for ( ; frame < endFrame; frame++) {
+        if (column[frame * cellCount] > threshold) {
+            frames.push_back(frame);
+        }
+    }
+}
+
+
+void AccumulateCellMinMax(const MedianFileReader &reader, size_t firstFrame, size_t endFrame,
+                          uint8_t *mins, uint8_t *maxes)
+{
+    assert(firstFrame <= endFrame && endFrame <= reader.FrameCount());
+    const size_t cellCount = reader.CellCount();
+    
+    // Go through the rows in file order, folding each into the running mins and maxes, which
+    // stay in cache
+    for (size_t frame = firstFrame; frame < endFrame; frame++) {
+        const uint8_t *row = reader.Row(frame);
+        size_t cell = 0;
+#if MEDIAN_QUERY_SSE2
+        for ( ; cell + 16 <= cellCount; cell += 16) {
+            __m128i values = _mm_loadu_si128((const __m128i *)(row + cell));
+            __m128i *minBlock = (__m128i *)(mins + cell);
+            __m128i *maxBlock = (__m128i *)(maxes + cell);
+            _mm_storeu_si128(minBlock, _mm_min_epu8(_mm_loadu_si128(minBlock), values));
+            _mm_storeu_si128(maxBlock, _mm_max_epu8(_mm_loadu_si128(maxBlock), values));
+        }
+#endif
+        for ( ; cell < cellCount; cell++) {
+            mins[cell] = std::min(mins[cell], row[cell]);
+            maxes[cell] = std::max(maxes[cell], row[cell]);
+        }
+    }
+}
@@ -0,0 +1,31 @@
+//
+//  MedianQuery.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef MedianQuery_hpp
+#define MedianQuery_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Foreward declarations
+class MedianFileReader;
+
+// Scans over a mapped median file's matrix, for median_query. Each works on the keyframes
+// [firstFrame, endFrame), and uses SSE2 where it's available.
+
+// Appends the index of each keyframe whose median for a cell is greater than a threshold
+void FindFramesAbove(const MedianFileReader &reader, size_t cell, uint8_t threshold,
+                     size_t firstFrame, size_t endFrame, std::vector<size_t> &frames);
+
+// Lowers each cell's entry in mins, and raises its entry in maxes, to take in the keyframes'
+// medians. Both have CellCount() entries; start them at 255 and 0.
+void AccumulateCellMinMax(const MedianFileReader &reader, size_t firstFrame, size_t endFrame,
+                          uint8_t *mins, uint8_t *maxes);
+
+#endif /* MedianQuery_hpp */
@@ -0,0 +1,81 @@
+//
+//  MedianRing.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef MedianRing_hpp
+#define MedianRing_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "MedianFile.hpp"
+
+// A median ring is a POSIX shared memory object that sample_p publishes each keyframe's results
+// to as they're found, so programs on the same host can read them in place, without a system call
+// per keyframe:
+//
+//   Offset 0:                  MedianRingHeader
+//   m_SlotOffset (4096):       m_SlotCount slots, m_SlotSize bytes apart. Each is a MedianRingSlot,
+//                              followed by m_GridRows * m_GridCols uint8_t medians in grid row
+//                              order, left to right.
+//
+// Keyframes are numbered from 1 as they're published, and keyframe n goes in slot
+// (n - 1) % m_SlotCount, replacing keyframe n - m_SlotCount. There's one writer, which never waits
+// for readers; any number of readers can follow it, and one that falls more than m_SlotCount
+// keyframes behind finds the ones it missed have been overwritten. A slot's sequence number is
+// 2n - 1 while keyframe n is written into it, and 2n once it's complete, so a reader checks it
+// before and after reading a slot to know the slot held the keyframe throughout.
+
+const char      cMedianRingMagic[8] = {'M', 'E', 'D', 'R', 'I', 'N', 'G', '\0'};
+const uint32_t  cMedianRingVersion = 1;
+const uint64_t  cMedianRingSlotOffset = 4096;
+const uint32_t  cMedianRingSlotAlignment = 64;      // A cache line, so slots don't share one
+const uint32_t  cMedianRingDefaultSlotCount = 256;
+
+// Shared memory names start with a slash, and macOS limits them to this many characters
+const size_t    cMedianRingMaxNameLength = 31;
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "A median ring's counters must be lock-free to be shared between processes");
+
+struct MedianRingHeader
+{
+    char        m_Magic[8];
+    uint32_t    m_Version;
+    uint32_t    m_HeaderSize;           // sizeof(MedianRingHeader) when written
+    uint32_t    m_SlotCount;
+    uint32_t    m_SlotSize;
+    uint64_t    m_SlotOffset;
+    
+    // The grid and where the results came from, as a median file describes them. Its frame count
+    // and offsets aren't used.
+    MedianFileHeader m_Source;
+    
+    // Changed while the writer runs. Readers poll these, so they're kept off the lines above.
+    alignas(64) std::atomic<uint32_t> m_Ready;      // Nonzero once the fields above are filled in
+    alignas(64) std::atomic<uint64_t> m_PublishedCount;
+    std::atomic<uint32_t> m_Finished;               // Nonzero once the last keyframe is published
+};
+
+struct MedianRingSlot
+{
+    std::atomic<uint64_t> m_Sequence;   // 0 until the slot is first written
+    double      m_Timestamp;            // Seconds from the start of the stream
+};
+
+static_assert(sizeof(MedianRingHeader) <= cMedianRingSlotOffset, "The median ring header is too big");
+static_assert(sizeof(MedianRingSlot) == 16, "The median ring slot's layout has changed");
+
+// The shared memory name for a ring, which is given with or without its leading slash
+inline std::string MedianRingShmName(const std::string &ringName)
+{
+    return (!ringName.empty() && ringName[0] == '/') ? ringName : "/" + ringName;
+}
+
+#endif /* MedianRing_hpp */
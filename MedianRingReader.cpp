@@ -0,0 +1,177 @@
+//
+//  MedianRingReader.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "MedianRingReader.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+// WaitFor() spins this many times, then yields this many more, then sleeps between checks
+static const int cWaitSpinCount = 64;
+static const int cWaitYieldCount = 128;
+static const std::chrono::microseconds cWaitSleepTime(100);
+
+
+MedianRingReader::MedianRingReader() :
+m_Mapping(nullptr),
+m_MappingSize(0),
+m_Header(nullptr),
+m_CellCount(0)
+{
+}
+
+MedianRingReader::~MedianRingReader()
+{
+    if (m_Mapping) {
+        munmap(m_Mapping, m_MappingSize);
+    }
+}
+
+
+bool MedianRingReader::Open(const std::string &ringName)
+{
+    assert(m_Mapping == nullptr);
+    m_Name = MedianRingShmName(ringName);
+    
+    int fd = shm_open(m_Name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return prvFail("doesn't exist");
+    }
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) != 0 || (uint64_t)statbuf.st_size < cMedianRingSlotOffset) {
+        close(fd);
+        return prvFail("is too short to be a median ring");
+    }
+    m_MappingSize = (size_t)statbuf.st_size;
+    void *mapping = mmap(nullptr, m_MappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);                                  // The mapping keeps the object open
+    if (mapping == MAP_FAILED) {
+        return prvFail("can't be mapped");
+    }
+    m_Mapping = mapping;
+    m_Header = (const MedianRingHeader *)m_Mapping;
+    
+    // Check the header
+    const MedianRingHeader &header = *m_Header;
+    if (header.m_Ready.load(std::memory_order_acquire) == 0) {
+        return prvFail("isn't ready yet");
+    }
+    if (memcmp(header.m_Magic, cMedianRingMagic, sizeof(header.m_Magic)) != 0) {
+        return prvFail("isn't a median ring");
+    }
+    if (header.m_Version != cMedianRingVersion || header.m_HeaderSize != sizeof(MedianRingHeader)) {
+        return prvFail("is a median ring version this program can't read");
+    }
+    m_CellCount = (size_t)header.m_Source.m_GridRows * (size_t)header.m_Source.m_GridCols;
+    bool fits = m_CellCount > 0 && header.m_SlotCount > 0
+                && header.m_SlotSize >= sizeof(MedianRingSlot) + m_CellCount
+                && header.m_SlotSize % cMedianRingSlotAlignment == 0
+                && header.m_SlotOffset >= sizeof(MedianRingHeader)
+                && header.m_SlotOffset <= m_MappingSize
+                && header.m_SlotCount <= (m_MappingSize - header.m_SlotOffset) / header.m_SlotSize;
+    if (!fits) {
+        return prvFail("has a damaged header");
+    }
+    return true;
+}
+
+
+uint64_t MedianRingReader::OldestAvailable() const
+{
+    uint64_t publishedCount = PublishedCount();
+    return (publishedCount > m_Header->m_SlotCount) ? publishedCount - m_Header->m_SlotCount + 1 : 1;
+}
+
+
+bool MedianRingReader::WaitFor(uint64_t number) const
+{
+    for (int waitCount = 0; PublishedCount() < number; waitCount++) {
+        if (IsFinished()) {
+            return PublishedCount() >= number;      // The last keyframes may have come just before
+        }
+        if (waitCount < cWaitSpinCount) {
+            continue;
+        }
+        else if (waitCount < cWaitSpinCount + cWaitYieldCount) {
+            std::this_thread::yield();
+        }
+        else {
+            std::this_thread::sleep_for(cWaitSleepTime);
+        }
+    }
+    return true;
+}
+
+
+MedianRingReader::ReadStatus MedianRingReader::Peek(uint64_t number, Frame &frame) const
+{
+    assert(number > 0);
+    const MedianRingSlot *slot = prvSlot(number);
+    uint64_t sequence = slot->m_Sequence.load(std::memory_order_acquire);
+    if (sequence < 2 * number) {            // Still being written, or holding an older keyframe
+        return ReadStatus::NotYet;
+    }
+    if (sequence > 2 * number) {
+        return ReadStatus::Overwritten;
+    }
+    frame.m_Number = number;
+    frame.m_Timestamp = slot->m_Timestamp;
+    frame.m_Medians = (const uint8_t *)slot + sizeof(MedianRingSlot);
+    return ReadStatus::Ready;
+}
+
+
+bool MedianRingReader::StillValid(const Frame &frame) const
+{
+    // Keep the reads of the slot from moving after the check
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return prvSlot(frame.m_Number)->m_Sequence.load(std::memory_order_relaxed) == 2 * frame.m_Number;
+}
+
+
+MedianRingReader::ReadStatus MedianRingReader::Read(uint64_t number, FrameData &frameData) const
+{
+    Frame frame;
+    ReadStatus status = Peek(number, frame);
+    if (status != ReadStatus::Ready) {
+        return status;
+    }
+    frameData.m_Timestamp = frame.m_Timestamp;
+    frameData.m_CellGrayMedians.assign(frame.m_Medians, frame.m_Medians + m_CellCount);
+    return StillValid(frame) ? ReadStatus::Ready : ReadStatus::Overwritten;
+}
+
+
+const MedianRingSlot* MedianRingReader::prvSlot(uint64_t number) const
+{
+    size_t slotIndex = (size_t)((number - 1) % m_Header->m_SlotCount);
+    return (const MedianRingSlot *)((const uint8_t *)m_Mapping + m_Header->m_SlotOffset +
+                                    slotIndex * m_Header->m_SlotSize);
+}
+
+
+// Reports why the ring can't be read, and unmaps it
+bool MedianRingReader::prvFail(const char *reason)
+{
+    fprintf(stderr, "Median ring \"%s\" %s\n", m_Name.c_str(), reason);
+    if (m_Mapping) {
+        munmap(m_Mapping, m_MappingSize);
+    }
+    m_Mapping = nullptr;
+    m_MappingSize = 0;
+    m_Header = nullptr;
+    m_CellCount = 0;
+    return false;
+}
@@ -0,0 +1,80 @@
+//
+//  MedianRingReader.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef MedianRingReader_hpp
+#define MedianRingReader_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "FrameData.hpp"
+#include "MedianRing.hpp"
+
+// Maps a median ring (see MedianRing.hpp) read-only, and follows the keyframes its writer
+// publishes. Keyframes can be read in place, or copied out. Nothing here makes a system call,
+// except WaitFor() when it has waited a while.
+class MedianRingReader
+{
+public:
+    enum class ReadStatus {
+        Ready,
+        NotYet,             // The keyframe hasn't been published yet
+        Overwritten         // The keyframe was replaced before it could be read
+    };
+    
+    // A keyframe's results, in place in the ring
+    struct Frame
+    {
+        uint64_t        m_Number;
+        double          m_Timestamp;
+        const uint8_t*  m_Medians;      // CellCount() medians, in grid row order, left to right
+    };
+    
+    MedianRingReader();
+    ~MedianRingReader();
+    
+    // Maps the ring, and checks that its header is one this code understands. On failure,
+    // reports why to stderr and returns false.
+    bool Open(const std::string &ringName);
+    
+    const MedianRingHeader& Header() const  { return *m_Header; }
+    size_t      CellCount() const           { return m_CellCount; }
+    
+    uint64_t    PublishedCount() const      { return m_Header->m_PublishedCount.load(std::memory_order_acquire); }
+    bool        IsFinished() const          { return m_Header->m_Finished.load(std::memory_order_acquire) != 0; }
+    
+    // The number of the oldest keyframe still in the ring, or of the next to be published if
+    // there are none yet
+    uint64_t    OldestAvailable() const;
+    
+    // Waits until a keyframe has been published, spinning briefly, then yielding, then sleeping.
+    // Returns false if the writer finished without publishing it.
+    bool        WaitFor(uint64_t number) const;
+    
+    // Finds a keyframe in the ring without copying it. The writer may overwrite it at any time,
+    // so once its timestamp and medians have been used, StillValid() must be called to make sure
+    // they were the keyframe's throughout.
+    ReadStatus  Peek(uint64_t number, Frame &frame) const;
+    bool        StillValid(const Frame &frame) const;
+    
+    // Copies a keyframe's results out of the ring
+    ReadStatus  Read(uint64_t number, FrameData &frameData) const;
+
+private:
+    std::string             m_Name;
+    void*                   m_Mapping;
+    size_t                  m_MappingSize;
+    const MedianRingHeader* m_Header;
+    size_t                  m_CellCount;
+    
+    const MedianRingSlot*   prvSlot(uint64_t number) const;
+    bool                    prvFail(const char *reason);
+};
+
+#endif /* MedianRingReader_hpp */
@@ -0,0 +1,121 @@
+//
+//  MedianRingWriter.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "MedianRingWriter.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+MedianRingWriter::MedianRingWriter() :
+m_Ring(nullptr),
+m_Size(0),
+m_Header(nullptr),
+m_CellCount(0),
+m_PublishedCount(0)
+{
+}
+
+MedianRingWriter::~MedianRingWriter()
+{
+    prvClose();
+}
+
+
+bool MedianRingWriter::Open(const std::string &ringName, const MedianFileHeader &sourceHeader, uint32_t slotCount)
+{
+    assert(m_Ring == nullptr);
+    assert(slotCount > 0);
+    m_Name = MedianRingShmName(ringName);
+    m_CellCount = (size_t)sourceHeader.m_GridRows * (size_t)sourceHeader.m_GridCols;
+    size_t slotSize = (sizeof(MedianRingSlot) + m_CellCount + cMedianRingSlotAlignment - 1) /
+                      cMedianRingSlotAlignment * cMedianRingSlotAlignment;
+    m_Size = cMedianRingSlotOffset + (size_t)slotCount * slotSize;
+    
+    // Replace any ring left with the same name. Readers that still have the old one mapped keep it.
+    shm_unlink(m_Name.c_str());
+    int fd = shm_open(m_Name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Can't create the median ring \"%s\"\n", m_Name.c_str());
+        return false;
+    }
+    void *mapping = MAP_FAILED;
+    if (ftruncate(fd, (off_t)m_Size) == 0) {
+        mapping = mmap(nullptr, m_Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Can't map the median ring \"%s\"\n", m_Name.c_str());
+        shm_unlink(m_Name.c_str());
+        return false;
+    }
+    m_Ring = (uint8_t *)mapping;
+    
+    // The new object is zero-filled, so every slot starts out empty. The header is marked ready
+    // last, so readers never see it half filled in.
+    m_Header = new (m_Ring) MedianRingHeader();
+    memcpy(m_Header->m_Magic, cMedianRingMagic, sizeof(m_Header->m_Magic));
+    m_Header->m_Version = cMedianRingVersion;
+    m_Header->m_HeaderSize = sizeof(MedianRingHeader);
+    m_Header->m_SlotCount = slotCount;
+    m_Header->m_SlotSize = (uint32_t)slotSize;
+    m_Header->m_SlotOffset = cMedianRingSlotOffset;
+    m_Header->m_Source = sourceHeader;
+    m_Header->m_Ready.store(1, std::memory_order_release);
+    return true;
+}
+
+
+void MedianRingWriter::WriteFrame(const FrameData &frameData)
+{
+    assert(m_Ring != nullptr);
+    assert(frameData.m_CellGrayMedians.size() == m_CellCount);
+    uint64_t number = ++m_PublishedCount;
+    size_t slotIndex = (size_t)((number - 1) % m_Header->m_SlotCount);
+    uint8_t *slotStart = m_Ring + m_Header->m_SlotOffset + slotIndex * m_Header->m_SlotSize;
+    MedianRingSlot *slot = (MedianRingSlot *)slotStart;
+    
+    // Mark the slot as being written before anything in it changes, then fill it in and mark it
+    // complete
+    slot->m_Sequence.store(2 * number - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->m_Timestamp = frameData.m_Timestamp;
+    uint8_t *medians = slotStart + sizeof(MedianRingSlot);
+    for (size_t i = 0; i < m_CellCount; i++) {
+        assert(frameData.m_CellGrayMedians[i] >= 0 && frameData.m_CellGrayMedians[i] <= 255);
+        medians[i] = (uint8_t)frameData.m_CellGrayMedians[i];
+    }
+    slot->m_Sequence.store(2 * number, std::memory_order_release);
+    m_Header->m_PublishedCount.store(number, std::memory_order_release);
+}
+
+
+bool MedianRingWriter::Finish()
+{
+    assert(m_Ring != nullptr);
+    prvClose();
+    return true;
+}
+
+
+// Tells readers there's nothing more, and unmaps the ring. Readers are told even if the writer
+// didn't finish, so they don't wait forever.
+void MedianRingWriter::prvClose()
+{
+    if (m_Ring) {
+        m_Header->m_Finished.store(1, std::memory_order_release);
+        munmap(m_Ring, m_Size);
+        m_Ring = nullptr;
+        m_Header = nullptr;
+    }
+}
@@ -0,0 +1,47 @@
+//
+//  MedianRingWriter.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef MedianRingWriter_hpp
+#define MedianRingWriter_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "FrameData.hpp"
+#include "MedianRing.hpp"
+
+// Publishes results to a median ring (see MedianRing.hpp). Each keyframe's medians are written
+// into the next slot and published as soon as they arrive; Finish() tells readers there are no
+// more. The ring is left in place afterward, so readers can still catch up, until another writer
+// replaces it.
+class MedianRingWriter : public FrameDataSink
+{
+public:
+    MedianRingWriter();
+    ~MedianRingWriter();
+    
+    // Creates the ring, replacing any with the same name. The grid and source are taken from
+    // sourceHeader. On failure, reports why to stderr and returns false.
+    bool Open(const std::string &ringName, const MedianFileHeader &sourceHeader, uint32_t slotCount);
+    
+    void WriteFrame(const FrameData &frameData) override;
+    bool Finish() override;
+
+private:
+    std::string         m_Name;
+    uint8_t*            m_Ring;
+    size_t              m_Size;
+    MedianRingHeader*   m_Header;
+    size_t              m_CellCount;
+    uint64_t            m_PublishedCount;
+    
+    void prvClose();
+};
+
+#endif /* MedianRingWriter_hpp */
@@ -0,0 +1,264 @@
+//
+//  MedianSample.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "MedianSample.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <libavformat/avformat.h>
+
+#if defined(__cplusplus)
+}
+#endif
+
+#include "FrameData.hpp"
+#include "MovieAnalysis.hpp"
+#include "MovieReader.hpp"
+#include "ThreadPool.hpp"
+
+struct MedianSampleSource
+{
+    std::string     m_Filepath;
+    std::unique_ptr<MovieReader> m_MovieReader;     // Open and unread, until a run takes it
+    AnalysisOptions m_Options;
+    bool            m_AllStreams = false;
+    std::unique_ptr<ThreadPool> m_BandThreadPool;
+};
+
+
+#pragma mark - Callback sink
+
+// Hands each keyframe's results to the client's callback. The medians are passed in place, in the
+// buffer the frame processor found them in.
+class CallbackSink : public FrameDataSink
+{
+public:
+    CallbackSink(int streamIndex, const GridSize &grid, MedianSampleKeyframeCallback callback, void *context) :
+    m_StreamIndex(streamIndex),
+    m_Grid(grid),
+    m_Callback(callback),
+    m_Context(context)
+    {
+    }
+    
+    void WriteFrame(const FrameData &frameData) override
+    {
+        MedianSampleKeyframe keyframe;
+        keyframe.streamIndex = m_StreamIndex;
+        keyframe.timestamp = frameData.m_Timestamp;
+        keyframe.gridRows = m_Grid.m_Rows;
+        keyframe.gridCols = m_Grid.m_Cols;
+        keyframe.medians = frameData.m_CellGrayMedians.data();
+        m_Callback(m_Context, &keyframe);
+    }
+
+private:
+    int             m_StreamIndex;
+    GridSize        m_Grid;
+    MedianSampleKeyframeCallback m_Callback;
+    void*           m_Context;
+};
+
+
+#pragma mark - API
+
+int MedianSampleAPIVersion(void)
+{
+    return MEDIAN_SAMPLE_API_VERSION;
+}
+
+
+const char* MedianSampleStatusDescription(MedianSampleStatus status)
+{
+    switch (status) {
+        case MedianSampleOK:
+            return "OK";
+        case MedianSampleInvalidArgument:
+            return "Invalid argument";
+        case MedianSampleOpenFailed:
+            return "Can't open the movie";
+        case MedianSampleGridTooLarge:
+            return "Video image is smaller than the grid";
+        case MedianSampleAnalysisFailed:
+            return "Analysis failed";
+    }
+    return "Unknown status";
+}
+
+
+// Opens the source's movie for a run. On failure, reports why to stderr and returns nullptr.
+static std::unique_ptr<MovieReader> prvOpenMovie(const std::string &filepath)
+{
+    std::unique_ptr<MovieReader> movieReader(new MovieReader);
+    if (!movieReader->Open(filepath)) {
+        return nullptr;
+    }
+    if (movieReader->VideoStreamIndices().empty()) {
+        fprintf(stderr, "No video found in \"%s\"\n", filepath.c_str());
+        return nullptr;
+    }
+    return movieReader;
+}
+
+
+MedianSampleStatus MedianSampleOpen(const char *filepath, MedianSampleSource **source)
+{
+    if (filepath == NULL || source == NULL) {
+        return MedianSampleInvalidArgument;
+    }
+    *source = NULL;
+    std::unique_ptr<MedianSampleSource> newSource(new MedianSampleSource);
+    newSource->m_Filepath = filepath;
+    newSource->m_Options.m_InputFilepath = filepath;
+    newSource->m_MovieReader = prvOpenMovie(newSource->m_Filepath);
+    if (!newSource->m_MovieReader) {
+        return MedianSampleOpenFailed;
+    }
+    *source = newSource.release();
+    return MedianSampleOK;
+}
+
+
+void MedianSampleClose(MedianSampleSource *source)
+{
+    delete source;
+}
+
+
+int MedianSampleVideoStreamCount(const MedianSampleSource *source)
+{
+    if (source == NULL) {
+        return 0;
+    }
+    if (!source->m_MovieReader) {       // A run took it, but the movie hasn't changed
+        std::unique_ptr<MovieReader> movieReader = prvOpenMovie(source->m_Filepath);
+        return movieReader ? (int)movieReader->VideoStreamIndices().size() : 0;
+    }
+    return (int)source->m_MovieReader->VideoStreamIndices().size();
+}
+
+
+MedianSampleStatus MedianSampleSetGrid(MedianSampleSource *source, int rows, int cols)
+{
+    if (source == NULL || rows < 1 || cols < 1) {
+        return MedianSampleInvalidArgument;
+    }
+    source->m_Options.m_Grids.assign(1, GridSize{rows, cols});
+    return MedianSampleOK;
+}
+
+
+MedianSampleStatus MedianSampleSetKeyframesOnly(MedianSampleSource *source, int keyframesOnly)
+{
+    if (source == NULL) {
+        return MedianSampleInvalidArgument;
+    }
+    source->m_Options.m_KeyframesOnly = (keyframesOnly != 0);
+    return MedianSampleOK;
+}
+
+
+MedianSampleStatus MedianSampleSetAllStreams(MedianSampleSource *source, int allStreams)
+{
+    if (source == NULL) {
+        return MedianSampleInvalidArgument;
+    }
+    source->m_AllStreams = (allStreams != 0);
+    return MedianSampleOK;
+}
+
+
+MedianSampleStatus MedianSampleSetSegmentCount(MedianSampleSource *source, int segmentCount)
+{
+    if (source == NULL || segmentCount < 1) {
+        return MedianSampleInvalidArgument;
+    }
+    source->m_Options.m_SegmentCount = segmentCount;
+    return MedianSampleOK;
+}
+
+
+MedianSampleStatus MedianSampleSetWorkerCount(MedianSampleSource *source, int workerCount)
+{
+    if (source == NULL || workerCount < 0) {
+        return MedianSampleInvalidArgument;
+    }
+    source->m_Options.m_PipelineOptions.m_WorkerCount = workerCount;
+    return MedianSampleOK;
+}
+
+
+MedianSampleStatus MedianSampleSetBandThreadCount(MedianSampleSource *source, int bandThreadCount)
+{
+    if (source == NULL || bandThreadCount < 1) {
+        return MedianSampleInvalidArgument;
+    }
+    source->m_BandThreadPool.reset();
+    if (bandThreadCount > 1) {
+        source->m_BandThreadPool.reset(new ThreadPool(bandThreadCount));
+    }
+    source->m_Options.m_ProcessorOptions.m_BandThreadPool = source->m_BandThreadPool.get();
+    return MedianSampleOK;
+}
+
+
+MedianSampleStatus MedianSampleRun(MedianSampleSource *source, MedianSampleKeyframeCallback callback,
+                                   void *context)
+{
+    if (source == NULL || callback == NULL) {
+        return MedianSampleInvalidArgument;
+    }
+    if (source->m_Options.m_Grids.empty()) {
+        fprintf(stderr, "No grid has been set\n");
+        return MedianSampleInvalidArgument;
+    }
+    
+    // Use the reader opened with the source, or open the movie again for a later run
+    std::unique_ptr<MovieReader> movieReader = std::move(source->m_MovieReader);
+    if (!movieReader) {
+        movieReader = prvOpenMovie(source->m_Filepath);
+        if (!movieReader) {
+            return MedianSampleOpenFailed;
+        }
+    }
+    
+    // Pick the streams, and make sure the grid fits each of them
+    const std::vector<int> &videoStreamIndices = movieReader->VideoStreamIndices();
+    std::vector<int> streamIndices(1, videoStreamIndices.front());
+    if (source->m_AllStreams) {
+        streamIndices = videoStreamIndices;
+    }
+    const GridSize &grid = source->m_Options.m_Grids.front();
+    for (int streamIndex : streamIndices) {
+        AVCodecParameters *streamParameters = movieReader->Stream(streamIndex)->codecpar;
+        if (streamParameters->width < grid.m_Cols || streamParameters->height < grid.m_Rows) {
+            fprintf(stderr, "Video image is smaller than the grid\n");
+            return MedianSampleGridTooLarge;
+        }
+    }
+    
+    // Analyze the streams straight into the callback
+    std::vector<std::unique_ptr<CallbackSink>> sinks;
+    std::vector<FrameDataSink*> outputs;
+    for (int streamIndex : streamIndices) {
+        sinks.emplace_back(new CallbackSink(streamIndex, grid, callback, context));
+        outputs.push_back(sinks.back().get());
+    }
+    std::vector<Segment> segments;
+    if (!AnalyzeStreams(*movieReader, streamIndices, source->m_Options, outputs, segments)) {
+        return MedianSampleAnalysisFailed;
+    }
+    return MedianSampleOK;
+}
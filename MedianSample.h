@@ -0,0 +1,95 @@
+//
+//  MedianSample.h
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef MedianSample_h
+#define MedianSample_h
+
+// The C API of libmediansample, which finds the gray medians of the cells of a grid laid over each
+// keyframe of a movie's video, as sample_p does, and hands each keyframe's results to a callback
+// rather than writing them to a file.
+//
+// A typical use:
+//
+//     MedianSampleSource *source = NULL;
+//     if (MedianSampleOpen("movie.mp4", &source) == MedianSampleOK) {
+//         MedianSampleSetGrid(source, 32, 32);
+//         MedianSampleRun(source, MyKeyframeCallback, myContext);
+//         MedianSampleClose(source);
+//     }
+//
+// Errors are returned as a status, and the reason is also reported to stderr.
+
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Changes whenever the API or the layout of its structures changes incompatibly. Compare it to
+// MedianSampleAPIVersion() to check the library matches the header.
+#define MEDIAN_SAMPLE_API_VERSION 1
+
+typedef enum MedianSampleStatus {
+    MedianSampleOK = 0,
+    MedianSampleInvalidArgument,        // A null pointer, a count out of range, or no grid set
+    MedianSampleOpenFailed,             // The movie can't be read, or has no video
+    MedianSampleGridTooLarge,           // The grid has more rows or columns than the video has pixels
+    MedianSampleAnalysisFailed          // Decoding or analysis failed partway through
+} MedianSampleStatus;
+
+// An open movie, and how it's to be analyzed
+typedef struct MedianSampleSource MedianSampleSource;
+
+// One keyframe's results
+typedef struct MedianSampleKeyframe {
+    int             streamIndex;        // The video stream's index in the movie
+    double          timestamp;          // Seconds from the start of the stream
+    int             gridRows;
+    int             gridCols;
+    
+    // gridRows * gridCols gray medians from 0 to 255, row by row, left to right. They're the
+    // library's own buffer, only valid until the callback returns.
+    const int*      medians;
+} MedianSampleKeyframe;
+
+// Called with each keyframe's results, in time order for each stream. Calls for one stream never
+// overlap, but with MedianSampleSetAllStreams(), calls for different streams can come at the same
+// time on different threads.
+typedef void (*MedianSampleKeyframeCallback)(void *context, const MedianSampleKeyframe *keyframe);
+
+int                 MedianSampleAPIVersion(void);
+const char*         MedianSampleStatusDescription(MedianSampleStatus status);
+
+// Opens a movie and finds its video streams. On success, *source is set to a source that must be
+// passed to MedianSampleClose().
+MedianSampleStatus  MedianSampleOpen(const char *filepath, MedianSampleSource **source);
+void                MedianSampleClose(MedianSampleSource *source);
+
+int                 MedianSampleVideoStreamCount(const MedianSampleSource *source);
+
+// Sets the grid, as rows and columns of cells. It must be set before running.
+MedianSampleStatus  MedianSampleSetGrid(MedianSampleSource *source, int rows, int cols);
+
+// Options, which match sample_p's. All are off, or 1, by default.
+MedianSampleStatus  MedianSampleSetKeyframesOnly(MedianSampleSource *source, int keyframesOnly);    // --keyframes-only
+MedianSampleStatus  MedianSampleSetAllStreams(MedianSampleSource *source, int allStreams);          // --all-streams
+MedianSampleStatus  MedianSampleSetSegmentCount(MedianSampleSource *source, int segmentCount);      // --segments
+MedianSampleStatus  MedianSampleSetWorkerCount(MedianSampleSource *source, int workerCount);        // --workers
+MedianSampleStatus  MedianSampleSetBandThreadCount(MedianSampleSource *source, int bandThreadCount); // --band-threads
+
+// Analyzes every keyframe of the first video stream, or of every video stream, and passes each
+// one's results to the callback. Returns once all have been passed. It can be called again,
+// perhaps with another grid, and reads the movie again from the start.
+MedianSampleStatus  MedianSampleRun(MedianSampleSource *source, MedianSampleKeyframeCallback callback,
+                                    void *context);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* MedianSample_h */
@@ -0,0 +1,443 @@
+//
+//  MovieAnalysis.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "MovieAnalysis.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/mathematics.h>
+
+#if defined(__cplusplus)
+}
+#endif
+
+#include "BoundedQueue.hpp"
+#include "ElapsedTime.hpp"
+#include "FrameAnalyzer.hpp"
+#include "GridHistogram.hpp"
+#include "MedianGridAnalyzer.hpp"
+#include "MovieReader.hpp"
+#include "RowLatencyRecorder.hpp"
+#include "StreamDecoder.hpp"
+
+#if 0       // Enable when needed
+#define LOG printf
+#else
+inline void LOG(...) {}
+#endif
+
+
+// When several streams are analyzed, each stream's decoding thread has a queue of this many packets
+static const size_t cStreamPacketQueueDepth = 64;
+
+
+// Converts a time from one stream's time base to another's, leaving open ends open
+static int64_t prvRescaleTime(int64_t time, AVRational fromTimeBase, AVRational toTimeBase)
+{
+    if (time == INT64_MIN || time == INT64_MAX) {
+        return time;
+    }
+    return av_rescale_q(time, fromTimeBase, toTimeBase);
+}
+
+
+// Splits the main stream's time range into segments, each covering the same span of every stream
+// being analyzed. Falls back to a single segment when the input can't be split.
+static std::vector<Segment> prvMakeSegments(MovieReader &movieReader, const std::vector<int> &streamIndices,
+                                            int segmentCount)
+{
+    int mainStreamIndex = streamIndices.front();
+    int64_t streamStartTime = 0;
+    int64_t streamDuration = 0;
+    if (segmentCount > 1) {
+        if (!movieReader.CanSeek()) {
+            fprintf(stderr, "The input can't seek, so it will be analyzed as one segment\n");
+            segmentCount = 1;
+        }
+        else if (!movieReader.GetStreamTimeRange(mainStreamIndex, streamStartTime, streamDuration)) {
+            fprintf(stderr, "The video's duration is unknown, so it will be analyzed as one segment\n");
+            segmentCount = 1;
+        }
+    }
+    
+    // The first and last segments are open-ended, so keyframes with times outside the stream's
+    // nominal range are still analyzed
+    AVRational mainTimeBase = movieReader.Stream(mainStreamIndex)->time_base;
+    std::vector<Segment> segments(segmentCount);
+    for (int i = 0; i < segmentCount; i++) {
+        Segment &segment = segments[i];
+        segment.m_IsFirst = (i == 0);
+        segment.m_StartTime = (i == 0) ? INT64_MIN :
+                              streamStartTime + av_rescale(streamDuration, i, segmentCount);
+        segment.m_EndTime = (i == segmentCount - 1) ? INT64_MAX :
+                            streamStartTime + av_rescale(streamDuration, i + 1, segmentCount);
+        
+        segment.m_Streams.resize(streamIndices.size());
+        for (size_t j = 0; j < streamIndices.size(); j++) {
+            SegmentStream &segmentStream = segment.m_Streams[j];
+            AVRational timeBase = movieReader.Stream(streamIndices[j])->time_base;
+            segmentStream.m_StreamIndex = streamIndices[j];
+            segmentStream.m_StartTime = prvRescaleTime(segment.m_StartTime, mainTimeBase, timeBase);
+            segmentStream.m_EndTime = prvRescaleTime(segment.m_EndTime, mainTimeBase, timeBase);
+        }
+    }
+    return segments;
+}
+
+
+// Makes the analyses that are run on each of a stream's keyframes, writing to its sink
+static std::vector<std::unique_ptr<FrameAnalyzer>> prvMakeAnalyzers(const AnalysisOptions &options,
+                                                                    FrameDataSink *sink)
+{
+    std::vector<std::unique_ptr<FrameAnalyzer>> analyzers;
+    analyzers.emplace_back(new MedianGridAnalyzer(options.m_Grids, sink, options.m_ProcessorOptions,
+                                                  options.m_PipelineOptions, options.m_DeadlineSeconds,
+                                                  options.m_DeadlineStats, options.m_DeadlineMode));
+    return analyzers;
+}
+
+
+// One attempt at decoding and analyzing a stream's share of a segment. With one stream, packets
+// are decoded on the demuxing thread. With several, the demuxing thread queues each stream's
+// packets, and the stream decodes them on a thread of its own.
+class StreamRun
+{
+public:
+    StreamRun(const AnalysisOptions &options, SegmentStream &segmentStream, RowLatencyRecorder *rowLatency) :
+    m_Options(options),
+    m_SegmentStream(segmentStream),
+    m_RowLatency(rowLatency),
+    m_AnalysisSecondsBefore(segmentStream.m_AnalysisSeconds),
+    m_Packets(cStreamPacketQueueDepth),
+    m_WantsMore(true)
+    {
+    }
+    
+    StreamRun(const StreamRun&) = delete;
+    StreamRun& operator=(const StreamRun&) = delete;
+    
+    // Sets up the decoder and the analyses. On failure, reports why to stderr and returns false.
+    bool Begin(AVStream *stream, bool requireKeyframeAtStart)
+    {
+        // Streamed keyframes shouldn't wait in the decoder for later ones to arrive
+        bool lowDelay = m_Options.m_InputIOMode == InputIOMode::Stream && m_Options.m_KeyframesOnly;
+        if (!m_Decoder.Open(stream, m_Options.m_KeyframesOnly, m_Options.m_CodecContextCache, lowDelay)) {
+            return false;
+        }
+        m_Decoder.SetKeyframeRange(m_SegmentStream.m_StartTime, m_SegmentStream.m_EndTime, requireKeyframeAtStart);
+        m_Analyzers = prvMakeAnalyzers(m_Options, m_SegmentStream.m_Sink);
+        for (std::unique_ptr<FrameAnalyzer> &analyzer : m_Analyzers) {
+            if (!analyzer->BeginStream(stream, m_Decoder.CodecContext())) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // Whether the stream still needs packets. It may lag behind the decoding thread.
+    bool WantsMore() const  { return m_WantsMore.load(std::memory_order_acquire); }
+    bool Overshot() const   { return m_Decoder.Overshot(); }
+    size_t KeyframeCount() const { return m_Decoder.KeyframeCount(); }
+    
+    // Decodes one of the stream's packets
+    void DecodePacket(const AVPacket *packet)
+    {
+        std::chrono::steady_clock::time_point decodeStartTime = std::chrono::steady_clock::now();
+        if (!m_Decoder.DecodePacket(packet, m_KeyframeHandler)) {
+            m_WantsMore.store(false, std::memory_order_release);
+        }
+        m_SegmentStream.m_DecodeSeconds += SecondsSince(decodeStartTime);
+    }
+    
+    // Gets any frames still held by the decoder. Analysis happens inside decoding, so its time is
+    // taken back out.
+    void Flush()
+    {
+        std::chrono::steady_clock::time_point flushStartTime = std::chrono::steady_clock::now();
+        m_Decoder.Flush(m_KeyframeHandler);
+        m_SegmentStream.m_DecodeSeconds += SecondsSince(flushStartTime);
+        m_SegmentStream.m_DecodeSeconds -= m_SegmentStream.m_AnalysisSeconds - m_AnalysisSecondsBefore;
+    }
+    
+    // Hands a packet to the decoding thread, taking its data and leaving it blank. A null packet
+    // marks the end.
+    void QueuePacket(AVPacket *packet)
+    {
+        AVPacket *queuedPacket = nullptr;
+        if (packet != nullptr) {
+            queuedPacket = av_packet_alloc();
+            assert(queuedPacket != nullptr);
+            av_packet_move_ref(queuedPacket, packet);
+        }
+        m_Packets.Push(queuedPacket);
+    }
+    
+    // The decoding thread: decodes queued packets until the end is marked, then flushes. Packets
+    // that arrive after the stream is done are dropped.
+    void DecodeQueuedPackets()
+    {
+        for (;;) {
+            AVPacket *packet = nullptr;
+            m_Packets.Pop(packet);
+            if (packet == nullptr) {
+                break;
+            }
+            if (WantsMore()) {
+                DecodePacket(packet);
+            }
+            av_packet_free(&packet);
+        }
+        Flush();
+    }
+    
+    // Finishes the analyses and records the results. Returns false if an analysis failed.
+    bool End()
+    {
+        std::chrono::steady_clock::time_point endStartTime = std::chrono::steady_clock::now();
+        bool ended = true;
+        for (std::unique_ptr<FrameAnalyzer> &analyzer : m_Analyzers) {
+            ended = analyzer->EndStream() && ended;
+        }
+        m_SegmentStream.m_AnalysisSeconds += SecondsSince(endStartTime);
+        if (ended) {
+            m_SegmentStream.m_FrameCount = m_Decoder.FrameCount();
+            m_SegmentStream.m_KeyframeCount = m_Decoder.KeyframeCount();
+            m_SegmentStream.m_Succeeded = true;
+        }
+        return ended;
+    }
+
+private:
+    const AnalysisOptions&  m_Options;
+    SegmentStream&          m_SegmentStream;
+    RowLatencyRecorder*     m_RowLatency;
+    double                  m_AnalysisSecondsBefore;
+    StreamDecoder           m_Decoder;
+    std::vector<std::unique_ptr<FrameAnalyzer>> m_Analyzers;
+    BoundedQueue<AVPacket*> m_Packets;
+    std::atomic<bool>       m_WantsMore;
+    
+    StreamDecoder::KeyframeHandler m_KeyframeHandler = [this](AVFrame *keyframe) {
+        LOG("Stream %d keyframe %zu at sample %zu\n", m_SegmentStream.m_StreamIndex, m_Decoder.KeyframeCount(),
+            m_Decoder.FrameCount());
+        if (m_RowLatency != nullptr) {
+            m_RowLatency->KeyframeDecoded(keyframe->pts);
+        }
+        std::chrono::steady_clock::time_point analysisStartTime = std::chrono::steady_clock::now();
+        for (std::unique_ptr<FrameAnalyzer> &analyzer : m_Analyzers) {
+            analyzer->ProcessKeyFrame(keyframe);
+        }
+        m_SegmentStream.m_AnalysisSeconds += SecondsSince(analysisStartTime);
+    };
+};
+
+
+// Analyzes one segment of every stream in it, using a reader that's already open. The file is
+// demuxed once, and each packet goes to its stream's decoder. After seeking, a segment decodes
+// from the keyframe at or before its start; if the demuxer's seek lands later than that for a
+// stream, the streams that missed their start seek again further back, so no keyframe is missed.
+// The others keep what they found.
+static void prvAnalyzeSegment(MovieReader &movieReader, const AnalysisOptions &options, Segment &segment)
+{
+    AVStream* mainStream = movieReader.Stream(segment.m_Streams.front().m_StreamIndex);
+    int64_t mainStreamStartTime = 0;
+    int64_t mainStreamDuration = 0;
+    movieReader.GetStreamTimeRange(mainStream->index, mainStreamStartTime, mainStreamDuration);
+    int64_t seekTime = segment.m_StartTime;
+    
+    // Back off by a fraction of a segment's span, from the stream's duration; the first and last
+    // segments are open-ended, so their own bounds don't say how long they are
+    int64_t segmentSpan = mainStreamDuration / std::max(options.m_SegmentCount, 1);
+    int64_t seekBackoff = std::max<int64_t>(segmentSpan / 4, 1);
+    
+    AVPacket *packet = av_packet_alloc();
+    assert(packet != nullptr);
+    double ioWaitSecondsBefore = movieReader.IOWaitSeconds();   // Opening the movie also read some
+    
+    std::vector<SegmentStream*> pendingStreams;
+    for (SegmentStream &segmentStream : segment.m_Streams) {
+        pendingStreams.push_back(&segmentStream);
+    }
+    while (!pendingStreams.empty()) {
+        if (!segment.m_IsFirst && !movieReader.SeekToKeyframe(mainStream->index, seekTime)) {
+            fprintf(stderr, "Can't seek in the input\n");
+            break;
+        }
+        
+        // Set up a decoder and the analyses for each stream. Once the seek is back at the main
+        // stream's start, no stream can have missed anything.
+        std::vector<std::unique_ptr<StreamRun>> runs;
+        std::vector<StreamRun*> runsByStreamIndex(movieReader.FormatContext()->nb_streams, nullptr);
+        bool began = true;
+        for (size_t i = 0; i < pendingStreams.size() && began; i++) {
+            SegmentStream &segmentStream = *pendingStreams[i];
+            AVStream *stream = movieReader.Stream(segmentStream.m_StreamIndex);
+            int64_t streamStartTime = 0;
+            int64_t streamDuration = 0;
+            movieReader.GetStreamTimeRange(segmentStream.m_StreamIndex, streamStartTime, streamDuration);
+            bool requireKeyframeAtStart = !segment.m_IsFirst && seekTime > mainStreamStartTime &&
+                prvRescaleTime(seekTime, mainStream->time_base, stream->time_base) > streamStartTime;
+            bool measuresLatency = segment.m_IsFirst && &segmentStream == &segment.m_Streams.front();
+            runs.emplace_back(new StreamRun(options, segmentStream, measuresLatency ? options.m_RowLatency : nullptr));
+            runsByStreamIndex[segmentStream.m_StreamIndex] = runs.back().get();
+            began = runs.back()->Begin(stream, requireKeyframeAtStart);
+        }
+        if (!began) {
+            break;
+        }
+        std::vector<std::thread> decodingThreads;
+        if (runs.size() > 1) {
+            for (std::unique_ptr<StreamRun> &run : runs) {
+                decodingThreads.emplace_back(&StreamRun::DecodeQueuedPackets, run.get());
+            }
+        }
+        
+        // Route the packets to the streams until none needs more
+        std::chrono::steady_clock::time_point readStartTime = std::chrono::steady_clock::now();
+        while (movieReader.ReadPacket(packet)) {
+            segment.m_ReadSeconds += SecondsSince(readStartTime);
+            StreamRun *run = (packet->stream_index < (int)runsByStreamIndex.size()) ?
+                             runsByStreamIndex[packet->stream_index] : nullptr;
+            if (run != nullptr && run->WantsMore()) {
+                if (options.m_RowLatency != nullptr && segment.m_IsFirst && packet->stream_index == mainStream->index) {
+                    options.m_RowLatency->PacketDemuxed(packet->pts, (packet->flags & AV_PKT_FLAG_KEY) != 0);
+                }
+                if (decodingThreads.empty()) {
+                    run->DecodePacket(packet);
+                }
+                else {
+                    run->QueuePacket(packet);
+                }
+            }
+            
+            // Prepare for the next iteration
+            av_packet_unref(packet);
+            bool wantsMore = false;
+            for (size_t i = 0; i < runs.size() && !wantsMore; i++) {
+                wantsMore = runs[i]->WantsMore();
+            }
+            if (!wantsMore) {
+                break;
+            }
+            readStartTime = std::chrono::steady_clock::now();
+        }
+        
+        // Process any cached frames
+        if (decodingThreads.empty()) {
+            runs.front()->Flush();
+        }
+        else {
+            for (size_t i = 0; i < runs.size(); i++) {
+                runs[i]->QueuePacket(nullptr);
+                decodingThreads[i].join();
+            }
+        }
+        
+        // Streams that overshot try again from further back. Overshooting is noticed at the first
+        // keyframe, before anything has been written.
+        std::vector<SegmentStream*> overshotStreams;
+        bool ended = true;
+        for (size_t i = 0; i < runs.size(); i++) {
+            if (runs[i]->Overshot()) {
+                assert(runs[i]->KeyframeCount() == 0);
+                overshotStreams.push_back(pendingStreams[i]);
+            }
+            else {
+                ended = runs[i]->End() && ended;
+            }
+        }
+        if (!ended) {
+            break;
+        }
+        pendingStreams = overshotStreams;
+        seekTime = std::max(seekTime - seekBackoff, mainStreamStartTime);
+        seekBackoff *= 2;
+    }
+    
+    av_packet_free(&packet);
+    segment.m_IOWaitSeconds = movieReader.IOWaitSeconds() - ioWaitSecondsBefore;
+}
+
+
+bool AnalyzeStreams(MovieReader &movieReader, const std::vector<int> &streamIndices, const AnalysisOptions &options,
+                    const std::vector<FrameDataSink*> &outputs, std::vector<Segment> &segments)
+{
+    // With more than one segment, each segment after the first gets its own thread and its own
+    // reader, decoders, and frame processors, so they run independently. The first segment writes
+    // straight to the outputs; later ones spool their results to temporary files until the
+    // segments before them are done.
+    LOG("Histogram kernel: %s\n", GetGrayRowHistogramKernelName());
+    segments = prvMakeSegments(movieReader, streamIndices, options.m_SegmentCount);
+    for (size_t i = 0; i < segments.size(); i++) {
+        for (size_t j = 0; j < outputs.size(); j++) {
+            SegmentStream &segmentStream = segments[i].m_Streams[j];
+            if (i == 0) {
+                segmentStream.m_Sink = outputs[j];
+                continue;
+            }
+            segmentStream.m_Spool.reset(new FrameDataSpool);
+            if (!segmentStream.m_Spool->Open()) {
+                return false;
+            }
+            segmentStream.m_Sink = segmentStream.m_Spool.get();
+        }
+    }
+    std::vector<std::thread> segmentThreads;
+    for (size_t i = 1; i < segments.size(); i++) {
+        Segment &segment = segments[i];
+        segmentThreads.emplace_back([&options, &segment]() {
+            MovieReader segmentReader;
+            if (segmentReader.Open(options.m_InputFilepath, options.m_InputIOMode, options.m_FastStart)) {
+                prvAnalyzeSegment(segmentReader, options, segment);
+            }
+        });
+    }
+    prvAnalyzeSegment(movieReader, options, segments.front());
+    for (std::thread &segmentThread : segmentThreads) {
+        segmentThread.join();
+    }
+    
+    
+    // Append each stream's later segments' results in time order, and finish its output
+    for (size_t j = 0; j < outputs.size(); j++) {
+        size_t frameCount = 0;
+        size_t keyframeCount = 0;
+        for (Segment &segment : segments) {
+            SegmentStream &segmentStream = segment.m_Streams[j];
+            if (!segmentStream.m_Succeeded) {
+                fprintf(stderr, "Analysis failed\n");
+                return false;
+            }
+            frameCount += segmentStream.m_FrameCount;
+            keyframeCount += segmentStream.m_KeyframeCount;
+            if (segmentStream.m_Spool && !segmentStream.m_Spool->Replay(*outputs[j])) {
+                fprintf(stderr, "Can't read back a segment's results\n");
+                return false;
+            }
+            segmentStream.m_Spool.reset();
+        }
+        
+        LOG("Stream %d: found %zu video frames, %zu keyframes\n", streamIndices[j], frameCount, keyframeCount);
+        if (!outputs[j]->Finish()) {
+            fprintf(stderr, "Can't write the results\n");
+            return false;
+        }
+    }
+    return true;
+}
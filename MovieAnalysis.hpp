@@ -0,0 +1,90 @@
+//
+//  MovieAnalysis.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef MovieAnalysis_hpp
+#define MovieAnalysis_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DeadlineScheduler.hpp"
+#include "FrameData.hpp"
+#include "FrameDataSpool.hpp"
+#include "FrameProcessor.hpp"
+#include "InputIO.hpp"
+#include "KeyframePipeline.hpp"
+
+// Foreward declarations
+class CodecContextCache;
+class MovieReader;
+class RowLatencyRecorder;
+
+// How a movie's video streams are analyzed
+struct AnalysisOptions
+{
+    std::string m_InputFilepath;            // Opened again by each segment after the first
+    std::vector<GridSize> m_Grids;
+    FrameProcessorOptions m_ProcessorOptions;
+    PipelineOptions m_PipelineOptions;
+    bool        m_KeyframesOnly = false;
+    int         m_SegmentCount = 1;
+    InputIOMode m_InputIOMode = InputIOMode::Ffmpeg;
+    bool        m_FastStart = false;        // See MovieReader::Open()
+    double      m_DeadlineSeconds = 0.0;    // Each keyframe's budget, for DeadlineScheduler; 0 for none
+    DeadlineStats* m_DeadlineStats = nullptr;   // What the deadlines did, if wanted
+    DeadlineMode m_DeadlineMode = DeadlineMode::Auto;
+    CodecContextCache* m_CodecContextCache = nullptr;   // Where decoders are reused from, if anywhere
+    RowLatencyRecorder* m_RowLatency = nullptr;         // Told about the main stream's packets and keyframes in
+                                                        // the first segment, if given
+};
+
+// One video stream's share of a segment. Its times are the segment's, in the stream's time base.
+struct SegmentStream
+{
+    int         m_StreamIndex = -1;
+    int64_t     m_StartTime = INT64_MIN;
+    int64_t     m_EndTime = INT64_MAX;
+    
+    FrameDataSink* m_Sink = nullptr;
+    std::unique_ptr<FrameDataSpool> m_Spool;            // Where a later segment's results wait their turn
+    size_t      m_FrameCount = 0;
+    size_t      m_KeyframeCount = 0;
+    bool        m_Succeeded = false;
+    
+    // Where the stream's time went, in seconds, for --stats
+    double      m_DecodeSeconds = 0.0;
+    double      m_AnalysisSeconds = 0.0;    // Analyzing keyframes, or handing them to workers
+};
+
+// A span of the video analyzed independently of the others. Each segment covers the keyframes
+// with presentation times in [m_StartTime, m_EndTime), in the main video stream's time base.
+struct Segment
+{
+    int64_t     m_StartTime;
+    int64_t     m_EndTime;
+    bool        m_IsFirst;      // The first segment reads from the start of the file without seeking
+    std::vector<SegmentStream> m_Streams;   // The main stream first, then any others being analyzed
+    
+    // Where the segment's demuxing time went, in seconds, for --stats
+    double      m_ReadSeconds = 0.0;        // Demuxing, including waiting for the file
+    double      m_IOWaitSeconds = 0.0;      // Waiting for the file, if the input I/O measures it
+};
+
+// Analyzes the streams into their outputs, one output per stream in the same order, splitting them
+// into segments as the options ask. The first stream is the main one, whose times the segments
+// are measured in. The movie is demuxed once per segment, and each packet goes to its stream's
+// decoder; with several streams, each is decoded on its own thread. Each output gets its stream's
+// keyframes in time order, and is finished at the end. The segments are left describing where
+// the time went. On failure, reports why to stderr and returns false.
+bool AnalyzeStreams(MovieReader &movieReader, const std::vector<int> &streamIndices, const AnalysisOptions &options,
+                    const std::vector<FrameDataSink*> &outputs, std::vector<Segment> &segments);
+
+#endif /* MovieAnalysis_hpp */
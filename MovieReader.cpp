@@ -0,0 +1,234 @@
+//
+//  MovieReader.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "MovieReader.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/mathematics.h>
+
+#if defined(__cplusplus)
+}
+#endif
+
+// With a fast start, how much of the file avformat_find_stream_info() may read, in bytes, and how
+// much of the movie it may look at, in AV_TIME_BASE units, when the headers aren't enough
+static const int64_t cFastStartProbeSize = 256 * 1024;
+static const int64_t cFastStartAnalyzeDuration = AV_TIME_BASE / 2;
+
+
+MovieReader::MovieReader() :
+m_FormatContext(nullptr),
+m_Probe(StreamProbe::Full),
+m_OpenSeconds(0.0)
+{
+}
+
+MovieReader::~MovieReader()
+{
+    if (m_FormatContext) {
+        avformat_close_input(&m_FormatContext);
+    }
+}
+
+
+bool MovieReader::Open(const std::string &filepath, InputIOMode ioMode, bool fastStart)
+{
+    assert(m_FormatContext == nullptr);
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    if (!prvOpenInput(filepath, ioMode)) {
+        return false;
+    }
+    
+    // With a fast start, streams other than video are never decoded or demuxed. If the headers
+    // don't describe the video, probe just the start of the file for it.
+    m_Probe = StreamProbe::Full;
+    if (fastStart) {
+        prvDiscardAllButVideo();
+        if (prvVideoIsDescribed()) {
+            m_Probe = StreamProbe::Headers;
+        }
+        else {
+            m_FormatContext->probesize = cFastStartProbeSize;
+            m_FormatContext->max_analyze_duration = cFastStartAnalyzeDuration;
+            int status = avformat_find_stream_info(m_FormatContext, NULL);
+            if (status >= 0 && prvVideoIsDescribed()) {
+                m_Probe = StreamProbe::Bounded;
+                prvDiscardAllButVideo();            // Probing may have found more streams
+            }
+            else {
+                // A streamed input can't be read again, so its probe carries on from where it
+                // stopped, with the default limits
+                fprintf(stderr, "A fast start couldn't find the video in \"%s\", so it will be probed fully\n",
+                        filepath.c_str());
+                if (ioMode == InputIOMode::Stream) {
+                    AVFormatContext *defaults = avformat_alloc_context();
+                    m_FormatContext->probesize = defaults->probesize;
+                    m_FormatContext->max_analyze_duration = defaults->max_analyze_duration;
+                    avformat_free_context(defaults);
+                }
+                else {
+                    prvCloseInput();
+                    if (!prvOpenInput(filepath, ioMode)) {
+                        return false;
+                    }
+                }
+                m_Probe = StreamProbe::FellBack;
+            }
+        }
+    }
+    
+    // Look for video streams
+    if (m_Probe == StreamProbe::Full || m_Probe == StreamProbe::FellBack) {
+        int status = avformat_find_stream_info(m_FormatContext, NULL);
+        if (status < 0) {
+            fprintf(stderr, "Can't find stream information in \"%s\"\n", filepath.c_str());
+            return false;
+        }
+    }
+    for (int i = 0; i < m_FormatContext->nb_streams; i++) {
+        AVStream* thisStream = m_FormatContext->streams[i];
+        if (thisStream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+            m_VideoStreamIndices.push_back(i);
+        }
+    }
+    
+    std::chrono::duration<double> openDuration = std::chrono::steady_clock::now() - startTime;
+    m_OpenSeconds = openDuration.count();
+    return true;
+}
+
+
+// Opens the file, and reads its headers
+bool MovieReader::prvOpenInput(const std::string &filepath, InputIOMode ioMode)
+{
+    // Open the input file and determine its format. With a custom AVIOContext, libavformat
+    // reads through it, but still uses the path to help guess the format.
+    m_FormatContext = avformat_alloc_context();
+    if (ioMode != InputIOMode::Ffmpeg) {
+        m_InputIO = InputIO::Open(filepath, ioMode);
+        if (!m_InputIO) {
+            avformat_free_context(m_FormatContext);
+            m_FormatContext = nullptr;
+            return false;
+        }
+        m_FormatContext->pb = m_InputIO->IOContext();
+    }
+    int status = avformat_open_input(&m_FormatContext,
+                                     filepath.c_str(),
+                                     NULL,           // Auto-detect the format
+                                     NULL);          // Don't use any private options
+    if (status < 0) {       // avformat_open_input() frees the context on failure
+        fprintf(stderr, "Can't open \"%s\" as a movie\n", filepath.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+void MovieReader::prvCloseInput()
+{
+    avformat_close_input(&m_FormatContext);
+    m_InputIO.reset();
+}
+
+
+// Keeps the streams other than video from being decoded, or demuxed where the format allows
+void MovieReader::prvDiscardAllButVideo()
+{
+    for (unsigned int i = 0; i < m_FormatContext->nb_streams; i++) {
+        AVStream *stream = m_FormatContext->streams[i];
+        if (stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+            stream->discard = AVDISCARD_ALL;
+        }
+    }
+}
+
+
+// Returns whether every video stream's codec, dimensions, and start time are known, and no more
+// streams can turn up, which is all that's needed to analyze them
+bool MovieReader::prvVideoIsDescribed() const
+{
+    if (m_FormatContext->ctx_flags & AVFMTCTX_NOHEADER) {
+        return false;
+    }
+    bool foundVideo = false;
+    for (unsigned int i = 0; i < m_FormatContext->nb_streams; i++) {
+        const AVStream *stream = m_FormatContext->streams[i];
+        const AVCodecParameters *parameters = stream->codecpar;
+        if (parameters->codec_type != AVMEDIA_TYPE_VIDEO) {
+            continue;
+        }
+        if (parameters->codec_id == AV_CODEC_ID_NONE || parameters->width <= 0 || parameters->height <= 0 ||
+            stream->start_time == AV_NOPTS_VALUE) {
+            return false;
+        }
+        foundVideo = true;
+    }
+    return foundVideo;
+}
+
+
+double MovieReader::IOWaitSeconds() const
+{
+    return m_InputIO ? m_InputIO->IOWaitSeconds() : 0.0;
+}
+
+
+AVStream* MovieReader::Stream(int streamIndex) const
+{
+    assert(m_FormatContext != nullptr);
+    assert(streamIndex >= 0 && (unsigned)streamIndex < m_FormatContext->nb_streams);
+    return m_FormatContext->streams[streamIndex];
+}
+
+
+bool MovieReader::ReadPacket(AVPacket *packet)
+{
+    int frameReadStatus = av_read_frame(m_FormatContext, packet);
+    return frameReadStatus >= 0;
+}
+
+
+bool MovieReader::CanSeek() const
+{
+    AVIOContext *ioContext = m_FormatContext->pb;
+    bool ioCanSeek = (ioContext != nullptr) && (ioContext->seekable & AVIO_SEEKABLE_NORMAL);
+    bool formatCanSeek = !(m_FormatContext->iformat->flags & AVFMT_NOTIMESTAMPS);
+    return ioCanSeek && formatCanSeek;
+}
+
+
+bool MovieReader::SeekToKeyframe(int streamIndex, int64_t timestamp)
+{
+    int status = av_seek_frame(m_FormatContext, streamIndex, timestamp, AVSEEK_FLAG_BACKWARD);
+    return status >= 0;
+}
+
+
+bool MovieReader::GetStreamTimeRange(int streamIndex, int64_t &startTime, int64_t &duration) const
+{
+    AVStream *stream = Stream(streamIndex);
+    startTime = (stream->start_time != AV_NOPTS_VALUE) ? stream->start_time : 0;
+    duration = stream->duration;
+    if (duration == AV_NOPTS_VALUE || duration <= 0) {
+        if (m_FormatContext->duration == AV_NOPTS_VALUE || m_FormatContext->duration <= 0) {
+            return false;
+        }
+        duration = av_rescale_q(m_FormatContext->duration, AV_TIME_BASE_Q, stream->time_base);
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+//
+//  MovieReader.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef MovieReader_hpp
+#define MovieReader_hpp
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "InputIO.hpp"
+
+// Foreward declarations
+struct AVFormatContext;
+struct AVPacket;
+struct AVStream;
+
+// How a movie's streams were found when it was opened
+enum class StreamProbe {
+    Full,           // avformat_find_stream_info() with its default limits
+    Headers,        // The container's headers described the video well enough to skip probing
+    Bounded,        // avformat_find_stream_info(), reading only the start of the file
+    FellBack        // A bounded probe didn't find the video, so the file was probed fully
+};
+
+// Opens a movie file, finds its video streams, and reads packets from it
+class MovieReader
+{
+public:
+    MovieReader();
+    ~MovieReader();
+    
+    // Opens the movie and finds its streams, reading the file as the mode says. With fastStart,
+    // the container's headers are used if they say enough about the video streams; if they don't,
+    // the streams are probed reading only the start of the file, without decoding streams other
+    // than video, and if that isn't enough either, the file is reopened and probed fully; a
+    // streamed input's probe carries on instead. On failure, reports why to stderr and returns
+    // false.
+    bool Open(const std::string &filepath, InputIOMode ioMode = InputIOMode::Ffmpeg, bool fastStart = false);
+    
+    AVFormatContext*        FormatContext() const { return m_FormatContext; }
+    const std::vector<int>& VideoStreamIndices() const { return m_VideoStreamIndices; }
+    AVStream*               Stream(int streamIndex) const;
+    
+    // Reads the next packet. Returns false at the end of the file, or on an error.
+    bool ReadPacket(AVPacket *packet);
+    
+    // Returns whether the input supports seeking by timestamp
+    bool CanSeek() const;
+    
+    // Seeks so the next packet read is from the keyframe at or before the timestamp, which is
+    // in the stream's time base. Returns whether the seek succeeded.
+    bool SeekToKeyframe(int streamIndex, int64_t timestamp);
+    
+    // Returns the stream's start time and duration in its time base, using the container's
+    // duration if the stream doesn't have one. Returns false if the duration isn't known.
+    bool GetStreamTimeRange(int streamIndex, int64_t &startTime, int64_t &duration) const;
+    
+    // The time spent waiting for the file's data so far, in seconds. It's only measured when the
+    // file is read with a mode other than InputIOMode::Ffmpeg, and is 0 otherwise.
+    double IOWaitSeconds() const;
+    
+    // How the streams were found, and how long opening the file and finding them took, in seconds
+    StreamProbe Probe() const { return m_Probe; }
+    double      OpenSeconds() const { return m_OpenSeconds; }
+
+private:
+    std::unique_ptr<InputIO> m_InputIO;         // Declared first, so it outlives the format context
+    AVFormatContext*    m_FormatContext;
+    std::vector<int>    m_VideoStreamIndices;
+    StreamProbe         m_Probe;
+    double              m_OpenSeconds;
+    
+    bool prvOpenInput(const std::string &filepath, InputIOMode ioMode);
+    void prvCloseInput();
+    void prvDiscardAllButVideo();
+    bool prvVideoIsDescribed() const;
+};
+
+#endif /* MovieReader_hpp */
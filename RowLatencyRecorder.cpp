@@ -0,0 +1,138 @@
+//
+//  RowLatencyRecorder.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "RowLatencyRecorder.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <libavutil/avutil.h>
+
+#if defined(__cplusplus)
+}
+#endif
+
+// Bucket 0 holds latencies under 1 ms, and bucket n those from 2^(n-1) ms up to 2^n ms. The last
+// bucket also holds everything longer.
+static const size_t cBucketCount = 16;
+
+// At most this many keyframe packets are kept waiting to be decoded. The decoders are never more
+// than a queue of packets behind the demuxer, so a keyframe that's still waiting after this many
+// more have arrived had a decoded timestamp that didn't match its packet's.
+static const size_t cMaxWaitingPackets = 64;
+
+
+RowLatencyRecorder::RowLatencyRecorder(FrameDataSink *sink) :
+m_Sink(sink),
+m_BucketCounts(cBucketCount, 0),
+m_RowCount(0),
+m_TotalSeconds(0.0),
+m_MaxSeconds(0.0)
+{
+    assert(m_Sink != nullptr);
+}
+
+
+void RowLatencyRecorder::PacketDemuxed(int64_t pts, bool isKeyframe)
+{
+    if (!isKeyframe || pts == AV_NOPTS_VALUE) {
+        return;
+    }
+    TimePoint now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Packets.emplace_back(pts, now);
+    if (m_Packets.size() > cMaxWaitingPackets) {
+        m_Packets.pop_front();
+    }
+}
+
+
+void RowLatencyRecorder::KeyframeDecoded(int64_t pts)
+{
+    // Keyframe packets demuxed before this one's have all been sent to the decoder, and already
+    // been decoded, so they can be forgotten. If the keyframe's packet
+    // can't be found, its row isn't measured.
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto packet = std::find_if(m_Packets.begin(), m_Packets.end(), [pts](const std::pair<int64_t, TimePoint> &p) {
+        return p.first == pts;
+    });
+    if (packet == m_Packets.end()) {
+        m_Keyframes.push_back(TimePoint());
+        return;
+    }
+    m_Keyframes.push_back(packet->second);
+    m_Packets.erase(m_Packets.begin(), packet + 1);
+}
+
+
+void RowLatencyRecorder::WriteFrame(const FrameData &frameData)
+{
+    m_Sink->WriteFrame(frameData);
+    TimePoint now = std::chrono::steady_clock::now();
+    
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Keyframes.empty()) {
+        return;
+    }
+    TimePoint demuxedTime = m_Keyframes.front();
+    m_Keyframes.pop_front();
+    if (demuxedTime == TimePoint()) {
+        return;
+    }
+    double seconds = std::chrono::duration<double>(now - demuxedTime).count();
+    size_t bucket = 0;
+    for (double bucketEnd = 0.001; seconds >= bucketEnd && bucket + 1 < cBucketCount; bucketEnd *= 2.0) {
+        bucket++;
+    }
+    m_BucketCounts[bucket]++;
+    m_RowCount++;
+    m_TotalSeconds += seconds;
+    m_MaxSeconds = std::max(m_MaxSeconds, seconds);
+}
+
+
+bool RowLatencyRecorder::Finish()
+{
+    return m_Sink->Finish();
+}
+
+
+void RowLatencyRecorder::Report(FILE *file) const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    fprintf(file, "Row latency, from demuxing a keyframe to writing its row:\n");
+    if (m_RowCount == 0) {
+        fprintf(file, "    No rows measured\n");
+        return;
+    }
+    fprintf(file, "    %zu rows, mean %.3f ms, max %.3f ms\n", m_RowCount, m_TotalSeconds * 1000.0 / m_RowCount,
+            m_MaxSeconds * 1000.0);
+    
+    // Print the buckets from the first that's used to the last
+    size_t firstBucket = 0;
+    while (m_BucketCounts[firstBucket] == 0) {
+        firstBucket++;
+    }
+    size_t lastBucket = cBucketCount - 1;
+    while (m_BucketCounts[lastBucket] == 0) {
+        lastBucket--;
+    }
+    for (size_t bucket = firstBucket; bucket <= lastBucket; bucket++) {
+        unsigned long bucketStart = (bucket == 0) ? 0 : 1UL << (bucket - 1);
+        if (bucket + 1 == cBucketCount) {
+            fprintf(file, "    %6lu ms and up   %8zu\n", bucketStart, m_BucketCounts[bucket]);
+        }
+        else {
+            fprintf(file, "    %6lu - %6lu ms  %8zu\n", bucketStart, 1UL << bucket, m_BucketCounts[bucket]);
+        }
+    }
+}
@@ -0,0 +1,61 @@
+//
+//  RowLatencyRecorder.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef RowLatencyRecorder_hpp
+#define RowLatencyRecorder_hpp
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "FrameData.hpp"
+
+// Measures how long each keyframe takes from its packet being demuxed to its row being written,
+// for streamed input, where that's how far the results lag the source. It passes rows on to
+// another sink, and is told about the stream's packets and keyframes by the analysis, which may
+// do that on different threads. Rows are written in the order their keyframes were decoded, so
+// each row is matched with the oldest keyframe still waiting.
+class RowLatencyRecorder : public FrameDataSink
+{
+public:
+    explicit RowLatencyRecorder(FrameDataSink *sink);
+    
+    // Notes when a packet of the stream was demuxed. pts is in the stream's time base. Only
+    // keyframe packets with timestamps are kept, and only the most recent of those, so packets
+    // whose keyframes are never matched can't pile up over a long stream.
+    void PacketDemuxed(int64_t pts, bool isKeyframe);
+    
+    // Notes that the keyframe with this presentation time is being analyzed
+    void KeyframeDecoded(int64_t pts);
+    
+    void WriteFrame(const FrameData &frameData) override;
+    bool Finish() override;
+    
+    // Prints the number of rows, the mean and longest latency, and a histogram of the latencies
+    // in power-of-two buckets of milliseconds
+    void Report(FILE *file) const;
+
+private:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+    
+    FrameDataSink*          m_Sink;
+    mutable std::mutex      m_Mutex;
+    std::deque<std::pair<int64_t, TimePoint>> m_Packets;    // Keyframes demuxed, and not yet decoded
+    std::deque<TimePoint>   m_Keyframes;        // When keyframes waiting for their rows were demuxed
+    std::vector<size_t>     m_BucketCounts;
+    size_t                  m_RowCount;
+    double                  m_TotalSeconds;
+    double                  m_MaxSeconds;
+};
+
+#endif /* RowLatencyRecorder_hpp */
@@ -0,0 +1,215 @@
+//
+//  StreamDecoder.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "StreamDecoder.hpp"
+
+#include <cassert>
+#include <cstdio>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+
+#if defined(__cplusplus)
+}
+#endif
+
+#include "CodecContextCache.hpp"
+
+
+// Returns the frame's presentation time, or the decoder's best guess at it
+static int64_t prvFrameTime(const AVFrame *frame)
+{
+    return (frame->pts != AV_NOPTS_VALUE) ? frame->pts : frame->best_effort_timestamp;
+}
+
+
+StreamDecoder::StreamDecoder() :
+m_Stream(nullptr),
+m_CodecContext(nullptr),
+m_CodecContextCache(nullptr),
+m_Frame(nullptr),
+m_KeyframesOnly(false),
+m_SawKeyframePacket(false),
+m_StartTime(INT64_MIN),
+m_EndTime(INT64_MAX),
+m_RequireKeyframeAtStart(false),
+m_SawKeyframe(false),
+m_Finished(false),
+m_Overshot(false),
+m_FrameCount(0),
+m_KeyframeCount(0)
+{
+}
+
+StreamDecoder::~StreamDecoder()
+{
+    av_frame_free(&m_Frame);
+    if (m_CodecContextCache != nullptr) {
+        m_CodecContextCache->Give(m_CodecContext, m_Stream->codecpar);
+    }
+    else {
+        avcodec_free_context(&m_CodecContext);
+    }
+}
+
+
+bool StreamDecoder::Open(AVStream *stream, bool keyframesOnly, CodecContextCache *codecContextCache, bool lowDelay)
+{
+    assert(m_CodecContext == nullptr);
+    m_Stream = stream;
+    m_KeyframesOnly = keyframesOnly;
+    
+    AVCodecParameters* streamParameters = stream->codecpar;
+    assert(!lowDelay || keyframesOnly);
+    if (lowDelay) {
+        codecContextCache = nullptr;                // A reused decoder was opened without the flag
+    }
+    if (codecContextCache != nullptr) {
+        m_CodecContext = codecContextCache->Take(streamParameters);
+        if (m_CodecContext != nullptr) {
+            m_CodecContextCache = codecContextCache;
+            m_CodecContext->skip_frame = keyframesOnly ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+            m_Frame = av_frame_alloc();
+            assert(m_Frame != nullptr);
+            return true;
+        }
+    }
+    
+    AVCodec *codec = avcodec_find_decoder(streamParameters->codec_id);
+    if (codec == NULL) {
+        fprintf(stderr, "Can't find a codec for the video stream\n");
+        return false;
+    }
+    
+    // Set up a codec context
+    m_CodecContext = avcodec_alloc_context3(codec);
+    if (m_CodecContext == NULL) {
+        fprintf(stderr, "Can't allocate a codec context for the video stream\n");
+        return false;
+    }
+    int status = avcodec_parameters_to_context(m_CodecContext, streamParameters);
+    if (status < 0) {
+        fprintf(stderr, "Can't set up a codec context for the video stream\n");
+        return false;
+    }
+    if (keyframesOnly) {
+        m_CodecContext->skip_frame = AVDISCARD_NONKEY;      // Have the decoder drop anything else it's given
+    }
+    if (lowDelay) {
+        m_CodecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    }
+    status = avcodec_open2(m_CodecContext, codec, NULL);
+    if (status < 0) {
+        fprintf(stderr, "Can't open a decoder for the video stream\n");
+        return false;
+    }
+    m_CodecContextCache = codecContextCache;       // Only opened decoders go back to the cache
+    
+    m_Frame = av_frame_alloc();
+    assert(m_Frame != nullptr);
+    return true;
+}
+
+
+void StreamDecoder::SetKeyframeRange(int64_t startTime, int64_t endTime, bool requireKeyframeAtStart)
+{
+    m_StartTime = startTime;
+    m_EndTime = endTime;
+    m_RequireKeyframeAtStart = requireKeyframeAtStart;
+}
+
+
+bool StreamDecoder::DecodePacket(const AVPacket *packet, const KeyframeHandler &handler)
+{
+    assert(packet->stream_index == m_Stream->index);
+    if (m_Finished) {
+        return false;
+    }
+    
+    bool isKeyframePacket = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+    bool sawEarlierKeyframePacket = m_SawKeyframePacket;
+    m_SawKeyframePacket = m_SawKeyframePacket || isKeyframePacket;
+    
+    // A keyframe packet past the end of the range means everything in the range has been sent
+    // to the decoder. If it's the first keyframe packet, though, the seek landed past the whole
+    // range, and the range's keyframes were never seen.
+    int64_t packetTime = (packet->pts != AV_NOPTS_VALUE) ? packet->pts : packet->dts;
+    if (isKeyframePacket && packetTime != AV_NOPTS_VALUE && packetTime >= m_EndTime) {
+        if (m_RequireKeyframeAtStart && !sawEarlierKeyframePacket && packetTime > m_StartTime) {
+            m_Overshot = true;
+        }
+        m_Finished = true;
+        return false;
+    }
+    
+    // In keyframe-only mode, packets that aren't keyframes are never decoded. Some demuxers
+    // don't flag keyframe packets, though, so packets are only filtered once a flagged one has
+    // been seen; until then, the decoder's skip_frame setting does the work.
+    bool skipPacket = m_KeyframesOnly && m_SawKeyframePacket && !isKeyframePacket;
+    if (skipPacket) {
+        return true;
+    }
+    
+    // Supply raw packet data as input to a decoder
+    int packetSendResponse = avcodec_send_packet(m_CodecContext, packet);
+    assert(packetSendResponse >= 0);
+    
+    // Get the frames from this packet
+    prvReceiveFrames(handler);
+    return !m_Finished;
+}
+
+
+void StreamDecoder::Flush(const KeyframeHandler &handler)
+{
+    if (m_Overshot) {
+        return;         // The caller will start over, so nothing more should be handled
+    }
+    
+    // A null packet puts the decoder in draining mode
+    int packetSendResponse = avcodec_send_packet(m_CodecContext, NULL);
+    if (packetSendResponse >= 0) {
+        prvReceiveFrames(handler);
+    }
+}
+
+
+void StreamDecoder::prvReceiveFrames(const KeyframeHandler &handler)
+{
+    /// \todo Improve this by making it asynchronous and using a notification callback
+    int receiveFrameResponse = avcodec_receive_frame(m_CodecContext, m_Frame);
+    while (receiveFrameResponse >= 0) {
+        m_FrameCount++;
+        
+        if (m_Frame->key_frame && !m_Overshot) {
+            int64_t frameTime = prvFrameTime(m_Frame);
+            
+            // Make sure the seek didn't land past the start of the range
+            if (!m_SawKeyframe && m_RequireKeyframeAtStart && frameTime > m_StartTime) {
+                m_Overshot = true;
+                m_Finished = true;
+            }
+            m_SawKeyframe = true;
+            
+            if (frameTime >= m_EndTime) {
+                m_Finished = true;
+            }
+            else if (frameTime >= m_StartTime && !m_Overshot) {
+                m_KeyframeCount++;
+                handler(m_Frame);
+            }
+        }
+        
+        av_frame_unref(m_Frame);
+        receiveFrameResponse = avcodec_receive_frame(m_CodecContext, m_Frame);
+    }
+}
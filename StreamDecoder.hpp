@@ -0,0 +1,83 @@
+//
+//  StreamDecoder.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef StreamDecoder_hpp
+#define StreamDecoder_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Foreward declarations
+class CodecContextCache;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct AVStream;
+
+// Decodes one video stream's packets, and hands its keyframes to a handler
+class StreamDecoder
+{
+public:
+    typedef std::function<void (AVFrame *keyframe)> KeyframeHandler;
+    
+    StreamDecoder();
+    ~StreamDecoder();
+    
+    // Sets up a decoder for the stream. If keyframesOnly is true, frames that aren't keyframes
+    // are never decoded. With a cache, a decoder left there by an earlier stream with the same
+    // parameters is reused if there is one, and the decoder is given back to the cache when this
+    // is destroyed. If lowDelay is true, the decoder is asked to hand back each frame as soon as
+    // it's decoded, rather than holding it to reorder; that's only safe when decoding just
+    // keyframes, and the cache isn't used. On failure, reports why to stderr and returns false.
+    bool Open(AVStream *stream, bool keyframesOnly, CodecContextCache *codecContextCache = nullptr,
+              bool lowDelay = false);
+    
+    AVStream*       Stream() const { return m_Stream; }
+    AVCodecContext* CodecContext() const { return m_CodecContext; }
+    
+    // Limits the keyframes handed to the handler to those with presentation times in
+    // [startTime, endTime), in the stream's time base. Decoding finishes once the stream is past
+    // endTime. If requireKeyframeAtStart is true, decoding also finishes, with Overshot()
+    // returning true, if the first keyframe decoded is after startTime, or the first keyframe
+    // packet is past endTime; that means a seek landed too late, and keyframes may have been
+    // missed.
+    void SetKeyframeRange(int64_t startTime, int64_t endTime, bool requireKeyframeAtStart);
+    
+    // Decodes a packet from this stream. Returns false once no more packets are needed.
+    bool DecodePacket(const AVPacket *packet, const KeyframeHandler &handler);
+    
+    // Gets any frames still held by the decoder
+    void Flush(const KeyframeHandler &handler);
+    
+    bool    Overshot() const { return m_Overshot; }
+    size_t  FrameCount() const { return m_FrameCount; }
+    size_t  KeyframeCount() const { return m_KeyframeCount; }
+
+private:
+    AVStream*       m_Stream;
+    AVCodecContext* m_CodecContext;
+    CodecContextCache* m_CodecContextCache;     // Where the decoder goes back to, if anywhere
+    AVFrame*        m_Frame;
+    bool            m_KeyframesOnly;
+    bool            m_SawKeyframePacket;
+    
+    int64_t         m_StartTime;
+    int64_t         m_EndTime;
+    bool            m_RequireKeyframeAtStart;
+    bool            m_SawKeyframe;
+    bool            m_Finished;
+    bool            m_Overshot;
+    
+    size_t          m_FrameCount;
+    size_t          m_KeyframeCount;
+    
+    void prvReceiveFrames(const KeyframeHandler &handler);
+};
+
+#endif /* StreamDecoder_hpp */
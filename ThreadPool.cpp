@@ -0,0 +1,119 @@
+//
+//  ThreadPool.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <cassert>
+
+
+// One ParallelFor() call. Threads claim iterations by bumping m_NextIteration, and the last
+// thread to finish one wakes the caller.
+struct ThreadPool::Loop
+{
+    size_t                  m_Count;
+    const std::function<void (size_t i)>* m_Body;
+    std::atomic<size_t>     m_NextIteration;
+    std::atomic<size_t>     m_UnfinishedCount;
+    std::mutex              m_DoneMutex;
+    std::condition_variable m_Done;
+};
+
+
+ThreadPool::ThreadPool(int threadCount) :
+m_Stopping(false)
+{
+    assert(threadCount > 0);
+    for (int i = 1; i < threadCount; i++) {
+        m_Workers.emplace_back([this]() {
+            prvWorkerLoop();
+        });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_LoopAdded.notify_all();
+    for (std::thread &worker : m_Workers) {
+        worker.join();
+    }
+}
+
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void (size_t i)> &body)
+{
+    if (count == 0) {
+        return;
+    }
+    if (count == 1 || m_Workers.empty()) {
+        for (size_t i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+    
+    std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+    loop->m_Count = count;
+    loop->m_Body = &body;
+    loop->m_NextIteration = 0;
+    loop->m_UnfinishedCount = count;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Loops.push_back(loop);
+    }
+    m_LoopAdded.notify_all();
+    
+    // Help out, then wait for iterations other threads are still running
+    prvRunIterations(*loop);
+    std::unique_lock<std::mutex> doneLock(loop->m_DoneMutex);
+    loop->m_Done.wait(doneLock, [&loop]() { return loop->m_UnfinishedCount == 0; });
+}
+
+
+void ThreadPool::prvWorkerLoop()
+{
+    for (;;) {
+        std::shared_ptr<Loop> loop;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_LoopAdded.wait(lock, [this]() { return m_Stopping || !m_Loops.empty(); });
+            if (m_Stopping) {
+                return;
+            }
+            
+            // Every iteration of the oldest loop may already be claimed; if so, drop it
+            loop = m_Loops.front();
+            if (loop->m_NextIteration >= loop->m_Count) {
+                m_Loops.pop_front();
+                continue;
+            }
+        }
+        prvRunIterations(*loop);
+    }
+}
+
+
+void ThreadPool::prvRunIterations(Loop &loop)
+{
+    for (;;) {
+        size_t i = loop.m_NextIteration++;
+        if (i >= loop.m_Count) {
+            return;
+        }
+        (*loop.m_Body)(i);
+        
+        if (--loop.m_UnfinishedCount == 0) {
+            std::lock_guard<std::mutex> lock(loop.m_DoneMutex);
+            loop.m_Done.notify_all();
+        }
+    }
+}
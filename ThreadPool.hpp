@@ -0,0 +1,54 @@
+//
+//  ThreadPool.hpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that share the iterations of parallel loops. Any number of
+// threads can run loops on the same pool at once.
+class ThreadPool
+{
+public:
+    // Starts threadCount - 1 workers; the thread calling ParallelFor() is the last one
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    // The number of threads that can run a loop's iterations, including the caller
+    int ThreadCount() const { return (int)m_Workers.size() + 1; }
+    
+    // Calls body(i) for each i in [0, count), spread across the workers and the calling thread,
+    // and returns once every call has returned. The calling thread always takes part, so a loop
+    // finishes even if every worker is busy with other loops.
+    void ParallelFor(size_t count, const std::function<void (size_t i)> &body);
+
+private:
+    struct Loop;
+    
+    std::vector<std::thread>            m_Workers;
+    std::mutex                          m_Mutex;
+    std::condition_variable             m_LoopAdded;
+    std::deque<std::shared_ptr<Loop>>   m_Loops;        // Loops with iterations not yet started
+    bool                                m_Stopping;
+    
+    void prvWorkerLoop();
+    static void prvRunIterations(Loop &loop);
+};
+
+#endif /* ThreadPool_hpp */
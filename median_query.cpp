@@ -0,0 +1,387 @@
+//
+//  median_query.cpp
+//  sample_p
+//
+//  Created by Bob Murphy on 10/17/26.
+//  Copyright © 2026 Nashi Software. All rights reserved.
+//
+
+// median_query answers questions about the median files sample_p writes with --format binary,
+// reading them in place through memory maps rather than parsing CSV text. It also decodes the
+// delta files written with --format delta, and follows the median rings published with --format
+// ring.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "CsvWriter.hpp"
+#include "DeltaFileReader.hpp"
+#include "FrameData.hpp"
+#include "MedianFileReader.hpp"
+#include "MedianQuery.hpp"
+#include "MedianRingReader.hpp"
+
+
+#pragma mark - Command line
+
+enum class QueryKind {
+    None,
+    Above,          // Keyframes where a cell's median is over a threshold
+    MinMax,         // Each cell's lowest and highest median
+    Nearest,        // The keyframe nearest a time
+    Dump,           // Everything, as sample_p's CSV
+    Info,           // The header
+    Follow          // A median ring's keyframes as they're published, as sample_p's CSV
+};
+
+struct QueryArguments
+{
+    QueryKind   m_Kind = QueryKind::None;
+    int         m_Row = 0;
+    int         m_Col = 0;
+    int         m_Threshold = 0;
+    double      m_NearestTime = 0.0;
+    double      m_FromTime = -INFINITY;
+    double      m_ToTime = INFINITY;
+    std::vector<std::string> m_Filepaths;
+};
+
+static void usage(const char* exeName)
+{
+    fprintf(stderr, "Usage: %s <query> [--from <seconds>] [--to <seconds>] <median file>...\n"
+                    "Queries: --above <row>,<col>,<threshold>\n"
+                    "         --minmax\n"
+                    "         --nearest <seconds>\n"
+                    "         --dump\n"
+                    "         --info\n"
+                    "   or: %s --follow [--from <seconds>] [--to <seconds>] <median ring name>\n", exeName, exeName);
+    exit(-1);
+}
+
+// Parses a number of seconds, returning false if the string isn't one
+static bool prvParseSeconds(const char *secondsStr, double &seconds)
+{
+    char *end = nullptr;
+    seconds = strtod(secondsStr, &end);
+    return end != secondsStr && *end == '\0' && !std::isnan(seconds);
+}
+
+static struct option sLongLoptions[] =
+{
+    {    "above",     required_argument, NULL, 'a'    },
+    {    "minmax",    no_argument,       NULL, 'm'    },
+    {    "nearest",   required_argument, NULL, 'n'    },
+    {    "dump",      no_argument,       NULL, 'd'    },
+    {    "info",      no_argument,       NULL, 'I'    },
+    {    "follow",    no_argument,       NULL, 'F'    },
+    {    "from",      required_argument, NULL, 'f'    },
+    {    "to",        required_argument, NULL, 't'    },
+    {     NULL, 0, NULL, 0                        }
+};
+
+static QueryArguments prvProcessCommandLine(int argc, char **argv)
+{
+    QueryArguments result;
+    bool errorFound = false;
+    int queryCount = 0;
+    
+    int ch = getopt_long(argc, argv, "a:mn:dIFf:t:", sLongLoptions, NULL);
+    while (ch != -1)
+    {
+        switch (ch)
+        {
+                // Cell over a threshold
+            case 'a': {
+                result.m_Kind = QueryKind::Above;
+                queryCount++;
+                std::regex aboveRegex("(\\d{1,9}),(\\d{1,9}),(\\d{1,3})", std::regex_constants::ECMAScript);
+                std::cmatch cmatch;
+                if (!std::regex_match(optarg, cmatch, aboveRegex) || atoi(cmatch[3].str().c_str()) > 255) {
+                    fprintf(stderr, "Invalid cell and threshold \"%s\"\n", optarg);
+                    errorFound = true;
+                }
+                else {
+                    result.m_Row = atoi(cmatch[1].str().c_str());
+                    result.m_Col = atoi(cmatch[2].str().c_str());
+                    result.m_Threshold = atoi(cmatch[3].str().c_str());
+                }
+                break;
+            }
+                
+                // Per-cell extremes
+            case 'm':
+                result.m_Kind = QueryKind::MinMax;
+                queryCount++;
+                break;
+                
+                // Nearest keyframe
+            case 'n':
+                result.m_Kind = QueryKind::Nearest;
+                queryCount++;
+                if (!prvParseSeconds(optarg, result.m_NearestTime)) {
+                    fprintf(stderr, "Invalid time \"%s\"\n", optarg);
+                    errorFound = true;
+                }
+                break;
+                
+                // Whole file as CSV
+            case 'd':
+                result.m_Kind = QueryKind::Dump;
+                queryCount++;
+                break;
+                
+                // Header
+            case 'I':
+                result.m_Kind = QueryKind::Info;
+                queryCount++;
+                break;
+                
+                // Median ring
+            case 'F':
+                result.m_Kind = QueryKind::Follow;
+                queryCount++;
+                break;
+                
+                // Time range
+            case 'f':
+                if (!prvParseSeconds(optarg, result.m_FromTime)) {
+                    fprintf(stderr, "Invalid start time \"%s\"\n", optarg);
+                    errorFound = true;
+                }
+                break;
+            case 't':
+                if (!prvParseSeconds(optarg, result.m_ToTime)) {
+                    fprintf(stderr, "Invalid end time \"%s\"\n", optarg);
+                    errorFound = true;
+                }
+                break;
+            
+            default:
+                usage(argv[0]);
+                break;
+        }
+        
+        // Prepare for the next iteration
+        ch = getopt_long(argc, argv, "a:mn:dIFf:t:", sLongLoptions, NULL);
+    }
+    
+    for (int i = optind; i < argc; i++) {
+        result.m_Filepaths.push_back(argv[i]);
+    }
+    
+    if (queryCount != 1) {
+        fprintf(stderr, "Give exactly one query\n");
+        errorFound = true;
+    }
+    if (result.m_Filepaths.empty()) {
+        fprintf(stderr, "No median files\n");
+        errorFound = true;
+    }
+    else if (result.m_Kind == QueryKind::Follow && result.m_Filepaths.size() != 1) {
+        fprintf(stderr, "--follow takes one median ring\n");
+        errorFound = true;
+    }
+    if (result.m_FromTime > result.m_ToTime) {
+        fprintf(stderr, "The start time is after the end time\n");
+        errorFound = true;
+    }
+    if (errorFound) {
+        usage(argv[0]);
+    }
+    return result;
+}
+
+
+#pragma mark - Queries
+
+static FrameData prvFrameData(const MedianFileReader &reader, size_t frameIndex)
+{
+    FrameData frameData;
+    frameData.m_Timestamp = reader.Timestamps()[frameIndex];
+    const uint8_t *row = reader.Row(frameIndex);
+    frameData.m_CellGrayMedians.assign(row, row + reader.CellCount());
+    return frameData;
+}
+
+// Each query prints one or more lines per file, starting with the file's path, except for
+// --dump, which prints exactly what sample_p would have
+static bool prvRunQuery(const QueryArguments &args, const MedianFileReader &reader)
+{
+    const MedianFileHeader &header = reader.Header();
+    const char *filepath = reader.Filepath().c_str();
+    size_t firstFrame = reader.LowerBound(args.m_FromTime);
+    size_t endFrame = std::max(firstFrame, reader.UpperBound(args.m_ToTime));
+    
+    switch (args.m_Kind) {
+        case QueryKind::Above: {
+            if ((uint32_t)args.m_Row >= header.m_GridRows || (uint32_t)args.m_Col >= header.m_GridCols) {
+                fprintf(stderr, "\"%s\" has no cell %d,%d in its %ux%u grid\n", filepath, args.m_Row, args.m_Col,
+                        header.m_GridRows, header.m_GridCols);
+                return false;
+            }
+            size_t cell = (size_t)args.m_Row * header.m_GridCols + args.m_Col;
+            std::vector<size_t> frames;
+            FindFramesAbove(reader, cell, (uint8_t)args.m_Threshold, firstFrame, endFrame, frames);
+            for (size_t frame : frames) {
+                printf("%s,%g,%d\n", filepath, reader.Timestamps()[frame], reader.Row(frame)[cell]);
+            }
+            break;
+        }
+        
+        case QueryKind::MinMax: {
+            if (firstFrame == endFrame) {       // Nothing to report
+                break;
+            }
+            std::vector<uint8_t> mins(reader.CellCount(), 255);
+            std::vector<uint8_t> maxes(reader.CellCount(), 0);
+            AccumulateCellMinMax(reader, firstFrame, endFrame, mins.data(), maxes.data());
+            printf("%s,min", filepath);
+            for (uint8_t value : mins) {
+                printf(",%d", value);
+            }
+            printf("\n%s,max", filepath);
+            for (uint8_t value : maxes) {
+                printf(",%d", value);
+            }
+            printf("\n");
+            break;
+        }
+        
+        case QueryKind::Nearest: {
+            if (reader.FrameCount() == 0) {
+                break;
+            }
+            FrameData frameData = prvFrameData(reader, reader.Nearest(args.m_NearestTime));
+            std::unique_ptr<char[]> line(new char[CsvWriter::MaxLineSize(reader.CellCount())]);
+            size_t lineLength = CsvWriter::FormatLine(frameData, line.get());
+            printf("%s,%.*s", filepath, (int)lineLength, line.get());
+            break;
+        }
+        
+        case QueryKind::Dump: {
+            CsvWriter csvWriter(stdout);
+            for (size_t frame = firstFrame; frame < endFrame; frame++) {
+                csvWriter.WriteFrame(prvFrameData(reader, frame));
+            }
+            if (!csvWriter.Finish()) {
+                return false;
+            }
+            break;
+        }
+        
+        case QueryKind::Info:
+            printf("%s: %ux%u grid, %llu keyframes", filepath, header.m_GridRows, header.m_GridCols,
+                   (unsigned long long)header.m_FrameCount);
+            if (header.m_FrameCount > 0) {
+                printf(" from %g to %g seconds", reader.Timestamps()[0], reader.Timestamps()[reader.FrameCount() - 1]);
+            }
+            printf("\n    Source: \"%.*s\", stream %d, %dx%d %.*s, time base %d/%d\n",
+                   (int)sizeof(header.m_SourcePath), header.m_SourcePath, header.m_StreamIndex,
+                   header.m_SourceWidth, header.m_SourceHeight, (int)sizeof(header.m_CodecName), header.m_CodecName,
+                   header.m_TimeBaseNum, header.m_TimeBaseDen);
+            break;
+        
+        case QueryKind::Follow:
+        case QueryKind::None:
+            break;
+    }
+    return true;
+}
+
+
+// Delta files have to be decoded from a full row on, so they only answer --dump and --info
+static bool prvRunDeltaQuery(const QueryArguments &args, const std::string &filepath)
+{
+    DeltaFileReader reader;
+    if (!reader.Open(filepath)) {
+        return false;
+    }
+    const DeltaFileHeader &header = reader.Header();
+    switch (args.m_Kind) {
+        case QueryKind::Dump: {
+            CsvWriter csvWriter(stdout);
+            bool decoded = reader.Decode(csvWriter, args.m_FromTime, args.m_ToTime);
+            return csvWriter.Finish() && decoded;
+        }
+        
+        case QueryKind::Info:
+            printf("%s: %ux%u grid, delta encoded with a full row at least every %u keyframes%s\n", filepath.c_str(),
+                   header.m_GridRows, header.m_GridCols, header.m_FullRowInterval,
+                   reader.IsComplete() ? "" : ", cut short");
+            return true;
+        
+        default:
+            fprintf(stderr, "\"%s\" is a delta file, which only answers --dump and --info\n", filepath.c_str());
+            return false;
+    }
+}
+
+
+// Prints a median ring's keyframes as sample_p's CSV, from the oldest still in the ring, waiting
+// for each to be published until the writer finishes. Keyframes overwritten before they could be
+// read are skipped, and counted.
+static bool prvFollowRing(const QueryArguments &args, const std::string &ringName)
+{
+    MedianRingReader reader;
+    if (!reader.Open(ringName)) {
+        return false;
+    }
+    CsvWriter csvWriter(stdout, CsvFlushPolicy::EveryFrame);
+    FrameData frameData;
+    uint64_t number = reader.OldestAvailable();
+    uint64_t missedCount = 0;
+    while (reader.WaitFor(number)) {
+        if (reader.Read(number, frameData) == MedianRingReader::ReadStatus::Ready) {
+            if (frameData.m_Timestamp >= args.m_FromTime && frameData.m_Timestamp <= args.m_ToTime) {
+                csvWriter.WriteFrame(frameData);
+            }
+            number++;
+        }
+        else {                  // Published, so it was overwritten; go on from the oldest left
+            uint64_t oldest = std::max(reader.OldestAvailable(), number + 1);
+            missedCount += oldest - number;
+            number = oldest;
+        }
+    }
+    if (missedCount > 0) {
+        fprintf(stderr, "%llu keyframes in \"%s\" were overwritten before they could be read\n",
+                (unsigned long long)missedCount, ringName.c_str());
+    }
+    return csvWriter.Finish() && missedCount == 0;
+}
+
+
+#pragma mark - main()
+
+int main(int argc, char **argv)
+{
+    QueryArguments args = prvProcessCommandLine(argc, argv);
+    if (args.m_Kind == QueryKind::Follow) {
+        bool followed = prvFollowRing(args, args.m_Filepaths.front());
+        exit((followed && fflush(stdout) == 0) ? 0 : -1);
+    }
+    
+    // Answer the query for each file in turn. Files that can't be read are reported and skipped.
+    bool succeeded = true;
+    for (const std::string &filepath : args.m_Filepaths) {
+        if (DeltaFileReader::IsDeltaFile(filepath)) {
+            succeeded = prvRunDeltaQuery(args, filepath) && succeeded;
+        }
+        else {
+            MedianFileReader reader;
+            succeeded = reader.Open(filepath) && prvRunQuery(args, reader) && succeeded;
+        }
+    }
+    
+    if (fflush(stdout) != 0) {
+        succeeded = false;
+    }
+    return succeeded ? 0 : -1;
+}
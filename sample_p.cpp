@@ -7,8 +7,11 @@
 #include <string.h>
 #include <string>
 #include <vector>
-#include <iostream>
-#include <fstream>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <sys/stat.h>
 
 
 #if defined(__cplusplus)
@@ -24,8 +27,21 @@ extern "C" {
 }
 #endif
 
+#include "AnalysisDaemon.hpp"
+#include "CodecContextCache.hpp"
 #include "CommandLine.h"
-#include "FrameProcessor.hpp"
+#include "CsvBenchmark.hpp"
+#include "CsvWriter.hpp"
+#include "DeadlineScheduler.hpp"
+#include "DeltaFileWriter.hpp"
+#include "ElapsedTime.hpp"
+#include "GridSplitter.hpp"
+#include "MedianFileWriter.hpp"
+#include "MedianRingWriter.hpp"
+#include "MovieAnalysis.hpp"
+#include "MovieReader.hpp"
+#include "RowLatencyRecorder.hpp"
+#include "ThreadPool.hpp"
 
 #if 0       // Enable when needed
 #define LOG printf
@@ -34,152 +50,484 @@ inline void LOG(...) {}
 #endif
 
 
-#pragma mark - main()
+#pragma mark - Output
 
-// Returns whether this should be called again to try to process video frames on the same packet
-static void prvProcessPacket(FrameProcessor &frameProcessor, AVPacket *packet,
-                             AVCodecContext *codecContext, AVFrame *frame,
-                             size_t &frameCount, size_t &keyframeCount)
+// Describes a grid, and where its results came from, for median files and rings
+static MedianFileHeader prvSourceHeader(const CommandLineArguments &cliArgs, const GridSize &grid, AVStream *stream)
 {
-    // Supply raw packet data as input to a decoder
-    int packetSendResponse = avcodec_send_packet(codecContext, packet);
-    assert(packetSendResponse >= 0);
-    
-    // Get the frames from this packet
-    /// \todo Improve this by making it asynchronous and using a notification callback
-    int receiveFrameResponse = avcodec_receive_frame(codecContext, frame);
-    while (receiveFrameResponse >= 0) {
-        frameCount++;
-        
-        if (frame->key_frame) {
-            keyframeCount++;
-            LOG("Keyframe %zu at sample %zu\n", keyframeCount, frameCount);
-            frameProcessor.ProcessKeyFrame(frame);
+    MedianFileHeader sourceHeader;
+    memset(&sourceHeader, 0, sizeof(sourceHeader));
+    sourceHeader.m_GridRows = grid.m_Rows;
+    sourceHeader.m_GridCols = grid.m_Cols;
+    sourceHeader.m_TimeBaseNum = stream->time_base.num;
+    sourceHeader.m_TimeBaseDen = stream->time_base.den;
+    sourceHeader.m_StreamStartTime = stream->start_time;
+    sourceHeader.m_StreamIndex = stream->index;
+    sourceHeader.m_SourceWidth = stream->codecpar->width;
+    sourceHeader.m_SourceHeight = stream->codecpar->height;
+    strncpy(sourceHeader.m_CodecName, avcodec_get_name(stream->codecpar->codec_id),
+            sizeof(sourceHeader.m_CodecName) - 1);
+    strncpy(sourceHeader.m_SourcePath, cliArgs.m_InputFilepath.c_str(), sizeof(sourceHeader.m_SourcePath) - 1);
+    return sourceHeader;
+}
+
+
+// Opens the output for one stream and grid in the requested format. CSV and delta files go to a
+// file, or to defaultOutputFile if no output path was given; outputFile is set to that file. A
+// median ring is named by the output path.
+static std::unique_ptr<FrameDataSink> prvOpenOutput(const CommandLineArguments &cliArgs,
+                                                    const std::string &streamOutputFilepath, size_t gridIndex,
+                                                    AVStream *stream, FILE *defaultOutputFile, FILE *&outputFile)
+{
+    const GridSize &grid = cliArgs.m_Grids[gridIndex];
+    std::string outputFilepath = GridOutputFilepath(streamOutputFilepath, cliArgs.m_Grids, gridIndex);
+    std::unique_ptr<FrameDataSink> output;
+    outputFile = nullptr;
+    if (cliArgs.m_OutputFormat == OutputFormat::Csv || cliArgs.m_OutputFormat == OutputFormat::Delta) {
+        outputFile = defaultOutputFile;
+        if (!outputFilepath.empty()) {
+            outputFile = fopen(outputFilepath.c_str(), (cliArgs.m_OutputFormat == OutputFormat::Csv) ? "w" : "wb");
+            if (outputFile == NULL) {
+                fprintf(stderr, "Can't write output file at \"%s\"\n", outputFilepath.c_str());
+                return nullptr;
+            }
         }
-        
-        receiveFrameResponse = avcodec_receive_frame(codecContext, frame);
     }
+    
+    switch (cliArgs.m_OutputFormat) {
+        case OutputFormat::Csv:
+            output.reset(new CsvWriter(outputFile, cliArgs.m_FlushPolicy, cliArgs.m_DeadlineMilliseconds > 0));
+            break;
+            
+        case OutputFormat::Delta:
+            output.reset(new DeltaFileWriter(outputFile, grid.m_Rows, grid.m_Cols, cliArgs.m_FullRowInterval));
+            break;
+            
+        case OutputFormat::Binary: {
+            MedianFileWriter *medianFileWriter = new MedianFileWriter;
+            output.reset(medianFileWriter);
+            if (!medianFileWriter->Open(outputFilepath, prvSourceHeader(cliArgs, grid, stream))) {
+                return nullptr;
+            }
+            break;
+        }
+            
+        case OutputFormat::Ring: {
+            MedianRingWriter *medianRingWriter = new MedianRingWriter;
+            output.reset(medianRingWriter);
+            if (!medianRingWriter->Open(outputFilepath, prvSourceHeader(cliArgs, grid, stream),
+                                        (uint32_t)cliArgs.m_RingSlotCount)) {
+                return nullptr;
+            }
+            break;
+        }
+    }
+    return output;
 }
 
 
-int main(int argc, char **argv)
+#pragma mark - Statistics
+
+// Passes results on to another sink, noting when the first one arrives, for --stats
+class FirstRowTimer : public FrameDataSink
 {
+public:
+    FirstRowTimer(FrameDataSink *sink, std::chrono::steady_clock::time_point startTime) :
+    m_Sink(sink),
+    m_StartTime(startTime),
+    m_FirstRowSeconds(-1.0)
+    {
+    }
+    
+    void WriteFrame(const FrameData &frameData) override
+    {
+        if (m_FirstRowSeconds < 0.0) {
+            m_FirstRowSeconds = SecondsSince(m_StartTime);
+        }
+        m_Sink->WriteFrame(frameData);
+    }
+    
+    bool Finish() override  { return m_Sink->Finish(); }
+    
+    // Seconds from the start until the first row was written, or a negative number if none was
+    double FirstRowSeconds() const { return m_FirstRowSeconds; }
 
-    // Interpret the command line arguments
-    CommandLineArguments cliArgs = ProcessCommandLine(argc, argv);
+private:
+    FrameDataSink*  m_Sink;
+    std::chrono::steady_clock::time_point m_StartTime;
+    double          m_FirstRowSeconds;
+};
+
+
+// Reports how many of each grid's pixels per cell a sample budget counts in the main stream, and
+// how far that can put the medians' ranks from the exact ones
+static void prvReportSampling(const CommandLineArguments &cliArgs, AVStream *stream)
+{
+    int w = stream->codecpar->width;
+    int h = stream->codecpar->height;
+    for (const GridSize &grid : cliArgs.m_Grids) {
+        int cellRows = (h + grid.m_Rows - 1) / grid.m_Rows;
+        int cellCols = (w + grid.m_Cols - 1) / grid.m_Cols;
+        int strataRows = 0;
+        int strataCols = 0;
+        FrameProcessor::SampleLattice(cellRows, cellCols, cliArgs.m_ProcessorOptions.m_SampleBudget,
+                                      strataRows, strataCols);
+        size_t pixelCount = (size_t)cellRows * (size_t)cellCols;
+        size_t sampleCount = (size_t)strataRows * (size_t)strataCols;
+        double rankErrorBound = FrameProcessor::RankErrorBound(sampleCount, pixelCount);
+        fprintf(stderr, "Sampling %dx%d:  %zu of %zu pixels per cell; median rank within %.2f%% (%.0f pixels)"
+                " with %.0f%% confidence\n", grid.m_Rows, grid.m_Cols, sampleCount, pixelCount,
+                rankErrorBound * 100.0, rankErrorBound * pixelCount, cRankErrorConfidence * 100.0);
+    }
+}
+
+
+// Reports where the time went, to stderr, and how far the rows lagged streamed input and how
+// they met their deadlines, if those were measured. Times are summed across segments and streams,
+// so with more than one they can add up to more than the elapsed time.
+static void prvReportStats(const CommandLineArguments &cliArgs, const MovieReader &movieReader,
+                           const std::vector<Segment> &segments, double firstRowSeconds, double elapsedSeconds,
+                           const RowLatencyRecorder *rowLatency, const DeadlineStats *deadlineStats)
+{
+    double readSeconds = 0.0;
+    double ioWaitSeconds = 0.0;
+    double decodeSeconds = 0.0;
+    double analysisSeconds = 0.0;
+    for (const Segment &segment : segments) {
+        readSeconds += segment.m_ReadSeconds;
+        ioWaitSeconds += segment.m_IOWaitSeconds;
+        for (const SegmentStream &segmentStream : segment.m_Streams) {
+            decodeSeconds += segmentStream.m_DecodeSeconds;
+            analysisSeconds += segmentStream.m_AnalysisSeconds;
+        }
+    }
+    
+    const char *probeDescription = "";
+    switch (movieReader.Probe()) {
+        case StreamProbe::Full:     probeDescription = "probing fully";                     break;
+        case StreamProbe::Headers:  probeDescription = "from the headers, without probing"; break;
+        case StreamProbe::Bounded:  probeDescription = "probing the start of the file";     break;
+        case StreamProbe::FellBack: probeDescription = "probing fully after a fast start";  break;
+    }
+    fprintf(stderr, "Opening:        %8.3f s, %s\n", movieReader.OpenSeconds(), probeDescription);
+    if (cliArgs.m_InputIOMode == InputIOMode::Ffmpeg) {
+        fprintf(stderr, "Input I/O wait:  not measured; use --io mmap or --io readahead\n");
+    }
+    else {
+        fprintf(stderr, "Input I/O wait: %8.3f s\n", ioWaitSeconds);
+    }
+    fprintf(stderr, "Demuxing:       %8.3f s, including I/O wait\n", readSeconds);
+    fprintf(stderr, "Decoding:       %8.3f s\n", decodeSeconds);
+    fprintf(stderr, "Analysis:       %8.3f s%s\n", analysisSeconds,
+            (cliArgs.m_PipelineOptions.m_WorkerCount > 0) ? ", waiting for workers" : "");
+    if (firstRowSeconds >= 0.0) {
+        fprintf(stderr, "First row:      %8.3f s after starting\n", firstRowSeconds);
+    }
+    fprintf(stderr, "Elapsed:        %8.3f s\n", elapsedSeconds);
+    if (cliArgs.m_ProcessorOptions.m_SampleBudget > 0 && !segments.empty()) {
+        prvReportSampling(cliArgs, movieReader.Stream(segments.front().m_Streams.front().m_StreamIndex));
+    }
+    if (deadlineStats != nullptr) {
+        deadlineStats->Report(stderr);
+    }
+    if (rowLatency != nullptr) {
+        rowLatency->Report(stderr);
+    }
+}
+
+
+#pragma mark - Movies
+
+// The parts of the arguments that say how the streams are analyzed
+static AnalysisOptions prvAnalysisOptions(const CommandLineArguments &cliArgs)
+{
+    AnalysisOptions options;
+    options.m_InputFilepath = cliArgs.m_InputFilepath;
+    options.m_Grids = cliArgs.m_Grids;
+    options.m_ProcessorOptions = cliArgs.m_ProcessorOptions;
+    options.m_PipelineOptions = cliArgs.m_PipelineOptions;
+    options.m_KeyframesOnly = cliArgs.m_KeyframesOnly;
+    options.m_SegmentCount = cliArgs.m_SegmentCount;
+    options.m_InputIOMode = cliArgs.m_InputIOMode;
+    options.m_FastStart = cliArgs.m_FastStart;
+    options.m_DeadlineSeconds = cliArgs.m_DeadlineMilliseconds / 1000.0;
+    options.m_DeadlineMode = cliArgs.m_DeadlineMode;
+    return options;
+}
+
+
+// Analyzes the input movie named in the arguments into their output, or into defaultOutputFile
+// if they don't name one. Decoders are reused from the cache, if there is one. On failure,
+// reports why to stderr and returns false.
+static bool prvAnalyzeMovie(const CommandLineArguments &cliArgs, FILE *defaultOutputFile = stdout,
+                            CodecContextCache *codecContextCache = nullptr)
+{
     LOG("Input file: \"%s\"\n", cliArgs.m_InputFilepath.c_str());
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
     
     
     // Open the input file and determine its format
-    AVFormatContext *formatContext = avformat_alloc_context();
-    avformat_open_input(&formatContext,
-                        cliArgs.m_InputFilepath.c_str(),
-                        NULL,           // Auto-detect the format
-                        NULL);          // Don't use any private options
+    MovieReader movieReader;
+    if (!movieReader.Open(cliArgs.m_InputFilepath, cliArgs.m_InputIOMode, cliArgs.m_FastStart)) {
+        return false;
+    }
+    AVFormatContext *formatContext = movieReader.FormatContext();
     LOG("Format %s, duration %lld µs (%f sec.)\n", formatContext->iformat->long_name,
            formatContext->duration, (double)formatContext->duration / (double)AV_TIME_BASE);
     
     
-    // Look for video streams. It's unlikely there will be more than one, and this code only
-    // pays attention to the first one, but it could be extended to handle multiple video streams.
-    std::vector<int> videoStreamIndices;
-    avformat_find_stream_info(formatContext,  NULL);
-    for (int i = 0; i < formatContext->nb_streams; i++) {
-        AVStream* thisStream = formatContext->streams[i];
-        if (thisStream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-            videoStreamIndices.push_back(i);
-        }
-    }
+    // Look for video streams. Only the first one is analyzed, unless --all-streams asks for all
+    // of them; they're demuxed together, and each is decoded on its own thread.
+    const std::vector<int> &videoStreamIndices = movieReader.VideoStreamIndices();
     if (videoStreamIndices.empty()) {
-        fprintf(stderr, "No video found\n");
-        exit(-1);
+        fprintf(stderr, "No video found in \"%s\"\n", cliArgs.m_InputFilepath.c_str());
+        return false;
     }
-    if (videoStreamIndices.size() > 1) {
-        fprintf(stderr, "%zu video streams found; only the first will be analyzed\n", videoStreamIndices.size());
+    std::vector<int> streamIndices(1, videoStreamIndices.front());
+    if (cliArgs.m_AllStreams) {
+        streamIndices = videoStreamIndices;
+        if (!ValidateStreamOutputs(cliArgs, streamIndices)) {
+            return false;
+        }
+    }
+    else if (videoStreamIndices.size() > 1) {
+        fprintf(stderr, "%zu video streams found; only the first will be analyzed (use --all-streams for all)\n",
+                videoStreamIndices.size());
     }
     
     
-    // Determine information about the first video stream
-    int mainVideoStreamIndex = videoStreamIndices.front();
-    AVStream* mainVideoStream = formatContext->streams[mainVideoStreamIndex];
-    LOG("Main video stream has %lld frames\n", mainVideoStream->nb_frames);
-    AVCodecParameters* mainVideoStreamParameters = mainVideoStream->codecpar;
-    int imageWidth = mainVideoStreamParameters->width;
-    int imageHeight = mainVideoStreamParameters->height;
-    LOG("Video image size: %dx%d\n", imageWidth, imageHeight);
-    if (imageWidth < cliArgs.m_Cols || imageHeight < cliArgs.m_Rows) {
-        fprintf(stderr, "Video image is smaller smaller than the grid\n");
-        exit(-1);
+    // Determine information about the video streams
+    for (int streamIndex : streamIndices) {
+        AVStream* videoStream = movieReader.Stream(streamIndex);
+        LOG("Video stream %d has %lld frames\n", streamIndex, videoStream->nb_frames);
+        AVCodecParameters* videoStreamParameters = videoStream->codecpar;
+        int imageWidth = videoStreamParameters->width;
+        int imageHeight = videoStreamParameters->height;
+        LOG("Video image size: %dx%d\n", imageWidth, imageHeight);
+        for (const GridSize &grid : cliArgs.m_Grids) {
+            if (imageWidth < grid.m_Cols || imageHeight < grid.m_Rows) {
+                fprintf(stderr, "Video image is smaller smaller than the grid\n");
+                return false;
+            }
+        }
     }
-    AVCodec *codec = avcodec_find_decoder(mainVideoStreamParameters->codec_id);
-    if (codec == NULL) {
-        fprintf(stderr, "Can't find a codec for the video stream\n");
-        exit(-1);
+    
+    
+    // Open an output for each stream and grid. Each keyframe's results are written as soon as
+    // they're known. With several grids, the frame processors find all their medians at once, and
+    // a splitter per stream hands each grid's to its output.
+    std::vector<std::unique_ptr<FrameDataSink>> outputs;
+    std::vector<FILE*> outputFiles;
+    std::vector<std::unique_ptr<GridSplitter>> gridSplitters;
+    std::vector<FrameDataSink*> streamOutputs;
+    bool succeeded = true;
+    for (size_t i = 0; i < streamIndices.size() && succeeded; i++) {
+        AVStream* videoStream = movieReader.Stream(streamIndices[i]);
+        std::string streamOutputFilepath = cliArgs.m_AllStreams ?
+            StreamOutputFilepath(cliArgs.m_OutputFilepath, streamIndices[i]) : cliArgs.m_OutputFilepath;
+        std::vector<FrameDataSink*> gridOutputs;
+        for (size_t j = 0; j < cliArgs.m_Grids.size() && succeeded; j++) {
+            outputFiles.push_back(nullptr);
+            outputs.push_back(prvOpenOutput(cliArgs, streamOutputFilepath, j, videoStream, defaultOutputFile,
+                                            outputFiles.back()));
+            gridOutputs.push_back(outputs.back().get());
+            succeeded = (outputs.back() != nullptr);
+        }
+        if (gridOutputs.size() > 1) {
+            gridSplitters.emplace_back(new GridSplitter(cliArgs.m_Grids, gridOutputs));
+            streamOutputs.push_back(gridSplitters.back().get());
+        }
+        else {
+            streamOutputs.push_back(gridOutputs.front());
+        }
     }
     
+    // With --stats, note when the main stream's first row is written
+    std::unique_ptr<FirstRowTimer> firstRowTimer;
+    if (succeeded && cliArgs.m_ReportStats) {
+        firstRowTimer.reset(new FirstRowTimer(streamOutputs.front(), startTime));
+        streamOutputs.front() = firstRowTimer.get();
+    }
     
-    // Set up a codec context
-    AVCodecContext *codecContext = avcodec_alloc_context3(codec);
-    if (codecContext == NULL) {
-        fprintf(stderr, "Can't allocate a codec context for the video stream\n");
-        exit(-1);
+    // With --stats on streamed input, also measure how long each of the main stream's rows takes
+    // from its keyframe arriving
+    std::unique_ptr<RowLatencyRecorder> rowLatency;
+    if (succeeded && cliArgs.m_ReportStats && cliArgs.m_InputIOMode == InputIOMode::Stream) {
+        rowLatency.reset(new RowLatencyRecorder(streamOutputs.front()));
+        streamOutputs.front() = rowLatency.get();
     }
-    int status = avcodec_parameters_to_context(codecContext, mainVideoStreamParameters);
-    assert(status >= 0);
-    status = avcodec_open2(codecContext, codec, NULL);
-    assert(status >= 0);
     
+    // Analyze the streams, then close the outputs whether or not that worked
+    std::vector<Segment> segments;
+    DeadlineStats deadlineStats;
+    bool reportsDeadlines = cliArgs.m_ReportStats && cliArgs.m_DeadlineMilliseconds > 0;
+    if (succeeded) {
+        AnalysisOptions options = prvAnalysisOptions(cliArgs);
+        options.m_CodecContextCache = codecContextCache;
+        options.m_RowLatency = rowLatency.get();
+        options.m_DeadlineStats = reportsDeadlines ? &deadlineStats : nullptr;
+        succeeded = AnalyzeStreams(movieReader, streamIndices, options, streamOutputs, segments);
+    }
+    double firstRowSeconds = firstRowTimer ? firstRowTimer->FirstRowSeconds() : -1.0;
+    firstRowTimer.reset();
+    gridSplitters.clear();
+    outputs.clear();
+    for (FILE *outputFile : outputFiles) {
+        if (outputFile != nullptr && outputFile != defaultOutputFile) {
+            fclose(outputFile);
+        }
+    }
     
-    // Set up a frame and a packet
-    AVFrame *frame = av_frame_alloc();
-    assert(frame != nullptr);
-    AVPacket *packet = av_packet_alloc();
-    assert(packet != nullptr);
+    if (succeeded && cliArgs.m_ReportStats) {
+        prvReportStats(cliArgs, movieReader, segments, firstRowSeconds, SecondsSince(startTime), rowLatency.get(),
+                       reportsDeadlines ? &deadlineStats : nullptr);
+    }
+    return succeeded;
+}
 
+
+#pragma mark - Batches
+
+// The arguments for one job of a batch, or of the daemon. Its frames' bands are analyzed on the
+// threads shared by every job.
+static CommandLineArguments prvJobArguments(const CommandLineArguments &cliArgs, const BatchJob &job,
+                                            ThreadPool &threadPool)
+{
+    CommandLineArguments jobArgs = cliArgs;
+    jobArgs.m_BatchJobs.clear();
+    jobArgs.m_InputFilepath = job.m_InputFilepath;
+    jobArgs.m_Grids = job.m_Grids;
+    jobArgs.m_OutputFilepath = job.m_OutputFilepath;
+    jobArgs.m_ProcessorOptions.m_BandThreadPool = &threadPool;
+    jobArgs.m_ReportStats = false;          // The batch or daemon reports on each job instead
+    return jobArgs;
+}
+
+
+// Runs every job in the batch, and returns true if they all succeeded. The jobs share one pool of
+// threads: each thread takes the next job that hasn't started, and threads without a job help
+// analyze the bands of the frames of jobs still running. Jobs start largest file first, so the
+// longest ones aren't left running alone at the end.
+static bool prvRunBatch(const CommandLineArguments &cliArgs)
+{
+    std::vector<BatchJob> jobs = cliArgs.m_BatchJobs;
+    std::vector<off_t> fileSizes;
+    for (const BatchJob &job : jobs) {
+        struct stat statbuf;
+        fileSizes.push_back((stat(job.m_InputFilepath.c_str(), &statbuf) == 0) ? statbuf.st_size : 0);
+    }
+    std::vector<size_t> order(jobs.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&fileSizes](size_t a, size_t b) {
+        return fileSizes[a] > fileSizes[b];
+    });
     
-    // Set up a frame processor
-    FrameProcessor frameProcessor(mainVideoStream, codecContext, cliArgs.m_Rows, cliArgs.m_Cols);
-    
-    // Process all the packets to look for frames
-    size_t frameCount = 0;
-    size_t keyframeCount = 0;
-    int frameReadStatus = av_read_frame(formatContext, packet);
-    while (frameReadStatus >= 0) {
+    ThreadPool threadPool(cliArgs.m_BatchThreadCount);
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    std::vector<char> jobSucceeded(jobs.size(), 0);
+    std::vector<double> jobSeconds(jobs.size(), 0.0);
+    threadPool.ParallelFor(order.size(), [&](size_t i) {
+        size_t jobIndex = order[i];
+        const BatchJob &job = jobs[jobIndex];
+        CommandLineArguments jobArgs = prvJobArguments(cliArgs, job, threadPool);
         
-        if (packet->stream_index == mainVideoStreamIndex) {
-            prvProcessPacket(frameProcessor, packet, codecContext, frame, frameCount, keyframeCount);
+        std::chrono::steady_clock::time_point jobStartTime = std::chrono::steady_clock::now();
+        jobSucceeded[jobIndex] = prvAnalyzeMovie(jobArgs);
+        jobSeconds[jobIndex] = SecondsSince(jobStartTime);
+        if (!jobSucceeded[jobIndex]) {
+            fprintf(stderr, "Job for \"%s\" failed\n", job.m_InputFilepath.c_str());
         }
-        
-        // Prepare for the next iteration
-        av_packet_unref(packet);
-        frameReadStatus = av_read_frame(formatContext, packet);
-    }
+    });
     
+    size_t failureCount = 0;
+    for (size_t jobIndex = 0; jobIndex < jobs.size(); jobIndex++) {
+        if (!jobSucceeded[jobIndex]) {
+            failureCount++;
+        }
+        if (cliArgs.m_ReportStats) {
+            fprintf(stderr, "%8.3f s  %-6s  %s -> %s\n", jobSeconds[jobIndex], jobSucceeded[jobIndex] ? "ok" : "failed",
+                    jobs[jobIndex].m_InputFilepath.c_str(), jobs[jobIndex].m_OutputFilepath.c_str());
+        }
+    }
+    if (cliArgs.m_ReportStats) {
+        fprintf(stderr, "%zu jobs on %d threads, elapsed %.3f s\n", jobs.size(), threadPool.ThreadCount(),
+                SecondsSince(startTime));
+    }
+    if (failureCount > 0) {
+        fprintf(stderr, "%zu of %zu jobs failed\n", failureCount, jobs.size());
+    }
+    return failureCount == 0;
+}
+
+
+#pragma mark - Daemon
+
+// How many idle decoders the daemon keeps for later jobs to reuse
+static const size_t cDaemonCodecContextCacheCapacity = 32;
+
+// Runs jobs sent to the daemon until it's told to stop. Unlike a batch, the threads, and the
+// decoders of jobs that are done, are kept from job to job. Jobs without an output file send
+// their results back to the client, so they have to be CSV.
+static bool prvRunDaemon(const CommandLineArguments &cliArgs)
+{
+    ThreadPool threadPool(cliArgs.m_BatchThreadCount);
+    CodecContextCache codecContextCache(cDaemonCodecContextCacheCapacity);
+    AnalysisDaemon::JobRunner jobRunner = [&](const BatchJob &job, FILE *resultFile) {
+        if (job.m_OutputFilepath.empty() && (cliArgs.m_OutputFormat != OutputFormat::Csv || cliArgs.m_AllStreams)) {
+            fprintf(stderr, "Job for \"%s\" needs an output file\n", job.m_InputFilepath.c_str());
+            return false;
+        }
+        bool succeeded = prvAnalyzeMovie(prvJobArguments(cliArgs, job, threadPool), resultFile, &codecContextCache);
+        if (!succeeded) {
+            fprintf(stderr, "Job for \"%s\" failed\n", job.m_InputFilepath.c_str());
+        }
+        return succeeded;
+    };
     
-    // Process any cached frames
-    av_packet_unref(packet);
-    packet->stream_index = mainVideoStreamIndex;
-    prvProcessPacket(frameProcessor, packet, codecContext, frame, frameCount, keyframeCount);
+    bool ran = false;
+    {
+        AnalysisDaemon daemon(jobRunner, cliArgs.m_BatchThreadCount, cliArgs.m_ReportStats);
+        ran = daemon.Run(cliArgs.m_DaemonSocketPath, cliArgs.m_WatchDirectory);
+    }
+    if (ran && cliArgs.m_ReportStats) {
+        fprintf(stderr, "Decoders reused %zu times, opened %zu times\n", codecContextCache.HitCount(),
+                codecContextCache.MissCount());
+    }
+    return ran;
+}
+
+
+#pragma mark - main()
+
+int main(int argc, char **argv)
+{
     
-    // Report the results
-    LOG("Found %zu video frames, %zu keyframes\n", frameCount, keyframeCount);
-    std::string results = frameProcessor.Report();
-    if (cliArgs.m_OutputFilepath.empty()) {
-        std::cout << results << std::endl;
+    // Interpret the command line arguments
+    CommandLineArguments cliArgs = ProcessCommandLine(argc, argv);
+    if (cliArgs.m_BenchmarkCsv) {      // Compare CSV formatting speed and output on made-up results
+        bool identical = RunCsvBenchmark(500, 128, 128);
+        exit(identical ? 0 : -1);
     }
-    else {
-        std::ofstream ofs;
-        ofs.open (cliArgs.m_OutputFilepath, std::ofstream::out | std::ofstream::trunc);
-        ofs << results << std::endl;
+    if (!cliArgs.m_BatchJobs.empty()) {
+        exit(prvRunBatch(cliArgs) ? 0 : -1);
+    }
+    if (!cliArgs.m_DaemonSocketPath.empty()) {
+        exit(prvRunDaemon(cliArgs) ? 0 : -1);
     }
     
     
-    // Clean up
-    avformat_close_input(&formatContext);
-    avformat_free_context(formatContext);
-    av_packet_free(&packet);
-    av_frame_free(&frame);
-    avformat_free_context(formatContext);
-
+    // Large frames can be split into bands analyzed in parallel. One pool serves every frame
+    // processor, so segments and workers don't multiply the thread count.
+    std::unique_ptr<ThreadPool> bandThreadPool;
+    if (cliArgs.m_BandThreadCount > 1) {
+        bandThreadPool.reset(new ThreadPool(cliArgs.m_BandThreadCount));
+        cliArgs.m_ProcessorOptions.m_BandThreadPool = bandThreadPool.get();
+    }
+    
+    if (!prvAnalyzeMovie(cliArgs)) {
+        exit(-1);
+    }
     return 0;
 }
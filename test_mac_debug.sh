@@ -17,6 +17,7 @@ convert_secs_to_hours_minutes_and_seconds() {
 MOVIES_DIR="./sample_files/"
 RESULTS_DIR="./test_results/"
 EXE_FILE="./macbuild/Debug/sample_p"
+QUERY_EXE_FILE="./macbuild/Debug/median_query"
 
 SAMPLE_MOVIES=( \
 	05_blackhole.mp4 \
@@ -27,6 +28,19 @@ SAMPLE_MOVIES=( \
 	festival_1.mpg \
 	four_clips_h265_small.mp4
 	)
+
+# The sample movies whose headers come before their video, so they can be read from a pipe
+STREAMABLE_MOVIES=( \
+	festival_1.mp4 \
+	festival_1.mpg
+	)
+
+# Short clips with no 8-bit luma plane, which --convert auto reads with a fused kernel: RGB24
+# QuickTime Animation, and ProRes 4:2:2 10-bit
+FUSED_MOVIES=( \
+	festival_rgb24.mov \
+	festival_prores_422_10bit.mov
+	)
 	
 # Routine to run an individual set of tests
 # Example: run_test_set 3x3
@@ -50,6 +64,473 @@ run_test_set() {
 	done
 }
 
+# Routine to check that running with extra options finds the same keyframes, with the same
+# timestamps and values, as running without them
+# Example: run_option_check 16x16 keyframes_only "--keyframes-only"
+run_option_check() {
+	DIMENSIONS=$1
+	NAME=$2
+	OPTIONS=$3
+	echo
+	echo "Checking ${OPTIONS} against default options:" ${DIMENSIONS}
+	for MOVIE in ${SAMPLE_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		SRC_MOVIE_PATH=${MOVIES_DIR}${MOVIE}
+		DEFAULT_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_default.txt
+		OPTION_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_${NAME}.txt
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${DEFAULT_PATH} 2> /dev/null
+        DEFAULT_RESULT=$?
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${OPTION_PATH} ${OPTIONS} 2> /dev/null
+        OPTION_RESULT=$?
+        if [ $DEFAULT_RESULT -ne 0 ] || [ $OPTION_RESULT -ne 0 ]; then
+    		echo " FAILED"
+        elif ! cmp -s "${DEFAULT_PATH}" "${OPTION_PATH}"; then
+    		echo " MISMATCH"
+    	else
+    		echo
+        fi
+	done
+}
+
+# Routine to check that forcing a --deadline mode gives identical results from both median
+# engines, and marks the lines with that mode. Reduced decoding starts with the frames decoded
+# after the first keyframe is analyzed, so a few lines before that are only subsampled.
+# Example: run_deadline_mode_check 16x16 subsampled
+run_deadline_mode_check() {
+	DIMENSIONS=$1
+	MODE=$2
+	echo
+	echo "Checking --deadline-mode ${MODE} with both median engines:" ${DIMENSIONS}
+	for MOVIE in ${SAMPLE_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		SRC_MOVIE_PATH=${MOVIES_DIR}${MOVIE}
+		SORT_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_deadline_${MODE}_sort.txt
+		HISTOGRAM_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_deadline_${MODE}_histogram.txt
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${SORT_PATH} --median sort \
+        	--deadline 1000000 --deadline-mode ${MODE} 2> /dev/null
+        SORT_RESULT=$?
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${HISTOGRAM_PATH} --median histogram \
+        	--deadline 1000000 --deadline-mode ${MODE} 2> /dev/null
+        HISTOGRAM_RESULT=$?
+        if [ "${MODE}" == "reduced" ]; then
+        	OTHER_MODE_COUNT=$(grep -c -v -E '^[^,]*,(reduced|subsampled),' ${SORT_PATH})
+        else
+        	OTHER_MODE_COUNT=$(grep -c -v -E "^[^,]*,${MODE}," ${SORT_PATH})
+        fi
+        if [ $SORT_RESULT -ne 0 ] || [ $HISTOGRAM_RESULT -ne 0 ] || [ ! -s ${SORT_PATH} ]; then
+    		echo " FAILED"
+        elif ! cmp -s "${SORT_PATH}" "${HISTOGRAM_PATH}" || [ "${OTHER_MODE_COUNT}" != "0" ]; then
+    		echo " MISMATCH"
+    	else
+    		echo
+        fi
+	done
+}
+
+# Routine to check that a --sample-budget smaller than the cells gives identical results from
+# both median engines, with and without a forced subsampled --deadline mode, which quarters the
+# budget, and that the medians are within a tolerance of the exact ones
+# Example: run_sample_budget_check 3x3 4096 8
+run_sample_budget_check() {
+	DIMENSIONS=$1
+	BUDGET=$2
+	TOLERANCE=$3
+	echo
+	echo "Checking --sample-budget ${BUDGET} against default options, within ${TOLERANCE}:" ${DIMENSIONS}
+	for MOVIE in ${SAMPLE_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		SRC_MOVIE_PATH=${MOVIES_DIR}${MOVIE}
+		DEFAULT_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_default.txt
+		SAMPLED_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_sampled_${BUDGET}
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${DEFAULT_PATH} 2> /dev/null
+        FAILED=$?
+        for ENGINE in sort histogram; do
+        	${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${SAMPLED_PATH}_${ENGINE}.txt \
+        		--median ${ENGINE} --sample-budget ${BUDGET} 2> /dev/null || FAILED=1
+        	${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${SAMPLED_PATH}_${ENGINE}_deadline.txt \
+        		--median ${ENGINE} --sample-budget ${BUDGET} --deadline 1000000 --deadline-mode subsampled 2> /dev/null || FAILED=1
+        done
+        DIFFERENCE=$(max_median_difference "${DEFAULT_PATH}" "${SAMPLED_PATH}_histogram.txt")
+        if [ $FAILED -ne 0 ] || [ ! -s "${DEFAULT_PATH}" ]; then
+    		echo " FAILED"
+        elif ! cmp -s "${SAMPLED_PATH}_sort.txt" "${SAMPLED_PATH}_histogram.txt" || \
+        		! cmp -s "${SAMPLED_PATH}_sort_deadline.txt" "${SAMPLED_PATH}_histogram_deadline.txt"; then
+    		echo " ENGINE MISMATCH"
+        elif [ "${DIFFERENCE}" == "mismatch" ] || [ ${DIFFERENCE} -gt ${TOLERANCE} ]; then
+    		echo " MISMATCH (${DIFFERENCE})"
+    	else
+    		echo " (within ${DIFFERENCE})"
+        fi
+	done
+}
+
+# Routine to check that --convert auto, which reads the fused-kernel movies with its own
+# conversion to gray, gives medians within a tolerance of --convert sws, and that both median
+# engines agree exactly with --convert sws
+# Example: run_convert_check 16x16 1
+run_convert_check() {
+	DIMENSIONS=$1
+	TOLERANCE=$2
+	echo
+	echo "Checking --convert auto against --convert sws, within ${TOLERANCE}:" ${DIMENSIONS}
+	for MOVIE in ${FUSED_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		SRC_MOVIE_PATH=${MOVIES_DIR}${MOVIE}
+		AUTO_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_convert_auto.txt
+		SWS_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_convert_sws
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${AUTO_PATH} --convert auto 2> /dev/null
+        FAILED=$?
+        for ENGINE in sort histogram; do
+        	${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${SWS_PATH}_${ENGINE}.txt \
+        		--convert sws --median ${ENGINE} 2> /dev/null || FAILED=1
+        done
+        DIFFERENCE=$(max_median_difference "${SWS_PATH}_histogram.txt" "${AUTO_PATH}")
+        if [ $FAILED -ne 0 ] || [ ! -s "${AUTO_PATH}" ]; then
+    		echo " FAILED"
+        elif ! cmp -s "${SWS_PATH}_sort.txt" "${SWS_PATH}_histogram.txt"; then
+    		echo " ENGINE MISMATCH"
+        elif [ "${DIFFERENCE}" == "mismatch" ] || [ ${DIFFERENCE} -gt ${TOLERANCE} ]; then
+    		echo " MISMATCH (${DIFFERENCE})"
+    	else
+    		echo " (within ${DIFFERENCE})"
+        fi
+	done
+}
+
+# Prints the largest difference between the medians in two CSV results files, or "mismatch" if
+# their keyframes or grids differ
+# Example: max_median_difference exact.txt sampled.txt
+max_median_difference() {
+	awk -F, 'NR == FNR { lines[FNR] = $0; lineCount = FNR; next }
+		{
+			fieldCount = split(lines[FNR], fields, ",")
+			if (fieldCount != NF || fields[1] != $1) {
+				mismatch = 1
+			}
+			for (i = 2; i <= NF; i++) {
+				difference = fields[i] - $i
+				if (difference < 0) {
+					difference = -difference
+				}
+				if (difference > maxDifference) {
+					maxDifference = difference
+				}
+			}
+		}
+		END {
+			if (mismatch || FNR != lineCount) {
+				print "mismatch"
+			}
+			else {
+				print maxDifference + 0
+			}
+		}' "$1" "$2"
+}
+
+# Routine to check that a median file or delta file holds the same results as the CSV output
+# Example: run_format_check 16x16 binary
+run_format_check() {
+	DIMENSIONS=$1
+	FORMAT=$2
+	echo
+	echo "Checking --format ${FORMAT} against CSV output:" ${DIMENSIONS}
+	for MOVIE in ${SAMPLE_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		SRC_MOVIE_PATH=${MOVIES_DIR}${MOVIE}
+		DEFAULT_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_default.txt
+		FORMAT_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_${FORMAT}.bin
+		DUMP_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_${FORMAT}_dump.txt
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${DEFAULT_PATH} 2> /dev/null
+        DEFAULT_RESULT=$?
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${FORMAT_PATH} --format ${FORMAT} 2> /dev/null
+        FORMAT_RESULT=$?
+        ${QUERY_EXE_FILE} --dump ${FORMAT_PATH} > ${DUMP_PATH}
+        DUMP_RESULT=$?
+        if [ $DEFAULT_RESULT -ne 0 ] || [ $FORMAT_RESULT -ne 0 ] || [ $DUMP_RESULT -ne 0 ]; then
+    		echo " FAILED"
+        elif ! cmp -s "${DEFAULT_PATH}" "${DUMP_PATH}"; then
+    		echo " MISMATCH"
+    	else
+    		echo
+        fi
+	done
+}
+
+# Routine to check that a median ring holds the same results as the CSV output. The ring is
+# made big enough to hold every keyframe, so it can be followed after sample_p finishes.
+# Example: run_ring_check 16x16
+run_ring_check() {
+	DIMENSIONS=$1
+	RING_NAME=sample_p_test_ring
+	echo
+	echo "Checking --format ring against CSV output:" ${DIMENSIONS}
+	for MOVIE in ${SAMPLE_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		SRC_MOVIE_PATH=${MOVIES_DIR}${MOVIE}
+		DEFAULT_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_default.txt
+		FOLLOW_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_ring_follow.txt
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${DEFAULT_PATH} 2> /dev/null
+        DEFAULT_RESULT=$?
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${RING_NAME} --format ring --ring-slots 100000 2> /dev/null
+        RING_RESULT=$?
+        ${QUERY_EXE_FILE} --follow ${RING_NAME} > ${FOLLOW_PATH}
+        FOLLOW_RESULT=$?
+        if [ $DEFAULT_RESULT -ne 0 ] || [ $RING_RESULT -ne 0 ] || [ $FOLLOW_RESULT -ne 0 ]; then
+    		echo " FAILED"
+        elif ! cmp -s "${DEFAULT_PATH}" "${FOLLOW_PATH}"; then
+    		echo " MISMATCH"
+    	else
+    		echo
+        fi
+	done
+}
+
+# Routine to check that piping a movie into stdin gives the same results as reading the file
+# Example: run_stream_check 16x16 stream_keyframes "--keyframes-only --fast-start"
+run_stream_check() {
+	DIMENSIONS=$1
+	NAME=$2
+	OPTIONS=$3
+	echo
+	echo "Checking --input - ${OPTIONS} against default options:" ${DIMENSIONS}
+	for MOVIE in ${STREAMABLE_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		SRC_MOVIE_PATH=${MOVIES_DIR}${MOVIE}
+		DEFAULT_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_default.txt
+		STREAM_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_${NAME}.txt
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${DEFAULT_PATH} 2> /dev/null
+        DEFAULT_RESULT=$?
+        cat ${SRC_MOVIE_PATH} | ${EXE_FILE} --input - --dim ${DIMENSIONS} ${OPTIONS} > ${STREAM_PATH} 2> /dev/null
+        STREAM_RESULT=$?
+        if [ $DEFAULT_RESULT -ne 0 ] || [ $STREAM_RESULT -ne 0 ]; then
+    		echo " FAILED"
+        elif ! cmp -s "${DEFAULT_PATH}" "${STREAM_PATH}"; then
+    		echo " MISMATCH"
+    	else
+    		echo
+        fi
+	done
+}
+
+# Routine to check that a deadline long enough for every keyframe gives exact results, marked as
+# exact, and otherwise the same as running without one
+# Example: run_deadline_check 16x16
+run_deadline_check() {
+	DIMENSIONS=$1
+	echo
+	echo "Checking --deadline against default options:" ${DIMENSIONS}
+	for MOVIE in ${SAMPLE_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		SRC_MOVIE_PATH=${MOVIES_DIR}${MOVIE}
+		DEFAULT_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_default.txt
+		DEADLINE_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_deadline.txt
+		UNMARKED_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_deadline_unmarked.txt
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${DEFAULT_PATH} 2> /dev/null
+        DEFAULT_RESULT=$?
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${DEADLINE_PATH} --deadline 1000000 2> /dev/null
+        DEADLINE_RESULT=$?
+        sed -E 's/^([^,]*),exact,/\1,/' ${DEADLINE_PATH} > ${UNMARKED_PATH}
+        if [ $DEFAULT_RESULT -ne 0 ] || [ $DEADLINE_RESULT -ne 0 ]; then
+    		echo " FAILED"
+        elif ! cmp -s "${DEFAULT_PATH}" "${UNMARKED_PATH}"; then
+    		echo " MISMATCH"
+    	else
+    		echo
+        fi
+	done
+}
+
+# Routine to check that analyzing several grids in one pass gives the same results as analyzing
+# each separately
+# Example: run_multi_grid_check 16x16 32x32 64x64
+run_multi_grid_check() {
+	DIM_LIST=$(IFS=,; echo "$*")
+	echo
+	echo "Checking --dim ${DIM_LIST} against separate runs:"
+	for MOVIE in ${SAMPLE_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		SRC_MOVIE_PATH=${MOVIES_DIR}${MOVIE}
+		${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIM_LIST} --output ${RESULTS_DIR}multi_${MOVIE}.txt 2> /dev/null
+		RESULT=$?
+		MISMATCH=0
+		for DIMENSIONS in "$@"; do
+			SINGLE_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_single.txt
+			${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${SINGLE_PATH} 2> /dev/null
+			if [ $? -ne 0 ]; then
+				RESULT=1
+			elif ! cmp -s "${SINGLE_PATH}" "${RESULTS_DIR}multi_${MOVIE}_${DIMENSIONS}.txt"; then
+				MISMATCH=1
+			fi
+		done
+		if [ $RESULT -ne 0 ]; then
+			echo " FAILED"
+		elif [ $MISMATCH -ne 0 ]; then
+			echo " MISMATCH"
+		else
+			echo
+		fi
+	done
+}
+
+# Routine to check that one batch run gives the same results as separate runs. Needs the
+# results of run_test_set for each of the dimensions.
+# Example: run_batch_check 3x3 16x16
+run_batch_check() {
+	MANIFEST_PATH=${RESULTS_DIR}batch_manifest.txt
+	echo
+	echo "Checking --batch against separate runs:" "$@"
+	rm -f "${MANIFEST_PATH}"
+	for DIMENSIONS in "$@"; do
+		for MOVIE in ${SAMPLE_MOVIES[@]}; do
+			printf "%s\t%s\t%s\n" "${MOVIES_DIR}${MOVIE}" "${DIMENSIONS}" \
+				"${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_batch.txt" >> "${MANIFEST_PATH}"
+		done
+	done
+	${EXE_FILE} --batch ${MANIFEST_PATH} 2> /dev/null
+	if [ $? -ne 0 ]; then
+		echo "    FAILED"
+		return
+	fi
+	for DIMENSIONS in "$@"; do
+		for MOVIE in ${SAMPLE_MOVIES[@]}; do
+			echo -n "    ${DIMENSIONS} $MOVIE"
+			if ! cmp -s "${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_results.txt" "${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_batch.txt"; then
+				echo " MISMATCH"
+			else
+				echo
+			fi
+		done
+	done
+}
+
+# Routine to check that a daemon gives the same results as separate runs, for a manifest dropped
+# into its watched directory. Needs the results of run_test_set for the dimensions.
+# Example: run_daemon_check 16x16
+run_daemon_check() {
+	DIMENSIONS=$1
+	WATCH_DIR=${RESULTS_DIR}daemon_watch
+	SOCKET_PATH=${RESULTS_DIR}daemon.sock
+	echo
+	echo "Checking --daemon --watch against separate runs:" ${DIMENSIONS}
+	rm -rf "${WATCH_DIR}"
+	mkdir -p "${WATCH_DIR}"
+	rm -f "${RESULTS_DIR}daemon_manifest.tmp"
+	${EXE_FILE} --daemon ${SOCKET_PATH} --watch ${WATCH_DIR} 2> /dev/null &
+	DAEMON_PID=$!
+	for MOVIE in ${SAMPLE_MOVIES[@]}; do
+		printf "%s\t%s\t%s\n" "${MOVIES_DIR}${MOVIE}" "${DIMENSIONS}" \
+			"${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_daemon.txt" >> "${RESULTS_DIR}daemon_manifest.tmp"
+	done
+	mv "${RESULTS_DIR}daemon_manifest.tmp" "${WATCH_DIR}/check.job"
+	for (( WAIT_COUNT = 0; WAIT_COUNT < 600; WAIT_COUNT++ )); do
+		if [ -f "${WATCH_DIR}/check.done" ]; then
+			break
+		fi
+		sleep 0.5
+	done
+	kill -TERM ${DAEMON_PID}
+	wait ${DAEMON_PID}
+	if [ ! -f "${WATCH_DIR}/check.done" ] || grep -q "^failed" "${WATCH_DIR}/check.done"; then
+		echo "    FAILED"
+		return
+	fi
+	for MOVIE in ${SAMPLE_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		if ! cmp -s "${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_results.txt" "${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_daemon.txt"; then
+			echo " MISMATCH"
+		else
+			echo
+		fi
+	done
+}
+
+# Routine to check that jobs sent to a --daemon over its socket stream back the same results as
+# separate runs. Each movie is sent twice on one connection, so the second job reuses the first's
+# decoder.
+# Example: run_daemon_socket_check 16x16
+run_daemon_socket_check() {
+	DIMENSIONS=$1
+	SOCKET_PATH=${RESULTS_DIR}daemon_socket.sock
+	echo
+	echo "Checking --daemon socket jobs against separate runs:" ${DIMENSIONS}
+	rm -f "${SOCKET_PATH}"
+	${EXE_FILE} --daemon ${SOCKET_PATH} 2> /dev/null &
+	DAEMON_PID=$!
+	for (( WAIT_COUNT = 0; WAIT_COUNT < 100; WAIT_COUNT++ )); do
+		if [ -S "${SOCKET_PATH}" ]; then
+			break
+		fi
+		sleep 0.1
+	done
+	for MOVIE in ${SAMPLE_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		SRC_MOVIE_PATH=${MOVIES_DIR}${MOVIE}
+		DEFAULT_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_default.txt
+		SOCKET_RESULTS_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_socket.txt
+		${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${DEFAULT_PATH} 2> /dev/null
+		DEFAULT_RESULT=$?
+		printf "%s\t%s\n%s\t%s\n" "${SRC_MOVIE_PATH}" "${DIMENSIONS}" "${SRC_MOVIE_PATH}" "${DIMENSIONS}" | \
+			send_daemon_jobs "${SOCKET_PATH}" > "${SOCKET_RESULTS_PATH}"
+		OK_COUNT=$(grep -c $'^done\tok\t' "${SOCKET_RESULTS_PATH}")
+		if [ $DEFAULT_RESULT -ne 0 ] || [ "${OK_COUNT}" != "2" ]; then
+			echo " FAILED"
+		elif ! cmp -s <(cat "${DEFAULT_PATH}" "${DEFAULT_PATH}") <(grep -v $'^done\t' "${SOCKET_RESULTS_PATH}"); then
+			echo " MISMATCH"
+		else
+			echo
+		fi
+	done
+	kill -TERM ${DAEMON_PID}
+	wait ${DAEMON_PID}
+}
+
+# Sends the job lines on stdin to a daemon's socket, and prints what comes back until every job
+# is done
+# Example: printf "movie.mp4\t16x16\n" | send_daemon_jobs daemon.sock
+send_daemon_jobs() {
+	perl -MIO::Socket::UNIX -e '
+		my $socket = IO::Socket::UNIX->new(Peer => $ARGV[0]) or exit 1;
+		my $jobCount = 0;
+		while (my $line = <STDIN>) {
+			print $socket $line;
+			$jobCount++;
+		}
+		$socket->flush;
+		while ($jobCount > 0 && defined(my $line = <$socket>)) {
+			print $line;
+			$jobCount-- if $line =~ /^done\t/;
+		}' "$1"
+}
+
+# Routine to check that --all-streams writes the first video stream's results the same as a
+# default run does. The sample movies have one video stream each, so this covers the routing of
+# packets to per-stream decoders rather than several streams at once.
+# Example: run_all_streams_check 16x16 "--segments 2"
+run_all_streams_check() {
+	DIMENSIONS=$1
+	OPTIONS=$2
+	echo
+	echo "Checking --all-streams ${OPTIONS} against default options:" ${DIMENSIONS}
+	for MOVIE in ${SAMPLE_MOVIES[@]}; do
+		echo -n "    $MOVIE"
+		SRC_MOVIE_PATH=${MOVIES_DIR}${MOVIE}
+		DEFAULT_PATH=${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_default.txt
+		rm -f ${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_all_stream*.txt
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${DEFAULT_PATH} 2> /dev/null
+        DEFAULT_RESULT=$?
+        ${EXE_FILE} --input ${SRC_MOVIE_PATH} --dim ${DIMENSIONS} --output ${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_all.txt \
+        	--all-streams ${OPTIONS} 2> /dev/null
+        ALL_RESULT=$?
+        STREAM_PATH=$(ls ${RESULTS_DIR}${DIMENSIONS}_${MOVIE}_all_stream*.txt 2> /dev/null | head -n 1)
+        if [ $DEFAULT_RESULT -ne 0 ] || [ $ALL_RESULT -ne 0 ] || [ -z "${STREAM_PATH}" ]; then
+    		echo " FAILED"
+        elif ! cmp -s "${DEFAULT_PATH}" "${STREAM_PATH}"; then
+    		echo " MISMATCH"
+    	else
+    		echo
+        fi
+	done
+}
 
 # Make sure the results directory exists and is empty
 if [ -d "${RESULTS_DIR}" ]; then
@@ -68,6 +549,42 @@ echo "============================================================"
 run_test_set "3x3"
 run_test_set "16x16"
 run_test_set "49x20"
+run_option_check "16x16" keyframes_only "--keyframes-only"
+run_option_check "16x16" segments "--segments 4"
+run_option_check "16x16" segments_many "--segments 64"     # More segments than any movie has keyframes
+run_option_check "16x16" workers "--workers 4 --queue-depth 2"
+run_option_check "64x64" band_threads "--band-threads 4"
+run_option_check "16x16" flush_frame "--flush frame"
+run_option_check "16x16" io_mmap "--io mmap"
+run_option_check "16x16" io_readahead "--io readahead --segments 2"
+run_option_check "16x16" fast_start "--fast-start"
+run_option_check "16x16" fast_start_segments "--fast-start --segments 3"
+run_option_check "16x16" sample_budget_all "--sample-budget 100000000"
+run_sample_budget_check "3x3" 4096 8
+run_convert_check "3x3" 1
+run_convert_check "16x16" 1
+run_stream_check "16x16" stream ""
+run_stream_check "16x16" stream_keyframes "--keyframes-only --fast-start --segments 2 --stats"
+run_deadline_check "16x16"
+run_deadline_mode_check "16x16" subsampled
+run_deadline_mode_check "16x16" reduced
+run_format_check "16x16" binary
+run_format_check "16x16" delta
+run_ring_check "16x16"
+run_batch_check "3x3" "16x16" "49x20"
+run_daemon_check "16x16"
+run_daemon_socket_check "16x16"
+run_multi_grid_check "16x16" "32x32" "64x64" "3x3"
+run_all_streams_check "16x16" ""
+run_all_streams_check "16x16" "--segments 2"
+
+# Check the CSV formatter against the std::ostream formatting it replaced
+echo
+echo "Checking CSV formatting:"
+${EXE_FILE} --benchmark-csv
+if [ $? -ne 0 ]; then
+	echo "    FAILED"
+fi
 
 # These should fail
 echo